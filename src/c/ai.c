@@ -6,229 +6,1036 @@
  * Edited-by: agent #38 claude-sonnet-4 via opencode 20260122T10:03:23
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "ai.h"
+#include "bitboard.h"
+#include "book.h"
 #include "tablebase.h"
+#include "tt.h"
+#include "zobrist.h"
+#include <pthread.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-/* Piece-square tables for positional evaluation */
-/* Central bonus - pieces are generally better in the center */
-static int center_bonus(Cell c) {
-    int dist = max3_int(abs_int(c.q), abs_int(c.r), abs_int(-c.q - c.r));
-    return (BOARD_RADIUS - dist) * 5;
+#if defined(UNDERCHEX_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+/* Transposition table shared by all searches, including concurrent ones
+ * on different threads, allocated on first use under search_tt_lock */
+static TranspositionTable search_tt;
+static size_t search_tt_mb = TT_DEFAULT_MB;
+static pthread_mutex_t search_tt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* search_tt's generation advances on a clock, not per search: concurrent
+ * searches (engine sessions, self-play games, analysis) would otherwise
+ * age each other's live entries out, and the 8-bit age would wrap within
+ * a few hundred searches. Guarded by search_tt_lock. */
+#define SEARCH_TT_AGE_MS 1000
+static long long search_tt_aged_ms;
+
+/* Consulted before searching the root; empty until ai_set_book */
+static OpeningBook search_book;
+
+/* Time control for the search in progress. While search_timed is set,
+ * the clock and the stop flag are polled every SEARCH_POLL_NODES nodes;
+ * once the deadline passes or the flag is raised, every node unwinds
+ * without storing anything and the driver discards the iteration. All of
+ * it is per thread, so searches on different threads run independently:
+ * helpers have no deadline and stop on their driver's flag. */
+#define SEARCH_POLL_NODES 256
+
+static _Thread_local bool search_timed;
+static _Thread_local bool search_aborted;
+static _Thread_local long long search_deadline_ms;
+static _Thread_local atomic_bool* search_stop;
+
+/* Evaluation of the search in progress. Searches with other weights get
+ * other scores for the same position, so their keys into the shared
+ * table are salted to keep them apart; the defaults' salt is 0. */
+static _Thread_local const EvalWeights* search_weights = &EVAL_DEFAULT_WEIGHTS;
+static _Thread_local uint64_t search_key_salt;
+
+/* Table of the search in progress: search_tt unless the caller gave one
+ * of its own */
+static _Thread_local TranspositionTable* search_table = &search_tt;
+
+/* Lazy SMP: helper threads search the same root on their own boards,
+ * sharing only their driver's table, so the main thread finds more of the tree
+ * already stored. Only the main thread's result is used. Each driver
+ * keeps its helpers in a HelperPool of its own. */
+typedef struct {
+    pthread_t thread;
+    int id;
+    int max_depth;
+    atomic_bool* stop;
+    const EvalWeights* weights;
+    TranspositionTable* table;
+    Board board;
+    SearchStats stats;
+} SearchHelper;
+
+typedef struct {
+    SearchHelper helpers[AI_MAX_THREADS - 1];
+    int count;
+    atomic_bool stop;
+} HelperPool;
+
+static int search_threads = 1;
+
+/* Aspiration window half-width around the previous iteration's score */
+#define ASPIRATION_WINDOW 50
+
+/* Quiescence delta pruning: a capture that could not lift the stand-pat
+ * score to alpha even with this much positional gain is skipped */
+#define DELTA_MARGIN 200
+
+/* Selective search. Null-move pruning needs this much depth; late-move
+ * reductions start after the first LMR_FULL_MOVES moves of a node at
+ * LMR_MIN_DEPTH or more. */
+#define NULL_MOVE_MIN_DEPTH 3
+#define LMR_MIN_DEPTH 3
+#define LMR_FULL_MOVES 3
+
+/* Roots with at most this many non-king pieces build the on-demand
+ * tablebases before searching, since captures can reach them in a few
+ * plies */
+#define TB_PREPARE_PIECES (TB_MAX_PIECES + 2)
+
+static bool search_null_move = true;
+static bool search_reductions = true;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-/* Pawn advancement bonus */
-static int pawn_advancement(Cell c, Color color) {
-    /* White pawns advance toward negative r, black toward positive r */
-    if (color == COLOR_WHITE) {
-        return (BOARD_RADIUS - c.r) * 10;
-    } else {
-        return (BOARD_RADIUS + c.r) * 10;
-    }
+/* SearchProfile counting; without UNDERCHEX_PROFILE these only evaluate
+ * what they time */
+#ifdef UNDERCHEX_PROFILE
+static inline uint64_t profile_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
 }
 
-/* Get piece value */
-static int piece_value(PieceType type) {
-    switch (type) {
-        case PIECE_PAWN:    return VALUE_PAWN;
-        case PIECE_KNIGHT:  return VALUE_KNIGHT;
-        case PIECE_LANCE:   return VALUE_LANCE;
-        case PIECE_CHARIOT: return VALUE_CHARIOT;
-        case PIECE_QUEEN:   return VALUE_QUEEN;
-        case PIECE_KING:    return VALUE_KING;
-        default:            return 0;
-    }
+#define PROFILE_COUNT(stats, counter) ((stats)->profile.counter++)
+#define PROFILE_TIMED(stats, name, ...) do { \
+    uint64_t profile_start = profile_cycles(); \
+    __VA_ARGS__; \
+    (stats)->profile.name##_cycles += profile_cycles() - profile_start; \
+    (stats)->profile.name##_calls++; \
+} while (0)
+#else
+#define PROFILE_COUNT(stats, counter) ((void)(stats))
+#define PROFILE_TIMED(stats, name, ...) do { (void)(stats); __VA_ARGS__; } while (0)
+#endif
+
+static void stats_reset(SearchStats* stats) {
+    memset(stats, 0, sizeof(*stats));
 }
 
-/* Evaluate position from White's perspective */
-int evaluate(const Board* board) {
-    int score = 0;
+void search_stats_add(SearchStats* total, const SearchStats* stats) {
+    total->nodes_searched += stats->nodes_searched;
+    total->tb_hits += stats->tb_hits;
+#ifdef UNDERCHEX_PROFILE
+    /* SearchProfile is all uint64_t counters */
+    uint64_t* sum = (uint64_t*)&total->profile;
+    const uint64_t* add = (const uint64_t*)&stats->profile;
+    for (size_t i = 0; i < sizeof(SearchProfile) / sizeof(uint64_t); i++) sum[i] += add[i];
+#endif
+}
+
+/* snprintf onto the end of buf, tracking the untruncated length in *len */
+static void json_append(char* buf, int bufsize, int* len, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int room = *len < bufsize ? bufsize - *len : 0;
+    int written = vsnprintf(room ? buf + *len : NULL, (size_t)room, format, args);
+    va_end(args);
+    if (written > 0) *len += written;
+}
+
+#ifdef UNDERCHEX_PROFILE
+static double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? (double)numerator / (double)denominator : 0.0;
+}
+
+static void json_append_timing(char* buf, int bufsize, int* len, const char* name,
+                               uint64_t calls, uint64_t cycles) {
+    json_append(buf, bufsize, len,
+                ",\"%s\":{\"calls\":%llu,\"cycles\":%llu,\"cycles_per_call\":%.1f}",
+                name, (unsigned long long)calls, (unsigned long long)cycles,
+                ratio(cycles, calls));
+}
+#endif
+
+int search_stats_json(const SearchStats* stats, char* buf, int bufsize) {
+    int len = 0;
+    if (bufsize > 0) buf[0] = '\0';
+    json_append(buf, bufsize, &len,
+                "{\"nodes\":%d,\"tb_hits\":%d,\"depth\":%d,\"eval\":%d,\"book\":%s",
+                stats->nodes_searched, stats->tb_hits, stats->depth_reached, stats->eval,
+                stats->from_book ? "true" : "false");
+#ifdef UNDERCHEX_PROFILE
+    const SearchProfile* profile = &stats->profile;
     
-    /* Check for checkmate/stalemate */
-    MoveList moves;
-    generate_legal_moves(board, &moves);
+    int deepest = SEARCH_PROFILE_PLIES - 1;
+    while (deepest >= 0 && profile->nodes_by_ply[deepest] == 0) deepest--;
+    json_append(buf, bufsize, &len, ",\"profile\":{\"nodes_by_ply\":[");
+    for (int ply = 0; ply <= deepest; ply++) {
+        json_append(buf, bufsize, &len, "%s%llu", ply ? "," : "",
+                    (unsigned long long)profile->nodes_by_ply[ply]);
+    }
     
-    if (moves.count == 0) {
-        if (is_in_check(board, board->to_move)) {
-            /* Checkmate - very bad for side to move */
-            return (board->to_move == COLOR_WHITE) ? -EVAL_MATE : EVAL_MATE;
-        } else {
-            /* Stalemate */
-            return EVAL_DRAW;
-        }
+    /* Effective branching factor: the growth from the second-to-last
+     * completed iteration to the last */
+    double branching = 0.0;
+    for (int depth = AI_MAX_DEPTH; depth > 1; depth--) {
+        if (profile->iteration_nodes[depth] == 0) continue;
+        branching = ratio(profile->iteration_nodes[depth], profile->iteration_nodes[depth - 1]);
+        break;
     }
     
-    /* Material and positional evaluation */
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell c = cell_make(q, r);
-            if (!cell_is_valid(c)) continue;
-            
-            Piece* p = board_get((Board*)board, c);
-            if (p->type == PIECE_NONE) continue;
-            
-            int piece_score = piece_value(p->type);
-            
-            /* Add positional bonus */
-            if (p->type == PIECE_PAWN) {
-                piece_score += pawn_advancement(c, p->color);
-            } else if (p->type != PIECE_KING) {
-                piece_score += center_bonus(c);
-            }
-            
-            /* Add or subtract based on color */
-            if (p->color == COLOR_WHITE) {
-                score += piece_score;
-            } else {
-                score -= piece_score;
-            }
+    json_append(buf, bufsize, &len,
+                "],\"quiescence_nodes\":%llu,\"expanded_nodes\":%llu,"
+                "\"beta_cutoffs\":%llu,\"cutoff_rate\":%.4f,"
+                "\"first_move_cutoff_pct\":%.2f,"
+                "\"tt_probes\":%llu,\"tt_hits\":%llu,\"tt_hit_rate\":%.4f,"
+                "\"tt_cutoffs\":%llu,\"tb_probes\":%llu,\"tb_hit_rate\":%.4f,"
+                "\"branching_factor\":%.2f",
+                (unsigned long long)profile->quiescence_nodes,
+                (unsigned long long)profile->expanded_nodes,
+                (unsigned long long)profile->beta_cutoffs,
+                ratio(profile->beta_cutoffs, profile->expanded_nodes),
+                100.0 * ratio(profile->first_move_cutoffs, profile->beta_cutoffs),
+                (unsigned long long)profile->tt_probes,
+                (unsigned long long)profile->tt_hits,
+                ratio(profile->tt_hits, profile->tt_probes),
+                (unsigned long long)profile->tt_cutoffs,
+                (unsigned long long)profile->tb_probes,
+                ratio((uint64_t)stats->tb_hits, profile->tb_probes),
+                branching);
+    json_append_timing(buf, bufsize, &len, "movegen",
+                       profile->movegen_calls, profile->movegen_cycles);
+    json_append_timing(buf, bufsize, &len, "evaluate",
+                       profile->eval_calls, profile->eval_cycles);
+    json_append(buf, bufsize, &len, "}");
+#endif
+    json_append(buf, bufsize, &len, "}");
+    return len;
+}
+
+static bool search_should_stop(const SearchStats* stats) {
+    if (search_aborted) return true;
+    if (stats->nodes_searched % SEARCH_POLL_NODES == 0) {
+        if (search_timed && (now_ms() >= search_deadline_ms ||
+                             (search_stop && atomic_load_explicit(search_stop,
+                                                                  memory_order_relaxed)))) {
+            search_aborted = true;
         }
     }
+    return search_aborted;
+}
+
+/* Scores this close to EVAL_MATE are mates, stored relative to the node */
+#define MATE_BOUND (EVAL_MATE - 1000)
+
+static int score_to_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+static bool move_is_empty(Move move) {
+    return move.from.q == 0 && move.from.r == 0 && move.to.q == 0 && move.to.r == 0;
+}
+
+bool ai_set_hash_size(size_t size_mb) {
+    search_tt_mb = size_mb;
+    return tt_init(&search_tt, size_mb);
+}
+
+void ai_clear_hash(void) {
+    tt_clear(&search_tt);
+}
+
+bool ai_hash_move(const Board* board, Move* move) {
+    TTEntry entry;
+    if (!tt_probe(&search_tt, zobrist_key(board), &entry)) return false;
+    if (move_is_empty(entry.best_move) || !is_move_legal(board, entry.best_move)) return false;
+    *move = entry.best_move;
+    return true;
+}
+
+void ai_set_threads(int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > AI_MAX_THREADS) threads = AI_MAX_THREADS;
+    search_threads = threads;
+}
+
+int ai_get_threads(void) {
+    return search_threads;
+}
+
+void ai_set_selective(bool null_move, bool reductions) {
+    search_null_move = null_move;
+    search_reductions = reductions;
+}
+
+/* Pieces' attacked cells not holding a friendly piece */
+static int mobility(const Board* board, Color color) {
+    int side = color - 1;
+    Bitboard occupied = board->occupied[0] | board->occupied[1];
+    int count = 0;
+    
+    for (int i = 0; i < board->piece_count[side]; i++) {
+        int square = board->pieces[side][i];
+        Bitboard attacks = bb_piece_attacks(board->squares[square],
+                                            bb_square_index[square], occupied);
+        count += bb_popcount(attacks & ~board->occupied[side]);
+    }
+    return count;
+}
+
+/* Evaluate position from White's perspective */
+const EvalWeights EVAL_DEFAULT_WEIGHTS = {{0, 0, 0, 0, 0, 0, 0}, 2, 50};
+
+int evaluate_weighted(const Board* board, const EvalWeights* weights) {
+    /* Material and position, kept up to date by the board setters */
+    int score = board->psqt[0] - board->psqt[1];
     
-    /* Mobility bonus */
-    int mobility = moves.count;
-    if (board->to_move == COLOR_WHITE) {
-        score += mobility * 2;
-    } else {
-        score -= mobility * 2;
+    /* Adjusted piece values */
+    for (int type = PIECE_PAWN; type < PIECE_KING; type++) {
+        int adjust = weights->piece_adjust[type];
+        if (adjust == 0) continue;
+        Bitboard pieces = (type == PIECE_LANCE)
+            ? board->kinds[BB_LANCE_A] | board->kinds[BB_LANCE_B]
+            : board->kinds[bb_kind((Piece){(PieceType)type, COLOR_WHITE, 0})];
+        score += adjust * (bb_popcount(pieces & board->occupied[0]) -
+                           bb_popcount(pieces & board->occupied[1]));
     }
     
+    /* Mobility bonus */
+    score += (mobility(board, COLOR_WHITE) - mobility(board, COLOR_BLACK)) * weights->mobility;
+    
     /* King safety - penalize being in check */
     if (is_in_check(board, COLOR_WHITE)) {
-        score -= 50;
+        score -= weights->check_penalty;
     }
     if (is_in_check(board, COLOR_BLACK)) {
-        score += 50;
+        score += weights->check_penalty;
     }
     
     return score;
 }
 
-/* Move ordering score - captures and checks first */
-static int move_order_score(const Board* board, Move move) {
-    int score = 0;
+int evaluate(const Board* board) {
+    return evaluate_weighted(board, &EVAL_DEFAULT_WEIGHTS);
+}
+
+/* Move ordering. Each node scores its moves once into a parallel array
+ * and picks the best remaining one as it goes, so a node that cuts off
+ * early never orders the rest. The bands, highest first: the root's move
+ * from the previous iteration, the hash move, captures and promotions by
+ * MVV-LVA, the two killers of the ply, then quiet moves by history. */
+#define ORDER_PV (1 << 30)
+#define ORDER_HASH (1 << 29)
+#define ORDER_CAPTURE (1 << 24)
+#define ORDER_KILLER (1 << 23)
+#define HISTORY_MAX (1 << 20)
+
+/* Plies that keep killer moves; deeper nodes (quiescence) have none */
+#define SEARCH_MAX_PLY 64
+
+/* Quiet moves that caused a cutoff, by ply and by side, from and to cell.
+ * Per thread, cleared when a search starts and kept across its iterations. */
+static _Thread_local MoveCode search_killers[SEARCH_MAX_PLY][2];
+static _Thread_local int search_history[2][NUM_CELLS][NUM_CELLS];
+
+/* Packed moves and their ordering scores for every ply of a thread's
+ * search. A node pushes its moves above its parent's and pops them when
+ * it returns, so each ply holds only the moves it has, and a deep search
+ * keeps its lists in a few contiguous kilobytes. A node finding the stack
+ * full searches the moves that fit. */
+#define MOVE_STACK_SIZE 16384
+
+typedef struct {
+    MoveCode moves[MOVE_STACK_SIZE];
+    int scores[MOVE_STACK_SIZE];
+    int top;
+} MoveStack;
+
+static _Thread_local MoveStack search_stack;
+
+/* The root's legal moves, when the caller already has them */
+static _Thread_local const MoveList* search_root_moves;
+
+/* A node's moves: its slice of search_stack */
+typedef struct {
+    MoveCode* moves;
+    int* scores;
+    int count;
+    int next;
+} MovePicker;
+
+static void clear_move_ordering(void) {
+    memset(search_killers, 0, sizeof(search_killers));
+    memset(search_history, 0, sizeof(search_history));
+    search_stack.top = 0;
+}
+
+static bool is_quiet(const Board* board, MoveCode code) {
+    return board->squares[bb_index_square[move_code_to(code)]].type == PIECE_NONE &&
+           move_code_promotion(code) == PIECE_NONE;
+}
+
+static int* history_entry(const Board* board, MoveCode code) {
+    return &search_history[board->to_move - 1][move_code_from(code)][move_code_to(code)];
+}
+
+/* Generate a node's moves onto the move stack, or copy them from known
+ * if not NULL. Kept out of line so the MoveList it fills lives only in
+ * this frame, not in every ply's. */
+__attribute__((noinline))
+static int push_moves(const Board* board, bool noisy, const MoveList* known, MoveCode* out,
+                      int room) {
+    MoveList list;
+    if (known) {
+        list = *known;
+    } else if (noisy) {
+        generate_captures(board, &list);
+    } else {
+        generate_legal_moves(board, &list);
+    }
+    if (list.count > room) list.count = room;
+    movelist_encode(&list, out);
+    return list.count;
+}
+
+/* Push the legal moves of a node at ply (all of them, or captures and
+ * promotions if noisy; known, if not NULL, already holds them) and score
+ * them. ply is negative for none with killers; pv_move may be NULL.
+ * Returns the move count; every picker_init must be paired with a
+ * picker_done. */
+static int picker_init(MovePicker* picker, const Board* board, bool noisy,
+                       const MoveList* known, int ply, Move hash_move, const Move* pv_move,
+                       SearchStats* stats) {
+    int top = search_stack.top;
+    picker->moves = &search_stack.moves[top];
+    picker->scores = &search_stack.scores[top];
+    PROFILE_TIMED(stats, movegen,
+                  picker->count = push_moves(board, noisy, known, picker->moves,
+                                             MOVE_STACK_SIZE - top));
+    picker->next = 0;
+    search_stack.top = top + picker->count;
     
-    Piece* target = board_get((Board*)board, move.to);
-    Piece* moving = board_get((Board*)board, move.from);
+    MoveCode hash_code = move_encode(hash_move);
+    MoveCode pv_code = pv_move ? move_encode(*pv_move) : MOVE_CODE_NONE;
+    bool use_killers = ply >= 0 && ply < SEARCH_MAX_PLY;
     
-    /* Capture bonus: MVV-LVA (Most Valuable Victim - Least Valuable Attacker) */
-    if (target->type != PIECE_NONE) {
-        score += piece_value(target->type) * 10 - piece_value(moving->type);
+    for (int i = 0; i < picker->count; i++) {
+        MoveCode code = picker->moves[i];
+        Cell to = square_cell(bb_index_square[move_code_to(code)]);
+        int score;
+        
+        if (code == pv_code) {
+            score = ORDER_PV;
+        } else if (code == hash_code) {
+            score = ORDER_HASH;
+        } else if (!is_quiet(board, code)) {
+            /* MVV-LVA (Most Valuable Victim - Least Valuable Attacker) */
+            Piece target = board->squares[bb_index_square[move_code_to(code)]];
+            Piece moving = board->squares[bb_index_square[move_code_from(code)]];
+            PieceType promotion = move_code_promotion(code);
+            score = ORDER_CAPTURE + psqt_center_bonus(to);
+            if (target.type != PIECE_NONE) {
+                score += psqt_piece_value(target.type) * 10 - psqt_piece_value(moving.type);
+            }
+            if (promotion != PIECE_NONE) {
+                score += psqt_piece_value(promotion) * 5;
+            }
+        } else if (use_killers && code == search_killers[ply][0]) {
+            score = ORDER_KILLER + 1;
+        } else if (use_killers && code == search_killers[ply][1]) {
+            score = ORDER_KILLER;
+        } else {
+            score = *history_entry(board, code) + psqt_center_bonus(to);
+        }
+        picker->scores[i] = score;
     }
     
-    /* Promotion bonus */
-    if (move.promotion != PIECE_NONE) {
-        score += piece_value(move.promotion) * 5;
+    return picker->count;
+}
+
+/* Pop the node's moves off the move stack */
+static void picker_done(MovePicker* picker) {
+    search_stack.top -= picker->count;
+}
+
+/* Swap the best remaining move into place and return it; false when the
+ * moves run out. Ties keep generation order. */
+static bool picker_next(MovePicker* picker, Move* move) {
+    if (picker->next >= picker->count) return false;
+    
+    int best = picker->next;
+    for (int i = picker->next + 1; i < picker->count; i++) {
+        if (picker->scores[i] > picker->scores[best]) best = i;
     }
     
-    /* Center control bonus */
-    score += center_bonus(move.to);
+    int n = picker->next++;
+    MoveCode code = picker->moves[best];
+    int score = picker->scores[best];
+    picker->moves[best] = picker->moves[n];
+    picker->scores[best] = picker->scores[n];
+    picker->moves[n] = code;
+    picker->scores[n] = score;
     
-    return score;
+    *move = move_decode(code);
+    return true;
+}
+
+/* A quiet move refuted the node: make it a killer and credit its history */
+static void record_cutoff(const Board* board, Move move, int depth, int ply) {
+    MoveCode code = move_encode(move);
+    if (!is_quiet(board, code)) return;
+    
+    if (ply < SEARCH_MAX_PLY && search_killers[ply][0] != code) {
+        search_killers[ply][1] = search_killers[ply][0];
+        search_killers[ply][0] = code;
+    }
+    
+    int* entry = history_entry(board, code);
+    *entry += depth * depth;
+    if (*entry > HISTORY_MAX) {
+        /* Halve everything, keeping the order but leaving room to learn */
+        int* all = &search_history[0][0][0];
+        for (size_t i = 0; i < sizeof(search_history) / sizeof(int); i++) {
+            all[i] /= 2;
+        }
+    }
+}
+
+/* Material a capture or promotion wins */
+static int capture_gain(const Board* board, Move move) {
+    int gain = psqt_piece_value(board->squares[cell_square(move.to)].type);
+    if (move.promotion != PIECE_NONE) {
+        gain += psqt_piece_value(move.promotion) - VALUE_PAWN;
+    }
+    return gain;
 }
 
-/* Sort moves by their ordering score */
-static void sort_moves(const Board* board, MoveList* list) {
-    /* Simple insertion sort for small lists */
-    for (int i = 1; i < list->count; i++) {
-        Move key = list->moves[i];
-        int key_score = move_order_score(board, key);
-        int j = i - 1;
+/* The search is negamax: its scores are from the side to move's view,
+ * while evaluate() and SearchStats.eval are from White's */
+static int side_relative(const Board* board, int score) {
+    return board->to_move == COLOR_WHITE ? score : -score;
+}
+
+/* Score a position from an already generated tablebase, from the side
+ * to move's view. Mates count from the root, like the search's own; very
+ * long ones are capped so they still read as mates. */
+static bool probe_tablebase(const Board* board, int ply, int* score, SearchStats* stats) {
+    WDLOutcome wdl;
+    int dtm;
+    PROFILE_COUNT(stats, tb_probes);
+    if (!tablebase_probe_wdl(board, &wdl, &dtm)) return false;
+    stats->tb_hits++;
+    
+    int distance = ply + dtm;
+    if (distance >= EVAL_MATE - MATE_BOUND) distance = EVAL_MATE - MATE_BOUND - 1;
+    *score = (wdl == WDL_WIN) ? EVAL_MATE - distance :
+             (wdl == WDL_LOSS) ? -EVAL_MATE + distance : EVAL_DRAW;
+    return true;
+}
+
+/* Search captures and promotions until the position is quiet, so the
+ * static evaluation is never taken in the middle of an exchange. The side
+ * to move may stand pat on the evaluation, except in check, where every
+ * evasion is searched and having none is mate. Stalemates are not
+ * detected here. */
+static int quiescence(Board* board, int alpha, int beta, int ply, SearchStats* stats) {
+    stats->nodes_searched++;
+    PROFILE_COUNT(stats, quiescence_nodes);
+    if (search_should_stop(stats)) return 0;
+    
+    int tb_score;
+    if (probe_tablebase(board, ply, &tb_score, stats)) return tb_score;
+    
+    bool in_check = is_in_check(board, board->to_move);
+    int best = -EVAL_INF;
+    int stand_pat = 0;
+    
+    if (!in_check) {
+        PROFILE_TIMED(stats, eval,
+                      stand_pat = side_relative(board, evaluate_weighted(board, search_weights)));
+        if (stand_pat >= beta) return stand_pat;
+        best = stand_pat;
+        alpha = max_int(alpha, stand_pat);
+    }
+    
+    MovePicker picker;
+    int count = picker_init(&picker, board, !in_check, NULL, -1,
+                            (Move){{0, 0}, {0, 0}, PIECE_NONE}, NULL, stats);
+    if (in_check && count == 0) {
+        return -EVAL_MATE + ply;
+    }
+    
+    Move move;
+    while (picker_next(&picker, &move)) {
+        /* Delta pruning */
+        if (!in_check && stand_pat + capture_gain(board, move) + DELTA_MARGIN <= alpha) {
+            continue;
+        }
+        
+        UndoInfo undo;
+        make_move_with_undo(board, move, &undo);
+        int score = -quiescence(board, -beta, -alpha, ply + 1, stats);
+        unmake_move(board, move, &undo);
+        if (search_aborted) break;
         
-        while (j >= 0 && move_order_score(board, list->moves[j]) < key_score) {
-            list->moves[j + 1] = list->moves[j];
-            j--;
+        if (score > best) {
+            best = score;
+            alpha = max_int(alpha, score);
+            if (alpha >= beta) break;
         }
-        list->moves[j + 1] = key;
     }
+    
+    picker_done(&picker);
+    return search_aborted ? 0 : best;
+}
+
+/* Passing is only a safe lower bound when the side to move is not in
+ * zugzwang. Hex endings with nothing but pawns, knights and the king are
+ * where moving hurts, so the side to move needs a rider to try it. */
+static bool null_move_safe(const Board* board) {
+    Bitboard riders = board->kinds[BB_LANCE_A] | board->kinds[BB_LANCE_B] |
+                      board->kinds[BB_CHARIOT] | board->kinds[BB_QUEEN];
+    return (board->occupied[board->to_move - 1] & riders) != 0;
 }
 
-int alpha_beta(Board* board, int depth, int alpha, int beta, bool maximizing,
-               Move* best_move, SearchStats* stats) {
+/* The core search. allow_null is false right after a null move, so two
+ * passes never follow each other. */
+static int search(Board* board, int depth, int alpha, int beta, int ply, bool allow_null,
+                  Move* best_move, SearchStats* stats) {
+    /* Depth limit: resolve captures before evaluating */
+    if (depth <= 0) {
+        return quiescence(board, alpha, beta, ply, stats);
+    }
+    
     stats->nodes_searched++;
+    PROFILE_COUNT(stats, nodes_by_ply[ply < SEARCH_PROFILE_PLIES ? ply : SEARCH_PROFILE_PLIES - 1]);
+    if (search_should_stop(stats)) return 0;
+    
+    bool root = (best_move != NULL);
+    bool pv_node = (beta - alpha > 1);
+    int alpha_orig = alpha;
+    
+    /* An endgame subtree collapses to one lookup. The root still
+     * searches, since it must produce a move. */
+    int tb_score;
+    if (!root && probe_tablebase(board, ply, &tb_score, stats)) return tb_score;
+    
+    uint64_t key = zobrist_key(board) ^ search_key_salt;
     
-    /* Terminal node or depth limit */
-    if (depth == 0) {
-        return evaluate(board);
+    /* A deep enough stored result can answer this node. The root still
+     * searches, since it must produce a move. */
+    TTEntry entry;
+    bool hit = tt_probe(search_table, key, &entry);
+    PROFILE_COUNT(stats, tt_probes);
+    if (hit) PROFILE_COUNT(stats, tt_hits);
+    Move hash_move = hit ? entry.best_move : (Move){{0, 0}, {0, 0}, PIECE_NONE};
+    if (hit && !root && entry.depth >= depth) {
+        int score = score_from_tt(entry.score, ply);
+        if (entry.bound == TT_BOUND_EXACT ||
+            (entry.bound == TT_BOUND_LOWER && score >= beta) ||
+            (entry.bound == TT_BOUND_UPPER && score <= alpha)) {
+            PROFILE_COUNT(stats, tt_cutoffs);
+            return score;
+        }
     }
     
-    MoveList moves;
-    generate_legal_moves(board, &moves);
+    bool in_check = is_in_check(board, board->to_move);
     
-    if (moves.count == 0) {
+    /* Null move: if passing still fails high on a reduced search, a real
+     * move will too */
+    if (search_null_move && allow_null && !pv_node && !in_check &&
+        depth >= NULL_MOVE_MIN_DEPTH && abs_int(beta) < MATE_BOUND && null_move_safe(board)) {
+        int reduction = (depth > 6) ? 3 : 2;
+        board->to_move = opponent_color(board->to_move);
+        int score = -search(board, depth - 1 - reduction, -beta, -beta + 1, ply + 1, false,
+                            NULL, stats);
+        board->to_move = opponent_color(board->to_move);
+        if (search_aborted) return 0;
+        
+        /* Not score itself: a mate found after passing proves nothing */
+        if (score >= beta) return beta;
+    }
+    
+    /* Order for better pruning: at the root a move passed in through
+     * best_move (the previous iteration's PV move) comes first, then the
+     * hash move */
+    MovePicker picker;
+    bool use_pv = root && !move_is_empty(*best_move);
+    int count = picker_init(&picker, board, false, root ? search_root_moves : NULL, ply,
+                            hash_move, use_pv ? best_move : NULL, stats);
+    
+    if (count == 0) {
         /* Game over */
-        if (is_in_check(board, board->to_move)) {
-            return maximizing ? (-EVAL_MATE + (stats->depth_reached - depth)) 
-                              : (EVAL_MATE - (stats->depth_reached - depth));
-        }
-        return EVAL_DRAW;
+        return in_check ? -EVAL_MATE + ply : EVAL_DRAW;
     }
+    PROFILE_COUNT(stats, expanded_nodes);
     
-    /* Sort moves for better pruning */
-    sort_moves(board, &moves);
+    int best = -EVAL_INF;
+    Move best_here = move_decode(picker.moves[0]);
+    int searched = 0;
+    Move move;
     
-    if (maximizing) {
-        int max_eval = -EVAL_INF;
-        Move local_best = moves.moves[0];
+    while (picker_next(&picker, &move)) {
+        /* Only quiet moves below the killers are reduced */
+        bool reducible = picker.scores[picker.next - 1] < ORDER_KILLER;
         
-        for (int i = 0; i < moves.count; i++) {
-            Board copy = board_copy(board);
-            make_move(&copy, moves.moves[i]);
-            
-            int eval = alpha_beta(&copy, depth - 1, alpha, beta, false, NULL, stats);
-            
-            if (eval > max_eval) {
-                max_eval = eval;
-                local_best = moves.moves[i];
+        UndoInfo undo;
+        make_move_with_undo(board, move, &undo);
+        int score;
+        
+        if (searched == 0) {
+            score = -search(board, depth - 1, -beta, -alpha, ply + 1, true, NULL, stats);
+        } else {
+            /* Principal variation search: prove the move is no better than
+             * alpha with a null window, possibly reduced, and search it
+             * properly only if that fails */
+            int reduction = 0;
+            if (search_reductions && reducible && depth >= LMR_MIN_DEPTH &&
+                searched >= LMR_FULL_MOVES && !in_check &&
+                !is_in_check(board, board->to_move)) {
+                reduction = (searched >= 8 && depth >= 6) ? 2 : 1;
+            }
+            score = -search(board, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true,
+                            NULL, stats);
+            if (score > alpha && reduction > 0) {
+                score = -search(board, depth - 1, -alpha - 1, -alpha, ply + 1, true, NULL, stats);
+            }
+            if (score > alpha && score < beta) {
+                score = -search(board, depth - 1, -beta, -alpha, ply + 1, true, NULL, stats);
             }
-            
-            alpha = max_int(alpha, eval);
-            if (beta <= alpha) break;  /* Beta cutoff */
         }
         
-        if (best_move) *best_move = local_best;
-        return max_eval;
-    } else {
-        int min_eval = EVAL_INF;
-        Move local_best = moves.moves[0];
+        unmake_move(board, move, &undo);
+        if (search_aborted) break;
+        searched++;
         
-        for (int i = 0; i < moves.count; i++) {
-            Board copy = board_copy(board);
-            make_move(&copy, moves.moves[i]);
-            
-            int eval = alpha_beta(&copy, depth - 1, alpha, beta, true, NULL, stats);
-            
-            if (eval < min_eval) {
-                min_eval = eval;
-                local_best = moves.moves[i];
+        if (score > best) {
+            best = score;
+            best_here = move;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    PROFILE_COUNT(stats, beta_cutoffs);
+                    if (searched == 1) PROFILE_COUNT(stats, first_move_cutoffs);
+                    record_cutoff(board, move, depth, ply);
+                    break;
+                }
             }
-            
-            beta = max_int(beta, -eval);  /* Note: using max because we're minimizing */
-            beta = eval < beta ? eval : beta;
-            if (beta <= alpha) break;  /* Alpha cutoff */
         }
-        
-        if (best_move) *best_move = local_best;
-        return min_eval;
     }
+    
+    picker_done(&picker);
+    if (search_aborted) return 0;
+    
+    TTBound bound = (best <= alpha_orig) ? TT_BOUND_UPPER :
+                    (best >= beta) ? TT_BOUND_LOWER : TT_BOUND_EXACT;
+    tt_store(search_table, key, depth, score_to_tt(best, ply), bound, best_here);
+    
+    if (best_move) *best_move = best_here;
+    return best;
+}
+
+int alpha_beta(Board* board, int depth, int alpha, int beta, Move* best_move,
+               SearchStats* stats) {
+    return search(board, depth, alpha, beta, 0, true, best_move, stats);
+}
+
+/* FNV-1a over the weights; 0 for the defaults */
+static uint64_t weights_salt(const EvalWeights* weights) {
+    if (memcmp(weights, &EVAL_DEFAULT_WEIGHTS, sizeof(EvalWeights)) == 0) return 0;
+    
+    const unsigned char* bytes = (const unsigned char*)weights;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(EvalWeights); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Set up this thread's search with the given weights (NULL for the
+ * defaults) */
+static void use_weights(const EvalWeights* weights) {
+    search_weights = weights ? weights : &EVAL_DEFAULT_WEIGHTS;
+    search_key_salt = weights_salt(search_weights);
+}
+
+/* Search table (the shared one if NULL), allocating the shared one if
+ * needed and aging its entries once SEARCH_TT_AGE_MS has passed, and
+ * start the calling thread's move ordering afresh with the given weights
+ * (NULL for the defaults) */
+static void prepare_search(const EvalWeights* weights, TranspositionTable* table) {
+    use_weights(weights);
+    search_table = table ? table : &search_tt;
+    if (!table) {
+        pthread_mutex_lock(&search_tt_lock);
+        if (!search_tt.slots) {
+            tt_init(&search_tt, search_tt_mb);
+        }
+        long long now = now_ms();
+        if (now - search_tt_aged_ms >= SEARCH_TT_AGE_MS) {
+            tt_new_search(&search_tt);
+            search_tt_aged_ms = now;
+        }
+        pthread_mutex_unlock(&search_tt_lock);
+    }
+    clear_move_ordering();
+}
+
+/* Helper thread: iterative deepening to max_depth with a full window.
+ * Odd helpers start a ply deeper and each starts from a different root
+ * move, so the threads spread over the tree instead of moving in step. */
+static void* helper_search(void* arg) {
+    SearchHelper* helper = (SearchHelper*)arg;
+    search_timed = true;
+    search_aborted = false;
+    search_deadline_ms = LLONG_MAX;
+    search_stop = helper->stop;
+    search_table = helper->table;
+    use_weights(helper->weights);
+    clear_move_ordering();
+    
+    MoveList root_moves;
+    generate_legal_moves(&helper->board, &root_moves);
+    if (root_moves.count == 0) return NULL;
+    search_root_moves = &root_moves;
+    
+    Move move = root_moves.moves[helper->id % root_moves.count];
+    
+    for (int depth = 1 + (helper->id & 1); depth <= helper->max_depth; depth++) {
+        helper->stats.depth_reached = depth;
+        alpha_beta(&helper->board, depth, -EVAL_INF, EVAL_INF, &move, &helper->stats);
+        if (search_aborted) break;
+    }
+    return NULL;
+}
+
+/* Start search_threads - 1 helpers on the position */
+static void start_helpers(HelperPool* pool, const Board* board, int max_depth) {
+    atomic_init(&pool->stop, false);
+    pool->count = 0;
+    
+    for (int i = 1; i < search_threads; i++) {
+        SearchHelper* helper = &pool->helpers[pool->count];
+        helper->id = i;
+        helper->max_depth = max_depth;
+        helper->stop = &pool->stop;
+        helper->weights = search_weights;
+        helper->table = search_table;
+        helper->board = board_copy(board);
+        memset(&helper->stats, 0, sizeof(SearchStats));
+        if (pthread_create(&helper->thread, NULL, helper_search, helper) != 0) break;
+        pool->count++;
+    }
+}
+
+/* Stop and join the helpers, adding their counters to stats */
+static void stop_helpers(HelperPool* pool, SearchStats* stats) {
+    atomic_store(&pool->stop, true);
+    for (int i = 0; i < pool->count; i++) {
+        pthread_join(pool->helpers[i].thread, NULL);
+        search_stats_add(stats, &pool->helpers[i].stats);
+    }
+    pool->count = 0;
+}
+
+/* Answer a won root from the tablebase. Otherwise the search runs, and
+ * probes the tables at its nodes; those within reach of a root this close
+ * to the endgame are built first, before any helper thread starts. Drawn
+ * and lost roots are searched too, so that the move chosen keeps the
+ * draw or delays the loss. */
+static bool tablebase_root(const Board* board, Move* move, SearchStats* stats) {
+    int pieces = tablebase_count_pieces(board, COLOR_WHITE) +
+                 tablebase_count_pieces(board, COLOR_BLACK);
+    if (pieces > TB_PREPARE_PIECES) return false;
+    tablebase_generate_all();
+    
+    TablebaseProbeResult probe = tablebase_probe(board);
+    if (!probe.found || probe.wdl != WDL_WIN || move_is_empty(probe.best_move)) {
+        return false;
+    }
+    
+    stats_reset(stats);
+    stats->tb_hits = 1;
+    stats->eval = side_relative(board, EVAL_MATE - probe.dtm);
+    *move = probe.best_move;
+    return true;
+}
+
+bool ai_set_book(const char* path) {
+    book_close(&search_book);
+    return !path || book_open(&search_book, path);
+}
+
+/* Play a book move at the root, if the book has one */
+static bool book_root(const Board* board, Move* move, SearchStats* stats) {
+    if (search_book.count == 0 || !book_probe(&search_book, board, move)) return false;
+    
+    stats_reset(stats);
+    stats->from_book = true;
+    return true;
 }
 
 Move find_best_move(const Board* board, int depth, SearchStats* stats) {
     Move best_move = {{0, 0}, {0, 0}, PIECE_NONE};
     
-    stats->nodes_searched = 0;
+    stats_reset(stats);
     stats->depth_reached = depth;
-    stats->eval = 0;
     
-    bool maximizing = (board->to_move == COLOR_WHITE);
-    stats->eval = alpha_beta((Board*)board, depth, -EVAL_INF, EVAL_INF, 
-                             maximizing, &best_move, stats);
+    prepare_search(NULL, NULL);
+    search_timed = false;
+    search_aborted = false;
+    
+    /* The search makes and unmakes moves on its own copy */
+    Board root = board_copy(board);
+    HelperPool pool;
+    start_helpers(&pool, board, depth + 1);
+    int score = alpha_beta(&root, depth, -EVAL_INF, EVAL_INF, &best_move, stats);
+    stats->eval = side_relative(board, score);
+#ifdef UNDERCHEX_PROFILE
+    stats->profile.iteration_nodes[depth < AI_MAX_DEPTH ? depth : AI_MAX_DEPTH] =
+        (uint64_t)stats->nodes_searched;
+#endif
+    stop_helpers(&pool, stats);
     
     return best_move;
 }
 
+/* Search one iteration inside an aspiration window around the previous
+ * score, widening the side that fails until the result lies inside it.
+ * Scores are from the side to move's view. */
+static int search_iteration(Board* board, int depth, int prev_score, bool use_window,
+                            Move* best_move, SearchStats* stats) {
+    int delta = ASPIRATION_WINDOW;
+    int alpha = use_window ? prev_score - delta : -EVAL_INF;
+    int beta = use_window ? prev_score + delta : EVAL_INF;
+    
+    for (;;) {
+        int score = alpha_beta(board, depth, alpha, beta, best_move, stats);
+        if (search_aborted) return 0;
+        
+        if (score <= alpha && alpha > -EVAL_INF) {
+            delta *= 4;
+            alpha = (delta >= MATE_BOUND) ? -EVAL_INF : prev_score - delta;
+        } else if (score >= beta && beta < EVAL_INF) {
+            delta *= 4;
+            beta = (delta >= MATE_BOUND) ? EVAL_INF : prev_score + delta;
+        } else {
+            return score;
+        }
+    }
+}
+
+/* Iterative deepening within limits until the deadline or *stop (either
+ * may be absent); limits->time_ms is the caller's business */
+static Move iterative_deepening(const Board* board, long long deadline_ms,
+                                const SearchLimits* limits, SearchStats* stats) {
+    int max_depth = limits->max_depth;
+    atomic_bool* stop = limits->stop;
+    Move best_move = {{0, 0}, {0, 0}, PIECE_NONE};
+    SearchStats iter_stats;
+    stats_reset(stats);
+    
+    if (max_depth < 1) max_depth = 1;
+    if (max_depth > AI_MAX_DEPTH) max_depth = AI_MAX_DEPTH;
+    
+    prepare_search(limits->weights, limits->tt);
+    search_deadline_ms = deadline_ms;
+    search_stop = stop;
+    search_aborted = false;
+    search_root_moves = limits->root_moves;
+    
+    /* The search makes and unmakes moves on its own copy */
+    Board root = board_copy(board);
+    int score = 0;
+    HelperPool pool;
+    start_helpers(&pool, board, AI_MAX_DEPTH);
+    
+    for (int depth = 1; depth <= max_depth; depth++) {
+        /* Depth 1 always completes so there is a move to play */
+        search_timed = (depth > 1);
+        
+        Move iter_move = best_move;
+        stats_reset(&iter_stats);
+        iter_stats.depth_reached = depth;
+        
+        bool use_window = depth > 1 && abs_int(score) < MATE_BOUND;
+        int iter_score = search_iteration(&root, depth, score, use_window,
+                                          &iter_move, &iter_stats);
+        search_stats_add(stats, &iter_stats);
+        if (search_aborted) break;
+#ifdef UNDERCHEX_PROFILE
+        stats->profile.iteration_nodes[depth] = (uint64_t)iter_stats.nodes_searched;
+#endif
+        
+        best_move = iter_move;
+        score = iter_score;
+        stats->depth_reached = depth;
+        stats->eval = side_relative(board, score);
+        
+        /* A found mate will not change with more depth */
+        if (abs_int(score) >= MATE_BOUND) break;
+        if (now_ms() >= search_deadline_ms) break;
+        if (stop && atomic_load(stop)) break;
+    }
+    
+    stop_helpers(&pool, stats);
+    search_timed = false;
+    search_aborted = false;
+    search_stop = NULL;
+    search_root_moves = NULL;
+    search_table = &search_tt;
+    use_weights(NULL);
+    return best_move;
+}
+
+Move find_best_move_timed(const Board* board, int time_ms, int max_depth,
+                          SearchStats* stats) {
+    SearchLimits limits = {max_depth, time_ms, NULL, false, false, NULL, NULL, NULL};
+    return iterative_deepening(board, now_ms() + time_ms, &limits, stats);
+}
+
+Move find_best_move_limited(const Board* board, const SearchLimits* limits,
+                            SearchStats* stats) {
+    Move move;
+    if (limits->use_book && book_root(board, &move, stats)) return move;
+    if (limits->use_tablebase && tablebase_root(board, &move, stats)) return move;
+    
+    long long deadline = (limits->time_ms < 0) ? LLONG_MAX : now_ms() + limits->time_ms;
+    return iterative_deepening(board, deadline, limits, stats);
+}
+
 Move get_random_move(const Board* board) {
     MoveList moves;
     generate_legal_moves(board, &moves);
@@ -248,38 +1055,16 @@ Move get_random_move(const Board* board) {
 }
 
 Move find_best_move_with_tablebase(const Board* board, int depth, SearchStats* stats) {
-    Move best_move = {{0, 0}, {0, 0}, PIECE_NONE};
-    
-    stats->nodes_searched = 0;
-    stats->depth_reached = depth;
-    stats->eval = 0;
-    
-    /* First, try tablebase probe for endgame positions */
-    if (tablebase_is_endgame(board)) {
-        TablebaseProbeResult probe = tablebase_probe(board);
-        
-        if (probe.found) {
-            /* Found in tablebase - use the tablebase move */
-            stats->eval = (probe.wdl == WDL_WIN) ? (EVAL_MATE - probe.dtm) :
-                          (probe.wdl == WDL_LOSS) ? (-EVAL_MATE + probe.dtm) : EVAL_DRAW;
-            
-            /* Check if we have a best move from tablebase */
-            if (probe.best_move.from.q != 0 || probe.best_move.from.r != 0 ||
-                probe.best_move.to.q != 0 || probe.best_move.to.r != 0) {
-                return probe.best_move;
-            }
-            
-            /* For drawn positions, just pick any legal move */
-            if (probe.wdl == WDL_DRAW) {
-                return get_random_move(board);
-            }
-        }
-    }
-    
-    /* Fall back to alpha-beta search */
-    bool maximizing = (board->to_move == COLOR_WHITE);
-    stats->eval = alpha_beta((Board*)board, depth, -EVAL_INF, EVAL_INF, 
-                             maximizing, &best_move, stats);
-    
-    return best_move;
+    Move move;
+    if (book_root(board, &move, stats)) return move;
+    if (tablebase_root(board, &move, stats)) return move;
+    return find_best_move(board, depth, stats);
+}
+
+Move find_best_move_timed_with_tablebase(const Board* board, int time_ms, int max_depth,
+                                         SearchStats* stats) {
+    Move move;
+    if (book_root(board, &move, stats)) return move;
+    if (tablebase_root(board, &move, stats)) return move;
+    return find_best_move_timed(board, time_ms, max_depth, stats);
 }
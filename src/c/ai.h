@@ -11,21 +11,18 @@
 
 #include "board.h"
 #include "moves.h"
+#include "psqt.h"
 #include "tablebase.h"
+#include "tt.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Evaluation constants */
 #define EVAL_INF 100000
 #define EVAL_MATE 50000
 #define EVAL_DRAW 0
 
-/* Piece values */
-#define VALUE_PAWN 100
-#define VALUE_KNIGHT 300
-#define VALUE_LANCE 400
-#define VALUE_CHARIOT 400
-#define VALUE_QUEEN 900
-#define VALUE_KING 10000
-
 /* AI difficulty levels */
 typedef enum {
     AI_EASY = 1,      /* Depth 1 */
@@ -33,28 +30,165 @@ typedef enum {
     AI_HARD = 5       /* Depth 5 */
 } AIDifficulty;
 
-/* Search statistics */
+/* Deepest iteration find_best_move_timed will attempt */
+#define AI_MAX_DEPTH 32
+
+/* Most search threads ai_set_threads accepts */
+#define AI_MAX_THREADS 64
+
+/* Plies of SearchProfile.nodes_by_ply; deeper nodes count in the last */
+#define SEARCH_PROFILE_PLIES 64
+
+/* Detailed counters for finding where a search spends its time. They are
+ * compiled in only when building with -DUNDERCHEX_PROFILE (make
+ * PROFILE=1), so the default build pays nothing for them. Cycles are read
+ * from the CPU's cycle counter where there is one (nanoseconds elsewhere)
+ * around the move generation and evaluation calls of the search. */
+typedef struct {
+    uint64_t nodes_by_ply[SEARCH_PROFILE_PLIES];  /* Full-width nodes */
+    uint64_t quiescence_nodes;
+    uint64_t expanded_nodes;      /* Full-width nodes that searched a move */
+    uint64_t beta_cutoffs;        /* Expanded nodes that failed high */
+    uint64_t first_move_cutoffs;  /* ... on their first move */
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t tt_cutoffs;          /* Hits deep enough to answer the node */
+    uint64_t tb_probes;
+    uint64_t movegen_calls;
+    uint64_t movegen_cycles;
+    uint64_t eval_calls;
+    uint64_t eval_cycles;
+    uint64_t iteration_nodes[AI_MAX_DEPTH + 1];   /* Main thread, by completed depth */
+} SearchProfile;
+
+/* Search statistics. With several threads, nodes_searched, tb_hits and
+ * the profile count every thread's; depth_reached and eval are the main
+ * thread's. */
 typedef struct {
     int nodes_searched;
+    int tb_hits;            /* Nodes answered by an endgame table */
     int depth_reached;
     int eval;
+    bool from_book;         /* The move came from the opening book unsearched */
+#ifdef UNDERCHEX_PROFILE
+    SearchProfile profile;
+#endif
 } SearchStats;
 
-/* Evaluation function */
+/* Add the counters of stats (nodes, tablebase hits and the profile) into
+ * total, e.g. to sum the searches of a game */
+void search_stats_add(SearchStats* total, const SearchStats* stats);
+
+/* stats as one line of JSON. The profile and the rates derived from it
+ * (cutoff and hit rates, effective branching factor, cycles per call)
+ * are included when compiled in. Returns the length written, or that
+ * would have been written, like snprintf. */
+int search_stats_json(const SearchStats* stats, char* buf, int bufsize);
+
+/* Resize the search's transposition table (TT_DEFAULT_MB until set).
+ * Returns false if the memory could not be allocated. */
+bool ai_set_hash_size(size_t size_mb);
+
+/* Forget all stored search results */
+void ai_clear_hash(void);
+
+/* The best move a search with the default weights stored for board, if
+ * it is legal there. After a search, this is how it expects the
+ * opponent to answer the move it chose. */
+bool ai_hash_move(const Board* board, Move* move);
+
+/* Number of threads the find_best_move functions search with (1 until
+ * set, clamped to 1..AI_MAX_THREADS). Helper threads run a Lazy SMP
+ * search over the shared transposition table. */
+void ai_set_threads(int threads);
+int ai_get_threads(void);
+
+/* Static evaluation from White's perspective: the incremental material
+ * and piece-square sums, attack-count mobility and a check penalty. It
+ * does not look for mate or stalemate; the search does. */
 int evaluate(const Board* board);
 
+/* Evaluation terms a search can be given in place of the defaults, e.g.
+ * to tune them by self-play */
+typedef struct {
+    int piece_adjust[PIECE_KING + 1];  /* Added to the psqt.h value, by PieceType */
+    int mobility;                      /* Per cell a piece attacks */
+    int check_penalty;                 /* For standing in check */
+} EvalWeights;
+
+extern const EvalWeights EVAL_DEFAULT_WEIGHTS;
+
+/* evaluate with the given weights; evaluate uses EVAL_DEFAULT_WEIGHTS */
+int evaluate_weighted(const Board* board, const EvalWeights* weights);
+
 /* Find best move using alpha-beta search */
 Move find_best_move(const Board* board, int depth, SearchStats* stats);
 
-/* Alpha-beta search with move ordering */
-int alpha_beta(Board* board, int depth, int alpha, int beta, bool maximizing, 
-               Move* best_move, SearchStats* stats);
+/* Iterative deepening within a time budget. Searches depth 1, 2, ... up
+ * to max_depth, ordering each iteration by the previous one's PV and
+ * searching inside an aspiration window around its score. An iteration
+ * cut off by the deadline is discarded; depth 1 always completes.
+ * stats->depth_reached is the last completed depth. */
+Move find_best_move_timed(const Board* board, int time_ms, int max_depth,
+                          SearchStats* stats);
+
+/* Null-move pruning and late-move reductions (both on until set). With
+ * both off the search is a full-width principal variation search. */
+void ai_set_selective(bool null_move, bool reductions);
+
+/* Negamax alpha-beta with principal variation search, a quiescence stage
+ * and the selective extensions above. Scores are from the side to move's
+ * point of view. At the root (best_move non-NULL) a move already held in
+ * *best_move is searched first, and the best move is stored there. */
+int alpha_beta(Board* board, int depth, int alpha, int beta, Move* best_move,
+               SearchStats* stats);
 
 /* Get a random legal move (for testing/fallback) */
 Move get_random_move(const Board* board);
 
+/* Play from the opening book at path (see book.h) before searching, or
+ * from no book if path is NULL. The book is mapped, not read, so every
+ * process using it shares one copy. Consulted by the _with_tablebase
+ * functions and by find_best_move_limited with use_book; not to be
+ * called while they run. Returns false, leaving no book, if path is not
+ * a valid book. */
+bool ai_set_book(const char* path);
+
 /* Find best move with tablebase integration.
- * First probes tablebase for endgame positions, then falls back to alpha-beta search. */
+ * A position in the opening book plays a book move. A won endgame root
+ * plays the tablebase move. Otherwise this is
+ * find_best_move, after building the on-demand tables a root this close to
+ * the endgame can reach, so the search can probe them. Every search probes
+ * the tables that are already generated. */
 Move find_best_move_with_tablebase(const Board* board, int depth, SearchStats* stats);
 
+/* find_best_move_timed with the same book and tablebase integration */
+Move find_best_move_timed_with_tablebase(const Board* board, int time_ms, int max_depth,
+                                         SearchStats* stats);
+
+/* Limits for find_best_move_limited */
+typedef struct {
+    int max_depth;          /* Deepest iteration, up to AI_MAX_DEPTH */
+    int time_ms;            /* Budget, or negative for none */
+    atomic_bool* stop;      /* Raised by another thread to finish early, or NULL */
+    bool use_tablebase;     /* Play won endgames from the tablebase */
+    bool use_book;          /* Play book moves in the opening */
+    const EvalWeights* weights;  /* Evaluation, or NULL for the defaults */
+    const MoveList* root_moves;  /* The root's legal moves if already known, or NULL */
+    TranspositionTable* tt;      /* A table of the caller's own, or NULL for the shared one */
+} SearchLimits;
+
+/* Iterative deepening like find_best_move_timed, which it generalises:
+ * the search also ends when *stop is raised, keeping the last completed
+ * iteration (depth 1 always completes). Any number of threads may each
+ * run one of these at a time, sharing the transposition table unless
+ * limits->tt gives one of the search's own. A search that needs a result
+ * independent of other searches (e.g. to label positions reproducibly)
+ * passes a table only it uses, cleared first. With
+ * use_tablebase the tables must already be generated (e.g. by
+ * tablebase_generate_all) before searches run concurrently, and
+ * ai_set_hash_size and ai_clear_hash must not be called during them. */
+Move find_best_move_limited(const Board* board, const SearchLimits* limits,
+                            SearchStats* stats);
+
 #endif /* UNDERCHEX_AI_H */
@@ -0,0 +1,193 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Batch position analysis (see analyze.h)
+ */
+
+#include "analyze.h"
+#include "ai.h"
+#include "tablebase.h"
+
+/* Records a thread claims at a time */
+#define ANALYZE_CHUNK 256
+
+/* Each thread's table for search labels, cleared for every position so a
+ * label depends only on the position and not on what was searched before
+ * or alongside it. Small, since clearing it is paid per position. */
+#define ANALYZE_TT_BYTES (256 * 1024)
+
+static _Thread_local TranspositionTable analyze_tt;
+
+bool analyze_position(const Board* board, const AnalysisConfig* config,
+                      PositionLabel* label) {
+    label->kind = config->kind;
+    label->move = MOVE_CODE_NONE;
+    label->depth = 0;
+    
+    switch (config->kind) {
+        case ANALYSIS_EVAL:
+            label->score = evaluate(board);
+            return true;
+        
+        case ANALYSIS_SEARCH: {
+            if (!analyze_tt.slots && !tt_init_bytes(&analyze_tt, ANALYZE_TT_BYTES)) return false;
+            tt_clear(&analyze_tt);
+            SearchLimits limits = {config->depth, -1, NULL, false, false, NULL, NULL, &analyze_tt};
+            SearchStats stats;
+            Move move = find_best_move_limited(board, &limits, &stats);
+            label->score = stats.eval;
+            label->move = move_encode(move);
+            label->depth = stats.depth_reached;
+            return true;
+        }
+        
+        case ANALYSIS_TABLEBASE: {
+            TablebaseProbeResult probe = tablebase_probe(board);
+            if (!probe.found) return false;
+            int score = probe.wdl == WDL_WIN ? EVAL_MATE - probe.dtm
+                      : probe.wdl == WDL_LOSS ? -EVAL_MATE + probe.dtm : EVAL_DRAW;
+            label->score = board->to_move == COLOR_WHITE ? score : -score;
+            if (probe.wdl == WDL_WIN) label->move = move_encode(probe.best_move);
+            label->depth = probe.dtm;
+            return true;
+        }
+        
+        default:
+            return false;
+    }
+}
+
+/* Label records [start, end) of the batch in progress, counting into
+ * *labelled and *invalid */
+static void label_chunk(const AnalysisPool* pool, long start, long end,
+                        long* labelled, long* invalid) {
+    for (long i = start; i < end; i++) {
+        PositionRecord* record = &pool->records[i];
+        Board board;
+        PositionLabel label;
+        bool valid = position_unpack(record, &board);
+        if (!valid) (*invalid)++;
+        if (pool->config.kind == ANALYSIS_NONE) continue;
+        
+        if (!valid) {
+            label.kind = ANALYSIS_NONE;
+        } else if (analyze_position(&board, &pool->config, &label)) {
+            (*labelled)++;
+        } else {
+            label.kind = ANALYSIS_NONE;
+        }
+        if (label.kind == ANALYSIS_NONE) {
+            label.score = 0;
+            label.move = MOVE_CODE_NONE;
+            label.depth = 0;
+        }
+        position_set_label(record, &label);
+    }
+}
+
+/* Label chunks of the batch in progress until none is left unclaimed.
+ * Called and returns with pool->lock held. */
+static void claim_chunks(AnalysisPool* pool) {
+    while (pool->next < pool->count) {
+        long start = pool->next;
+        long end = start + ANALYZE_CHUNK < pool->count ? start + ANALYZE_CHUNK : pool->count;
+        pool->next = end;
+        pool->busy++;
+        pthread_mutex_unlock(&pool->lock);
+        
+        long labelled = 0, invalid = 0;
+        label_chunk(pool, start, end, &labelled, &invalid);
+        
+        pthread_mutex_lock(&pool->lock);
+        pool->labelled += labelled;
+        pool->invalid += invalid;
+        pool->busy--;
+        if (pool->next >= pool->count && pool->busy == 0) {
+            pthread_cond_broadcast(&pool->done);
+        }
+    }
+}
+
+static void* analyze_worker(void* arg) {
+    AnalysisPool* pool = arg;
+    
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && pool->next >= pool->count) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->next >= pool->count) break;
+        claim_chunks(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    tt_free(&analyze_tt);
+    return NULL;
+}
+
+void analyze_pool_start(AnalysisPool* pool, const AnalysisConfig* config, int threads) {
+    pool->config = *config;
+    pool->records = NULL;
+    pool->count = pool->next = 0;
+    pool->busy = 0;
+    pool->labelled = pool->invalid = 0;
+    pool->stopping = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    
+    if (threads < 1) threads = 1;
+    if (threads > ANALYZE_MAX_THREADS) threads = ANALYZE_MAX_THREADS;
+    for (pool->started = 0; pool->started < threads; pool->started++) {
+        if (pthread_create(&pool->workers[pool->started], NULL, analyze_worker, pool) != 0) break;
+    }
+}
+
+void analyze_pool_submit(AnalysisPool* pool, PositionRecord* records, long count) {
+    pthread_mutex_lock(&pool->lock);
+    pool->records = records;
+    pool->count = count;
+    pool->next = 0;
+    pool->labelled = pool->invalid = 0;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void analyze_pool_wait(AnalysisPool* pool, AnalysisTotals* totals) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->started == 0) claim_chunks(pool);
+    while (pool->next < pool->count || pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    totals->records += pool->count;
+    totals->labelled += pool->labelled;
+    totals->invalid += pool->invalid;
+    pool->records = NULL;
+    pool->count = pool->next = 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void analyze_pool_stop(AnalysisPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+void analyze_records(PositionRecord* records, long count, const AnalysisConfig* config,
+                     int threads, AnalysisTotals* totals) {
+    /* No more threads than chunks */
+    long chunks = (count + ANALYZE_CHUNK - 1) / ANALYZE_CHUNK;
+    if (threads > chunks) threads = (int)chunks;
+    
+    AnalysisPool pool;
+    analyze_pool_start(&pool, config, threads);
+    analyze_pool_submit(&pool, records, count);
+    analyze_pool_wait(&pool, totals);
+    analyze_pool_stop(&pool);
+}
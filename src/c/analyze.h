@@ -0,0 +1,83 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Batch position analysis
+ *
+ * Labels position records (see position.h) with the static evaluation, a
+ * fixed-depth search or the endgame tablebase result. An AnalysisPool
+ * keeps its threads for the whole run and labels one batch at a time,
+ * which the caller hands over and waits for; the analyze tool reads the
+ * next batch and writes the last while the pool labels the current one.
+ */
+
+#ifndef UNDERCHEX_ANALYZE_H
+#define UNDERCHEX_ANALYZE_H
+
+#include "position.h"
+#include <pthread.h>
+
+typedef struct {
+    AnalysisKind kind;        /* ANALYSIS_NONE leaves the labels alone */
+    int depth;                /* For ANALYSIS_SEARCH */
+} AnalysisConfig;
+
+/* Counts over the records analysed */
+typedef struct {
+    long records;
+    long labelled;
+    long invalid;             /* Not a valid position; left unlabelled */
+} AnalysisTotals;
+
+/* Label one position. Returns false, labelling nothing, if the analysis
+ * has no answer for it: a position in no generated tablebase, or any
+ * position for ANALYSIS_NONE. Safe to call from several threads at once;
+ * for ANALYSIS_TABLEBASE the tables must be generated first. A search
+ * label comes from a table private to the calling thread, cleared first,
+ * so with ai_set_threads(1) it is the same on every run. The table is
+ * allocated on the thread's first search label and kept for its later
+ * ones; a pool's threads free theirs when the pool stops. */
+bool analyze_position(const Board* board, const AnalysisConfig* config,
+                      PositionLabel* label);
+
+#define ANALYZE_MAX_THREADS 256
+
+/* Worker threads labelling the batch in progress */
+typedef struct {
+    AnalysisConfig config;
+    pthread_t workers[ANALYZE_MAX_THREADS];
+    int started;
+    
+    pthread_mutex_t lock;     /* Guards the fields below */
+    pthread_cond_t work;      /* A batch was submitted, or the pool stops */
+    pthread_cond_t done;      /* The batch's last chunk was labelled */
+    PositionRecord* records;  /* The batch, or NULL between batches */
+    long count;
+    long next;                /* First record no thread has claimed */
+    int busy;                 /* Threads labelling a claimed chunk */
+    long labelled;            /* Of the batch so far */
+    long invalid;
+    bool stopping;
+} AnalysisPool;
+
+/* Start up to threads threads (at least one) that label with config. If
+ * none can be started, analyze_pool_wait labels each batch itself. The
+ * tablebases must be generated first for ANALYSIS_TABLEBASE. */
+void analyze_pool_start(AnalysisPool* pool, const AnalysisConfig* config, int threads);
+
+/* Hand the pool count records to label in place, and return at once; the
+ * records must stay untouched until analyze_pool_wait. Records that are
+ * not valid positions, or have no answer, are written back unlabelled;
+ * ANALYSIS_NONE only counts the invalid ones. One batch at a time. */
+void analyze_pool_submit(AnalysisPool* pool, PositionRecord* records, long count);
+
+/* Wait until the submitted batch is labelled, adding its counts to totals */
+void analyze_pool_wait(AnalysisPool* pool, AnalysisTotals* totals);
+
+/* Join the threads, once no batch is in progress */
+void analyze_pool_stop(AnalysisPool* pool);
+
+/* Label one batch of count records with a pool of up to threads threads
+ * started for it, adding to totals */
+void analyze_records(PositionRecord* records, long count, const AnalysisConfig* config,
+                     int threads, AnalysisTotals* totals);
+
+#endif /* UNDERCHEX_ANALYZE_H */
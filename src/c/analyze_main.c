@@ -0,0 +1,253 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Batch position analysis tool (see analyze.h and position.h)
+ *
+ * Usage: ./analyze [options] [FILE]
+ * Options:
+ *   -e        Label with the static evaluation (default)
+ *   -d N      Label with a search to depth N
+ *   -t        Label with the endgame tablebase result
+ *   -n        Only convert, keeping the labels as they are
+ *   -T        Read text positions, one per line, instead of records
+ *   -P        Write text lines instead of records
+ *   -j N      Analyse with N threads (default: one per core)
+ *   -o FILE   Write to FILE instead of stdout
+ *   -h        Show help
+ *
+ * Reads position records from FILE, or stdin if none is given, and writes
+ * them labelled, in the same order, so a file of millions can be piped
+ * through. Text input skips blank lines and lines starting with "#"; a
+ * line that is not a position becomes an invalid record. A text output
+ * line is the position, then the label's kind (none, eval, search or
+ * tablebase), score, move in engine notation (- for none) and depth, or
+ * "invalid". The counts and the rate go to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "analyze.h"
+#include "ai.h"
+#include "engine.h"
+#include "tablebase.h"
+
+/* Records read, analysed and written at a time. Three batches are in
+ * flight: one being read, one labelled and one written. */
+#define BATCH_RECORDS 65536
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options] [FILE]\n", prog);
+    printf("Options:\n");
+    printf("  -e        Label with the static evaluation (default)\n");
+    printf("  -d N      Label with a search to depth N\n");
+    printf("  -t        Label with the endgame tablebase result\n");
+    printf("  -n        Only convert, keeping the labels as they are\n");
+    printf("  -T        Read text positions, one per line, instead of records\n");
+    printf("  -P        Write text lines instead of records\n");
+    printf("  -j N      Analyse with N threads (default: one per core)\n");
+    printf("  -o FILE   Write to FILE instead of stdout\n");
+    printf("  -h        Show this help\n");
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Read up to max records. A partial record at the end of the input is
+ * reported and dropped. */
+static long read_records(FILE* in, PositionRecord* records, long max) {
+    size_t bytes = fread(records, 1, (size_t)max * sizeof(PositionRecord), in);
+    if (bytes % sizeof(PositionRecord) != 0) {
+        fprintf(stderr, "Dropped a partial record of %zu bytes at the end of the input\n",
+                bytes % sizeof(PositionRecord));
+    }
+    return (long)(bytes / sizeof(PositionRecord));
+}
+
+/* Read up to max text positions, counting input lines in *line_number */
+static long read_text(FILE* in, PositionRecord* records, long max, long* line_number) {
+    char line[POSITION_TEXT_MAX * 2];
+    long count = 0;
+    while (count < max && fgets(line, sizeof(line), in)) {
+        (*line_number)++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        Board board;
+        if (position_from_text(line, &board)) {
+            position_pack(&board, &records[count]);
+        } else {
+            fprintf(stderr, "Line %ld is not a position\n", *line_number);
+            memset(&records[count], 0, sizeof(PositionRecord));
+        }
+        count++;
+    }
+    return count;
+}
+
+static void write_text(FILE* out, const PositionRecord* records, long count) {
+    static const char* KINDS[] = {"none", "eval", "search", "tablebase"};
+    for (long i = 0; i < count; i++) {
+        Board board;
+        if (!position_unpack(&records[i], &board)) {
+            fputs("invalid\n", out);
+            continue;
+        }
+        
+        char text[POSITION_TEXT_MAX];
+        char move[32] = "-";
+        PositionLabel label;
+        position_to_text(&board, text, sizeof(text));
+        position_get_label(&records[i], &label);
+        if (label.move != MOVE_CODE_NONE) {
+            engine_format_move(move_decode(label.move), move, sizeof(move));
+        }
+        fprintf(out, "%s %s %d %s %d\n", text, KINDS[label.kind], label.score, move,
+                label.depth);
+    }
+}
+
+/* Read the next batch, text positions or records */
+static long read_batch(FILE* in, bool text_in, PositionRecord* records, long* line_number) {
+    return text_in ? read_text(in, records, BATCH_RECORDS, line_number)
+                   : read_records(in, records, BATCH_RECORDS);
+}
+
+/* Write count records, as text lines or as they are. Returns false if
+ * the output fails. */
+static bool write_batch(FILE* out, bool text_out, const PositionRecord* records, long count) {
+    if (text_out) {
+        write_text(out, records, count);
+        return !ferror(out);
+    }
+    return fwrite(records, sizeof(PositionRecord), (size_t)count, out) == (size_t)count;
+}
+
+int main(int argc, char* argv[]) {
+    AnalysisConfig config = {ANALYSIS_EVAL, 0};
+    bool text_in = false, text_out = false;
+    int threads = tablebase_default_threads();
+    const char* output = NULL;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "ed:tnTPj:o:h")) != -1) {
+        switch (opt) {
+            case 'e':
+                config.kind = ANALYSIS_EVAL;
+                break;
+            case 'd':
+                config.kind = ANALYSIS_SEARCH;
+                config.depth = atoi(optarg);
+                break;
+            case 't':
+                config.kind = ANALYSIS_TABLEBASE;
+                break;
+            case 'n':
+                config.kind = ANALYSIS_NONE;
+                break;
+            case 'T':
+                text_in = true;
+                break;
+            case 'P':
+                text_out = true;
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind < argc - 1 ||
+        (config.kind == ANALYSIS_SEARCH && (config.depth < 1 || config.depth > AI_MAX_DEPTH))) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    
+    FILE* in = stdin;
+    if (optind < argc && !(in = fopen(argv[optind], text_in ? "r" : "rb"))) {
+        perror(argv[optind]);
+        return 1;
+    }
+    FILE* out = stdout;
+    if (output && !(out = fopen(output, text_out ? "w" : "wb"))) {
+        perror(output);
+        return 1;
+    }
+    
+    PositionRecord* batches[3];
+    for (int i = 0; i < 3; i++) {
+        if (!(batches[i] = malloc(sizeof(PositionRecord) * BATCH_RECORDS))) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+    
+    /* Each position searches single-threaded; the parallelism is across
+     * positions */
+    ai_set_threads(1);
+    if (config.kind == ANALYSIS_TABLEBASE) tablebase_generate_all();
+    
+    AnalysisPool pool;
+    analyze_pool_start(&pool, &config, threads);
+    
+    /* While the pool labels the current batch, this thread writes the
+     * previous one and reads the next */
+    AnalysisTotals totals = {0, 0, 0};
+    long line_number = 0;
+    double start = now_seconds();
+    long counts[3] = {0, 0, 0};
+    int current = 0;
+    counts[current] = read_batch(in, text_in, batches[current], &line_number);
+    bool written = true;
+    while (counts[current] > 0) {
+        int previous = (current + 2) % 3;
+        int next = (current + 1) % 3;
+        analyze_pool_submit(&pool, batches[current], counts[current]);
+        if (counts[previous] > 0) {
+            written = write_batch(out, text_out, batches[previous], counts[previous]);
+            counts[previous] = 0;
+        }
+        if (written) counts[next] = read_batch(in, text_in, batches[next], &line_number);
+        analyze_pool_wait(&pool, &totals);
+        if (!written) break;
+        current = next;
+    }
+    int last = (current + 2) % 3;
+    if (written && counts[last] > 0) {
+        written = write_batch(out, text_out, batches[last], counts[last]);
+    }
+    analyze_pool_stop(&pool);
+    double elapsed = now_seconds() - start;
+    if (!written) {
+        perror("write");
+        return 1;
+    }
+    
+    fprintf(stderr, "%ld records, %ld labelled, %ld invalid in %.2f s (%.0f records/s)\n",
+            totals.records, totals.labelled, totals.invalid, elapsed,
+            elapsed > 0 ? totals.records / elapsed : 0.0);
+    
+    for (int i = 0; i < 3; i++) free(batches[i]);
+    if (in != stdin) fclose(in);
+    if (out != stdout && fclose(out) != 0) {
+        perror(output);
+        return 1;
+    }
+    tablebase_cleanup();
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Bitboard attack detection (the tables are in the generated geometry.c)
+ */
+
+#include "bitboard.h"
+
+_Static_assert(NUM_CELLS <= 64, "the hex must fit in a 64-bit mask");
+_Static_assert(BB_KIND_COUNT == PIECE_KINDS, "Board.kinds must hold every kind");
+
+bool bb_cell_attacked(const Board* board, int cell, Color by_color, Bitboard occupied) {
+    Bitboard attackers = board->occupied[by_color - 1];
+    
+    if (bb_knight_attacks[cell] & attackers & board->kinds[BB_KNIGHT]) return true;
+    if (bb_king_attacks[cell] & attackers & board->kinds[BB_KING]) return true;
+    
+    /* A pawn attacks the cell from where an opposing pawn on it would capture */
+    if (bb_pawn_attacks[opponent_color(by_color) - 1][cell] & attackers &
+        board->kinds[BB_PAWN]) {
+        return true;
+    }
+    
+    for (int dir = 0; dir < 6; dir++) {
+        Bitboard riders = attackers & bb_riders_along(board, dir);
+        if ((bb_rays[dir][cell] & riders) &&
+            (bb_ray_attacks(dir, cell, occupied) & riders)) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+Bitboard bb_piece_attacks(Piece piece, int cell, Bitboard occupied) {
+    static const int LANCE_A[4] = {DIR_N, DIR_S, DIR_NW, DIR_SE};
+    static const int LANCE_B[4] = {DIR_N, DIR_S, DIR_NE, DIR_SW};
+    static const int CHARIOT[4] = {DIR_NE, DIR_SW, DIR_NW, DIR_SE};
+    
+    Bitboard attacks = 0;
+    switch (piece.type) {
+        case PIECE_PAWN:
+            return bb_pawn_attacks[piece.color - 1][cell];
+        case PIECE_KNIGHT:
+            return bb_knight_attacks[cell];
+        case PIECE_KING:
+            return bb_king_attacks[cell];
+        case PIECE_LANCE:
+            for (int i = 0; i < 4; i++) {
+                attacks |= bb_ray_attacks(piece.variant ? LANCE_B[i] : LANCE_A[i], cell, occupied);
+            }
+            return attacks;
+        case PIECE_CHARIOT:
+            for (int i = 0; i < 4; i++) {
+                attacks |= bb_ray_attacks(CHARIOT[i], cell, occupied);
+            }
+            return attacks;
+        case PIECE_QUEEN:
+            for (int dir = 0; dir < 6; dir++) {
+                attacks |= bb_ray_attacks(dir, cell, occupied);
+            }
+            return attacks;
+        default:
+            return 0;
+    }
+}
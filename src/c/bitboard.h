@@ -0,0 +1,97 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Bitboards over the 61 hex cells
+ *
+ * Bit i of a Bitboard is the cell with dense index i (cell_to_index).
+ * Board keeps one occupancy mask per colour and one per piece kind,
+ * updated alongside its mailbox. Leaper attacks come from per-cell
+ * tables, generated with the rest of the geometry (see geometry.h).
+ * Rider attacks use per-cell rays: the first blocker on a ray is its
+ * lowest or highest set bit, depending on which way the dense index runs
+ * along that direction, and the ray beyond it is masked off.
+ */
+
+#ifndef UNDERCHEX_BITBOARD_H
+#define UNDERCHEX_BITBOARD_H
+
+#include "board.h"
+#include <stdint.h>
+
+typedef uint64_t Bitboard;
+
+#define BB_CELL(index) ((Bitboard)1 << (index))
+
+/* Piece kinds with their own mask; the two lance variants move differently */
+typedef enum {
+    BB_PAWN = 0,
+    BB_KNIGHT,
+    BB_LANCE_A,
+    BB_LANCE_B,
+    BB_CHARIOT,
+    BB_QUEEN,
+    BB_KING,
+    BB_KIND_COUNT
+} BitboardKind;
+
+extern const Bitboard bb_knight_attacks[NUM_CELLS];
+extern const Bitboard bb_king_attacks[NUM_CELLS];
+extern const Bitboard bb_pawn_attacks[2][NUM_CELLS];   /* [color - 1][cell] */
+extern const Bitboard bb_rays[6][NUM_CELLS];           /* Cells beyond 'cell' along DIRECTIONS */
+
+/* Dense cell index of each mailbox square (-1 off the hex), and back */
+extern const int8_t bb_square_index[BOARD_SQUARES];
+extern const uint8_t bb_index_square[NUM_CELLS];
+
+static inline int bb_kind(Piece p) {
+    static const int8_t KINDS[8] = {-1, BB_PAWN, BB_KNIGHT, BB_LANCE_A, BB_CHARIOT,
+                                    BB_QUEEN, BB_KING, -1};
+    return KINDS[p.type] + (p.type == PIECE_LANCE && p.variant);
+}
+
+static inline int bb_first(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+
+static inline int bb_last(Bitboard b) {
+    return 63 - __builtin_clzll(b);
+}
+
+static inline int bb_popcount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+/* Cells a rider on 'cell' reaches along dir, up to and including the
+ * first occupied one */
+static inline Bitboard bb_ray_attacks(int dir, int cell, Bitboard occupied) {
+    /* S, NE and SE run towards higher dense indices */
+    static const bool ASCENDING[6] = {false, true, true, false, false, true};
+    
+    Bitboard ray = bb_rays[dir][cell];
+    Bitboard blockers = ray & occupied;
+    if (blockers) {
+        int first = ASCENDING[dir] ? bb_first(blockers) : bb_last(blockers);
+        ray ^= bb_rays[dir][first];
+    }
+    return ray;
+}
+
+/* Kinds that ride along dir (and its opposite) */
+static inline Bitboard bb_riders_along(const Board* board, int dir) {
+    Bitboard riders = board->kinds[BB_QUEEN];
+    if (dir == DIR_N || dir == DIR_S) {
+        riders |= board->kinds[BB_LANCE_A] | board->kinds[BB_LANCE_B];
+    } else if (dir == DIR_NW || dir == DIR_SE) {
+        riders |= board->kinds[BB_LANCE_A] | board->kinds[BB_CHARIOT];
+    } else {
+        riders |= board->kinds[BB_LANCE_B] | board->kinds[BB_CHARIOT];
+    }
+    return riders;
+}
+
+/* Whether by_color attacks the cell, with 'occupied' as the blockers */
+bool bb_cell_attacked(const Board* board, int cell, Color by_color, Bitboard occupied);
+
+/* Every cell the piece on 'cell' attacks, given the blockers */
+Bitboard bb_piece_attacks(Piece piece, int cell, Bitboard occupied);
+
+#endif /* UNDERCHEX_BITBOARD_H */
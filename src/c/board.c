@@ -6,6 +6,10 @@
  */
 
 #include "board.h"
+#include "bitboard.h"
+#include "geometry.h"
+#include "psqt.h"
+#include "zobrist.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -47,26 +51,78 @@ bool cell_equals(Cell a, Cell b) {
     return a.q == b.q && a.r == b.r;
 }
 
-/* Check if cell is within hex board bounds */
+/* Check if cell is within hex board bounds: inside the bounding box and
+ * on a square the geometry tables number */
 bool cell_is_valid(Cell c) {
-    int s = -c.q - c.r;
-    return max3_int(abs_int(c.q), abs_int(c.r), abs_int(s)) <= BOARD_RADIUS;
+    return c.q >= MIN_Q && c.q <= MAX_Q && c.r >= MIN_R && c.r <= MAX_R &&
+           bb_square_index[cell_square(c)] >= 0;
 }
 
-/* Convert axial coords to array index */
-static inline int q_to_idx(int q) { return q + BOARD_RADIUS; }
-static inline int r_to_idx(int r) { return r + BOARD_RADIUS; }
+int cell_to_index(Cell c) {
+    return cell_is_valid(c) ? bb_square_index[cell_square(c)] : -1;
+}
 
-Piece* board_get(Board* board, Cell c) {
-    if (!cell_is_valid(c)) return NULL;
-    return &board->cells[q_to_idx(c.q)][r_to_idx(c.r)];
+Cell cell_from_index(int index) {
+    return (index >= 0 && index < NUM_CELLS) ? geo_index_cell[index] : cell_make(0, 0);
 }
 
-void board_set(Board* board, Cell c, Piece piece) {
-    if (!cell_is_valid(c)) return;
-    board->cells[q_to_idx(c.q)][r_to_idx(c.r)] = piece;
-    
-    /* Track king positions */
+/* Zobrist tables are indexed by position in the hex's bounding box */
+static inline uint64_t cell_key(Cell c, Piece piece) {
+    return zobrist_piece(c.q + BOARD_RADIUS, c.r + BOARD_RADIUS, piece);
+}
+
+/* Pieces that belong on a colour's piece list */
+static inline bool piece_listed(Piece p) {
+    return p.type != PIECE_NONE && p.color != COLOR_NONE;
+}
+
+/* Flip a listed piece's bit in the colour and kind bitboards */
+static inline void toggle_bits(Board* board, int square, Piece piece) {
+    Bitboard bit = BB_CELL(bb_square_index[square]);
+    board->occupied[piece.color - 1] ^= bit;
+    board->kinds[bb_kind(piece)] ^= bit;
+}
+
+/* Add or take away a listed piece's piece-square value */
+static inline void add_psqt(Board* board, int square, Piece piece) {
+    board->psqt[piece.color - 1] += psqt_value(piece, square);
+}
+
+static inline void sub_psqt(Board* board, int square, Piece piece) {
+    board->psqt[piece.color - 1] -= psqt_value(piece, square);
+}
+
+static void list_add(Board* board, int square, Color color) {
+    int side = color - 1;
+    int slot = board->piece_count[side]++;
+    board->pieces[side][slot] = (uint8_t)square;
+    board->piece_slot[square] = (uint8_t)slot;
+}
+
+/* Remove by moving the list's last entry into the freed slot */
+static int list_remove(Board* board, int square, Color color) {
+    int side = color - 1;
+    int slot = board->piece_slot[square];
+    int last = --board->piece_count[side];
+    int moved = board->pieces[side][last];
+    board->pieces[side][slot] = (uint8_t)moved;
+    board->piece_slot[moved] = (uint8_t)slot;
+    board->piece_slot[square] = 0;
+    return slot;
+}
+
+/* Undo list_remove: the slot's current entry goes back to the end */
+static void list_restore(Board* board, int square, Color color, int slot) {
+    int side = color - 1;
+    int last = board->piece_count[side]++;
+    int moved = board->pieces[side][slot];
+    board->pieces[side][last] = (uint8_t)moved;
+    board->piece_slot[moved] = (uint8_t)last;
+    board->pieces[side][slot] = (uint8_t)square;
+    board->piece_slot[square] = (uint8_t)slot;
+}
+
+static void track_king(Board* board, Cell c, Piece piece) {
     if (piece.type == PIECE_KING) {
         if (piece.color == COLOR_WHITE) {
             board->white_king = c;
@@ -76,8 +132,96 @@ void board_set(Board* board, Cell c, Piece piece) {
     }
 }
 
+Piece* board_get(Board* board, Cell c) {
+    if (!cell_is_valid(c)) return NULL;
+    return &board->squares[cell_square(c)];
+}
+
+void board_set(Board* board, Cell c, Piece piece) {
+    if (!cell_is_valid(c)) return;
+    
+    int square = cell_square(c);
+    Piece old = board->squares[square];
+    if (piece_listed(old)) {
+        list_remove(board, square, old.color);
+        toggle_bits(board, square, old);
+        sub_psqt(board, square, old);
+    }
+    
+    board->hash ^= cell_key(c, old) ^ cell_key(c, piece);
+    board->squares[square] = piece;
+    if (piece_listed(piece)) {
+        list_add(board, square, piece.color);
+        toggle_bits(board, square, piece);
+        add_psqt(board, square, piece);
+    }
+    
+    /* Track king positions */
+    track_king(board, c, piece);
+}
+
+void board_move_piece(Board* board, Cell from, Cell to, Piece piece) {
+    int from_sq = cell_square(from);
+    int to_sq = cell_square(to);
+    Piece old = board->squares[from_sq];
+    
+    board->hash ^= cell_key(from, old) ^ cell_key(to, piece);
+    board->squares[from_sq] = (Piece){PIECE_NONE, COLOR_NONE, 0};
+    board->squares[to_sq] = piece;
+    
+    if (piece_listed(piece)) {
+        toggle_bits(board, from_sq, old);
+        toggle_bits(board, to_sq, piece);
+        sub_psqt(board, from_sq, old);
+        add_psqt(board, to_sq, piece);
+        
+        int slot = board->piece_slot[from_sq];
+        board->pieces[piece.color - 1][slot] = (uint8_t)to_sq;
+        board->piece_slot[to_sq] = (uint8_t)slot;
+        board->piece_slot[from_sq] = 0;
+    }
+    
+    track_king(board, to, piece);
+}
+
+int board_remove_piece(Board* board, Cell c) {
+    int square = cell_square(c);
+    Piece old = board->squares[square];
+    
+    board->hash ^= cell_key(c, old);
+    board->squares[square] = (Piece){PIECE_NONE, COLOR_NONE, 0};
+    if (!piece_listed(old)) return 0;
+    
+    toggle_bits(board, square, old);
+    sub_psqt(board, square, old);
+    return list_remove(board, square, old.color);
+}
+
+void board_restore_piece(Board* board, Cell c, Piece piece, int slot) {
+    int square = cell_square(c);
+    
+    board->hash ^= cell_key(c, piece);
+    board->squares[square] = piece;
+    if (piece_listed(piece)) {
+        list_restore(board, square, piece.color, slot);
+        toggle_bits(board, square, piece);
+        add_psqt(board, square, piece);
+    }
+    track_king(board, c, piece);
+}
+
 void board_clear(Board* board) {
+    zobrist_init();
+    psqt_init();
     memset(board, 0, sizeof(Board));
+    
+    /* Everything outside the hex is a sentinel */
+    for (int square = 0; square < BOARD_SQUARES; square++) {
+        if (bb_square_index[square] < 0) {
+            board->squares[square] = (Piece){PIECE_OFFBOARD, COLOR_NONE, 0};
+        }
+    }
+    
     board->to_move = COLOR_WHITE;
     board->white_king = cell_make(0, 0);
     board->black_king = cell_make(0, 0);
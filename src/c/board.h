@@ -21,6 +21,9 @@
 /* Board array dimensions (for storage) */
 #define BOARD_SIZE (2 * BOARD_RADIUS + 1)
 
+/* Number of valid cells on the hex board (61 for radius 4) */
+#define NUM_CELLS (3 * BOARD_RADIUS * (BOARD_RADIUS + 1) + 1)
+
 /* Piece types */
 typedef enum {
     PIECE_NONE = 0,
@@ -29,7 +32,8 @@ typedef enum {
     PIECE_LANCE = 3,
     PIECE_CHARIOT = 4,
     PIECE_QUEEN = 5,
-    PIECE_KING = 6
+    PIECE_KING = 6,
+    PIECE_OFFBOARD = 7    /* Sentinel on the padding squares of Board.squares */
 } PieceType;
 
 /* Player colors */
@@ -39,11 +43,15 @@ typedef enum {
     COLOR_BLACK = 2
 } Color;
 
-/* A piece with its color */
+/* Piece kinds with their own bitboard: the lance variants count apart */
+#define PIECE_KINDS 7
+
+/* A piece with its color, packed into one byte. The fields fill the byte,
+ * so there are no padding bits to hold garbage and boards compare with memcmp. */
 typedef struct {
-    PieceType type;
-    Color color;
-    uint8_t variant;  /* For lance: 0=A (N,S,NW,SE), 1=B (N,S,NE,SW) */
+    uint8_t type : 3;     /* PieceType */
+    uint8_t color : 2;    /* Color */
+    uint8_t variant : 3;  /* For lance: 0=A (N,S,NW,SE), 1=B (N,S,NE,SW) */
 } Piece;
 
 /* Axial coordinates */
@@ -70,20 +78,62 @@ extern const Direction DIRECTIONS[6];
 /* Direction names for display */
 extern const char* DIRECTION_NAMES[6];
 
+/* Padded mailbox. The board's bounding box is surrounded by BOARD_PADDING
+ * rings of PIECE_OFFBOARD squares, as are the box corners outside the hex,
+ * so a step or knight jump from any cell lands inside the array and a
+ * rider stops at the edge without bounds checks. A direction is a fixed
+ * offset between square numbers. */
+#define BOARD_PADDING 2
+#define BOARD_STRIDE (BOARD_SIZE + 2 * BOARD_PADDING)
+#define BOARD_SQUARES (BOARD_STRIDE * BOARD_STRIDE)
+#define SQUARE_ORIGIN (BOARD_RADIUS + BOARD_PADDING)
+
+static inline int cell_square(Cell c) {
+    return (c.q + SQUARE_ORIGIN) * BOARD_STRIDE + (c.r + SQUARE_ORIGIN);
+}
+
+static inline Cell square_cell(int square) {
+    Cell c = {(int8_t)(square / BOARD_STRIDE - SQUARE_ORIGIN),
+              (int8_t)(square % BOARD_STRIDE - SQUARE_ORIGIN)};
+    return c;
+}
+
+static inline int direction_offset(Direction d) {
+    return d.dq * BOARD_STRIDE + d.dr;
+}
+
 /* Board state */
 typedef struct {
-    Piece cells[BOARD_SIZE][BOARD_SIZE];  /* Indexed by [q+RADIUS][r+RADIUS] */
+    Piece squares[BOARD_SQUARES];          /* Padded mailbox, see cell_square */
+    uint8_t pieces[2][NUM_CELLS];          /* Squares of each colour's pieces */
+    uint8_t piece_count[2];                /* Indexed by color - 1 */
+    uint8_t piece_slot[BOARD_SQUARES];     /* Position in its list; 0 if empty */
+    uint64_t occupied[2];                  /* Bitboards by colour, see bitboard.h */
+    uint64_t kinds[PIECE_KINDS];           /* Bitboards by BitboardKind */
     Color to_move;
     Cell white_king;
     Cell black_king;
     int half_move_count;
     int full_move_count;
+    uint64_t hash;        /* Zobrist hash of the pieces, kept by the setters */
+    int32_t psqt[2];      /* Material + piece-square sums by colour, see psqt.h */
 } Board;
 
 /* Board functions */
 bool cell_is_valid(Cell c);
 Piece* board_get(Board* board, Cell c);
 void board_set(Board* board, Cell c, Piece piece);
+
+/* Move the piece on 'from' to the empty cell 'to', where it becomes
+ * 'piece' (its promoted form, or itself). It keeps its piece-list slot,
+ * so moving it back restores the lists exactly. */
+void board_move_piece(Board* board, Cell from, Cell to, Piece piece);
+
+/* Take the piece off c, returning the list slot it held */
+int board_remove_piece(Board* board, Cell c);
+
+/* Undo board_remove_piece: put piece back on the empty cell c in slot */
+void board_restore_piece(Board* board, Cell c, Piece piece, int slot);
 void board_clear(Board* board);
 void board_init_starting_position(Board* board);
 Board board_copy(const Board* board);
@@ -92,6 +142,10 @@ Board board_copy(const Board* board);
 Cell cell_make(int q, int r);
 Cell cell_add(Cell c, Direction d);
 bool cell_equals(Cell a, Cell b);
+
+/* Dense cell numbering 0..NUM_CELLS-1 in (q, r) order; -1 if invalid */
+int cell_to_index(Cell c);
+Cell cell_from_index(int index);
 int abs_int(int x);
 int max_int(int a, int b);
 int max3_int(int a, int b, int c);
@@ -0,0 +1,279 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Opening book keyed on Zobrist hash
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "book.h"
+#include "rng.h"
+#include "zobrist.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BOOK_FILE_BYTE_ORDER 0x01020304u
+
+/* On-disk header; 32 bytes so the entries that follow are aligned */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t entry_count;
+    uint32_t entry_bytes;
+    uint64_t start_key;   /* zobrist_key of the starting position */
+} BookFileHeader;
+
+_Static_assert(sizeof(BookFileHeader) == 32, "book file header must be 32 bytes");
+
+static uint64_t starting_key(void) {
+    Board board;
+    board_init_starting_position(&board);
+    return zobrist_key(&board);
+}
+
+/* ============================================================================
+ * Probing
+ * ============================================================================ */
+
+bool book_open(OpeningBook* book, const char* path) {
+    memset(book, 0, sizeof(*book));
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookFileHeader)) {
+        close(fd);
+        return false;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    const BookFileHeader* header = mapping;
+    if (memcmp(header->magic, BOOK_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BOOK_FILE_VERSION ||
+        header->byte_order != BOOK_FILE_BYTE_ORDER ||
+        header->entry_bytes != sizeof(BookEntry) ||
+        header->start_key != starting_key() ||
+        size != sizeof(BookFileHeader) + (size_t)header->entry_count * sizeof(BookEntry)) {
+        munmap(mapping, size);
+        return false;
+    }
+    
+    book->mapping = mapping;
+    book->mapping_size = size;
+    book->entries = (const BookEntry*)((const char*)mapping + sizeof(BookFileHeader));
+    book->count = header->entry_count;
+    return true;
+}
+
+void book_close(OpeningBook* book) {
+    if (book->mapping) munmap(book->mapping, book->mapping_size);
+    memset(book, 0, sizeof(*book));
+}
+
+int book_lookup(const OpeningBook* book, const Board* board, const BookEntry** first) {
+    uint64_t key = zobrist_key(board);
+    
+    /* First entry with a key not below this one */
+    uint32_t low = 0, high = book->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (book->entries[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    uint32_t end = low;
+    while (end < book->count && book->entries[end].key == key) end++;
+    *first = book->entries + low;
+    return (int)(end - low);
+}
+
+/* Per-thread generator state, seeded from the clock on first use */
+static _Thread_local uint64_t book_random_state;
+static _Thread_local bool book_random_seeded;
+
+static uint64_t book_random(void) {
+    if (!book_random_seeded) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        book_random_state = ((uint64_t)ts.tv_sec * 1000000007ULL) ^ (uint64_t)ts.tv_nsec ^
+                            (uint64_t)(uintptr_t)&book_random_state;
+        book_random_seeded = true;
+    }
+    return rng_next(&book_random_state);
+}
+
+bool book_probe(const OpeningBook* book, const Board* board, Move* move) {
+    const BookEntry* entries;
+    int count = book_lookup(book, board, &entries);
+    
+    /* A key collision can list moves of another position; skip them */
+    Move legal[MAX_MOVES];
+    uint32_t weights[MAX_MOVES];
+    int legal_count = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < count && legal_count < MAX_MOVES; i++) {
+        if (entries[i].weight == 0) continue;
+        Move candidate = move_decode(entries[i].move);
+        if (!is_move_legal(board, candidate)) continue;
+        legal[legal_count] = candidate;
+        weights[legal_count++] = entries[i].weight;
+        total += entries[i].weight;
+    }
+    if (legal_count == 0) return false;
+    
+    uint64_t pick = book_random() % total;
+    for (int i = 0; i < legal_count; i++) {
+        if (pick < weights[i]) {
+            *move = legal[i];
+            return true;
+        }
+        pick -= weights[i];
+    }
+    *move = legal[legal_count - 1];
+    return true;
+}
+
+/* ============================================================================
+ * Building
+ * ============================================================================ */
+
+void book_builder_init(BookBuilder* builder, int max_plies) {
+    builder->entries = NULL;
+    builder->count = 0;
+    builder->capacity = 0;
+    builder->max_plies = max_plies;
+}
+
+void book_builder_free(BookBuilder* builder) {
+    free(builder->entries);
+    book_builder_init(builder, builder->max_plies);
+}
+
+bool book_builder_add_game(BookBuilder* builder, const Move* moves, int move_count,
+                           int result) {
+    int plies = move_count < builder->max_plies ? move_count : builder->max_plies;
+    if (builder->count + plies > builder->capacity) {
+        size_t capacity = builder->capacity ? builder->capacity * 2 : 4096;
+        while (capacity < builder->count + plies) capacity *= 2;
+        BookEntry* entries = realloc(builder->entries, capacity * sizeof(BookEntry));
+        if (!entries) return false;
+        builder->entries = entries;
+        builder->capacity = capacity;
+    }
+    
+    Board board;
+    board_init_starting_position(&board);
+    size_t start = builder->count;
+    for (int i = 0; i < plies; i++) {
+        if (!is_move_legal(&board, moves[i])) {
+            builder->count = start;
+            return false;
+        }
+        
+        /* result is from White's side; the mover's is negated for Black */
+        int outcome = board.to_move == COLOR_WHITE ? result : -result;
+        BookEntry* entry = &builder->entries[builder->count++];
+        entry->key = zobrist_key(&board);
+        entry->move = move_encode(moves[i]);
+        entry->weight = 0;
+        entry->games = 1;
+        entry->wins = outcome > 0;
+        entry->losses = outcome < 0;
+        make_move(&board, moves[i]);
+    }
+    return true;
+}
+
+static int compare_key_move(const void* a, const void* b) {
+    const BookEntry* x = a;
+    const BookEntry* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (int)x->move - (int)y->move;
+}
+
+static int compare_key_weight(const void* a, const void* b) {
+    const BookEntry* x = a;
+    const BookEntry* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    if (x->weight != y->weight) return (int)y->weight - (int)x->weight;
+    return (int)x->move - (int)y->move;
+}
+
+/* Twice the score of a move's games: 2 per win and 1 per draw */
+static uint64_t raw_weight(const BookEntry* entry) {
+    uint64_t draws = entry->games - entry->wins - entry->losses;
+    return 2 * (uint64_t)entry->wins + draws;
+}
+
+long book_builder_write(BookBuilder* builder, const char* path, int min_games) {
+    qsort(builder->entries, builder->count, sizeof(BookEntry), compare_key_move);
+    
+    /* Merge each run of one (position, move) in place */
+    size_t merged = 0;
+    for (size_t i = 0; i < builder->count; ) {
+        BookEntry entry = builder->entries[i++];
+        while (i < builder->count && builder->entries[i].key == entry.key &&
+               builder->entries[i].move == entry.move) {
+            entry.games += builder->entries[i].games;
+            entry.wins += builder->entries[i].wins;
+            entry.losses += builder->entries[i].losses;
+            i++;
+        }
+        if (entry.games >= (uint32_t)min_games) builder->entries[merged++] = entry;
+    }
+    builder->count = merged;
+    
+    uint64_t max_weight = 0;
+    for (size_t i = 0; i < merged; i++) {
+        uint64_t weight = raw_weight(&builder->entries[i]);
+        if (weight > max_weight) max_weight = weight;
+    }
+    for (size_t i = 0; i < merged; i++) {
+        uint64_t weight = raw_weight(&builder->entries[i]);
+        if (max_weight > UINT16_MAX) {
+            weight = weight * UINT16_MAX / max_weight;
+            if (weight == 0 && raw_weight(&builder->entries[i]) > 0) weight = 1;
+        }
+        builder->entries[i].weight = (uint16_t)weight;
+    }
+    qsort(builder->entries, merged, sizeof(BookEntry), compare_key_weight);
+    
+    BookFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_FILE_MAGIC, sizeof(header.magic));
+    header.version = BOOK_FILE_VERSION;
+    header.byte_order = BOOK_FILE_BYTE_ORDER;
+    header.entry_count = (uint32_t)merged;
+    header.entry_bytes = sizeof(BookEntry);
+    header.start_key = starting_key();
+    
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return -1;
+    }
+    
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) return -1;
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(builder->entries, sizeof(BookEntry), merged, file) == merged;
+    ok = (fclose(file) == 0) && ok;
+    
+    if (ok) ok = rename(tmp_path, path) == 0;
+    if (!ok) remove(tmp_path);
+    return ok ? (long)merged : -1;
+}
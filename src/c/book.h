@@ -0,0 +1,96 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Opening book keyed on Zobrist hash
+ *
+ * A book file is a 32-byte header followed by fixed-size entries sorted by
+ * position key, one per (position, move), so a probe is a binary search
+ * of the file mapped read-only in place. Pages are read on demand and
+ * shared through the page cache by every process using the book. Like the
+ * tablebase files, books use host byte order and carry a byte-order mark;
+ * the header also records the key of the starting position, so a book
+ * built with other Zobrist keys is rejected rather than misread.
+ *
+ * Books are built from finished games: every position in a game's first
+ * plies counts the move played from it and the game's outcome for the
+ * side that played it.
+ */
+
+#ifndef UNDERCHEX_BOOK_H
+#define UNDERCHEX_BOOK_H
+
+#include "board.h"
+#include "moves.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOOK_FILE_MAGIC "UCHXBK\0\0"
+#define BOOK_FILE_VERSION 1
+#define BOOK_FILE_EXTENSION ".ubk"
+
+/* How deep into a game the builder records positions by default */
+#define BOOK_DEFAULT_PLIES 16
+
+/* One move of a position, as stored */
+typedef struct {
+    uint64_t key;         /* zobrist_key of the position */
+    MoveCode move;
+    uint16_t weight;      /* Chance of being played, relative to the
+                           * position's other moves; 0 is never */
+    uint32_t games;       /* Learn stats: games through this move, and */
+    uint32_t wins;        /* their outcome for the side that played it */
+    uint32_t losses;
+} BookEntry;
+
+_Static_assert(sizeof(BookEntry) == 24, "book entries must be 24 bytes");
+
+/* A book file mapped for probing */
+typedef struct {
+    void* mapping;
+    size_t mapping_size;
+    const BookEntry* entries;
+    uint32_t count;
+} OpeningBook;
+
+/* Map a book file. Returns false, leaving book closed, if it cannot be
+ * read or is not a book for this build. */
+bool book_open(OpeningBook* book, const char* path);
+
+/* Unmap a book; a closed book can be closed again */
+void book_close(OpeningBook* book);
+
+/* The entries for board's position, sorted by weight, heaviest first.
+ * Returns how many there are (0 if none) and points *first at them. */
+int book_lookup(const OpeningBook* book, const Board* board, const BookEntry** first);
+
+/* Pick a book move for board, at random in proportion to the weights.
+ * Returns false if the book has no legal move of nonzero weight there.
+ * Safe to call from several threads at once. */
+bool book_probe(const OpeningBook* book, const Board* board, Move* move);
+
+/* Accumulates games into book entries */
+typedef struct {
+    BookEntry* entries;   /* One per recorded ply until written */
+    size_t count;
+    size_t capacity;
+    int max_plies;
+} BookBuilder;
+
+/* An empty builder recording the first max_plies plies of each game */
+void book_builder_init(BookBuilder* builder, int max_plies);
+void book_builder_free(BookBuilder* builder);
+
+/* Record a game played from the starting position. result is 1 if
+ * White won, 0 for a draw and -1 if Black won. Returns false, recording
+ * nothing, if a move is illegal. */
+bool book_builder_add_game(BookBuilder* builder, const Move* moves, int move_count,
+                           int result);
+
+/* Merge the recorded plies into one entry per (position, move), dropping
+ * moves seen in fewer than min_games games, and write them to path. A
+ * move's weight is its wins plus half its draws, scaled to fit. The file
+ * is written under a temporary name and renamed into place. Returns the
+ * number of entries written, or -1 on failure. */
+long book_builder_write(BookBuilder* builder, const char* path, int min_games);
+
+#endif /* UNDERCHEX_BOOK_H */
@@ -0,0 +1,144 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Opening book builder (see book.h)
+ *
+ * Usage: ./bookgen [options] [FILE...]
+ * Options:
+ *   -o FILE   Write the book to FILE (default: book.ubk)
+ *   -d N      Record the first N plies of each game (default: 16)
+ *   -g N      Keep only moves played in at least N games (default: 1)
+ *   -h        Show help
+ *
+ * Reads games from each FILE, or from stdin if none is given, one per
+ * line: a result (1-0, 1/2 or 0-1) and the moves from the starting
+ * position in engine notation, in that order, with any other tokens
+ * ignored. A selfplay log is read as it is; lines starting with "#" are
+ * skipped.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "book.h"
+#include "engine.h"
+
+#define MAX_GAME_LINE 65536
+#define MAX_GAME_MOVES 2048
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options] [FILE...]\n", prog);
+    printf("Options:\n");
+    printf("  -o FILE   Write the book to FILE (default: book.ubk)\n");
+    printf("  -d N      Record the first N plies of each game (default: %d)\n",
+           BOOK_DEFAULT_PLIES);
+    printf("  -g N      Keep only moves played in at least N games (default: 1)\n");
+    printf("  -h        Show this help\n");
+    printf("Each input line is a game: a result (1-0, 1/2 or 0-1) then its moves.\n");
+}
+
+/* Parse a game line. Returns false if it has no result. */
+static bool parse_game(char* line, Move* moves, int* move_count, int* result) {
+    bool has_result = false;
+    *move_count = 0;
+    
+    for (char* token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        if (!has_result) {
+            if (strcmp(token, "1-0") == 0) {
+                *result = 1;
+            } else if (strcmp(token, "0-1") == 0) {
+                *result = -1;
+            } else if (strcmp(token, "1/2") == 0) {
+                *result = 0;
+            } else {
+                continue;
+            }
+            has_result = true;
+        } else if (*move_count < MAX_GAME_MOVES &&
+                   engine_parse_move(token, &moves[*move_count])) {
+            (*move_count)++;
+        }
+    }
+    return has_result;
+}
+
+/* Add every game in file to the builder */
+static void read_games(FILE* file, BookBuilder* builder, long* games, long* skipped) {
+    static char line[MAX_GAME_LINE];
+    static Move moves[MAX_GAME_MOVES];
+    
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        
+        int move_count, result = 0;
+        if (parse_game(line, moves, &move_count, &result) &&
+            book_builder_add_game(builder, moves, move_count, result)) {
+            (*games)++;
+        } else {
+            (*skipped)++;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* output = "book.ubk";
+    int plies = BOOK_DEFAULT_PLIES;
+    int min_games = 1;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "o:d:g:h")) != -1) {
+        switch (opt) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'd':
+                plies = atoi(optarg);
+                break;
+            case 'g':
+                min_games = atoi(optarg);
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    if (plies < 1 || min_games < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    BookBuilder builder;
+    book_builder_init(&builder, plies);
+    long games = 0, skipped = 0;
+    
+    if (optind == argc) {
+        read_games(stdin, &builder, &games, &skipped);
+    }
+    for (int i = optind; i < argc; i++) {
+        FILE* file = fopen(argv[i], "r");
+        if (!file) {
+            perror(argv[i]);
+            book_builder_free(&builder);
+            return 1;
+        }
+        read_games(file, &builder, &games, &skipped);
+        fclose(file);
+    }
+    
+    long entries = book_builder_write(&builder, output, min_games);
+    book_builder_free(&builder);
+    if (entries < 0) {
+        fprintf(stderr, "Could not write %s\n", output);
+        return 1;
+    }
+    
+    printf("%ld games (%ld lines skipped), %ld entries written to %s\n",
+           games, skipped, entries, output);
+    return 0;
+}
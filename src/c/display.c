@@ -191,19 +191,20 @@ void display_status(const Board* board, const char* message) {
     refresh();
 }
 
-void display_move_history(const Move* moves, int count) {
+void display_move_history(const GameHistory* history) {
     /* Show last few moves on the right side of the screen */
     int start_x = 50;
     int start_y = BOARD_START_Y;
     
     mvprintw(start_y, start_x, "Move History:");
     
+    int count = history->count;
     int display_count = (count > 10) ? 10 : count;
     int start_idx = count - display_count;
     
     for (int i = 0; i < display_count; i++) {
         char buf[32];
-        format_move(moves[start_idx + i], buf, sizeof(buf));
+        format_move(history_move(history, start_idx + i), buf, sizeof(buf));
         mvprintw(start_y + 1 + i, start_x, "%3d. %s", 
                  start_idx + i + 1, buf);
     }
@@ -278,6 +279,7 @@ void display_help(void) {
     mvprintw(y++, 4, "h or ?  - Show this help");
     mvprintw(y++, 4, "q       - Quit game");
     mvprintw(y++, 4, "u       - Undo last move");
+    mvprintw(y++, 4, "r       - Redo undone move");
     mvprintw(y++, 4, "n       - New game");
     mvprintw(y++, 4, "m       - Show legal moves for a piece");
     y++;
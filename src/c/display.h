@@ -9,6 +9,7 @@
 #define UNDERCHEX_DISPLAY_H
 
 #include "board.h"
+#include "history.h"
 #include "moves.h"
 
 /* Initialize ncurses display */
@@ -27,8 +28,8 @@ void display_board_highlighted(const Board* board, Cell selected,
 /* Display game status (whose turn, check, etc.) */
 void display_status(const Board* board, const char* message);
 
-/* Display move history */
-void display_move_history(const Move* moves, int count);
+/* Display the last moves played */
+void display_move_history(const GameHistory* history);
 
 /* Get user input for a cell selection */
 bool display_get_cell(Cell* cell);
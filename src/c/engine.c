@@ -0,0 +1,454 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Headless engine sessions and the search worker pool
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "engine.h"
+#include "ai.h"
+#include "position.h"
+#include "tablebase.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Scores this close to EVAL_MATE are reported as mates */
+#define ENGINE_MATE_BOUND (EVAL_MATE - 1000)
+
+/* Share of the remaining clock a go with wtime/btime spends */
+#define ENGINE_MOVES_TO_GO 30
+
+struct EngineSession {
+    EngineOutput output;
+    void* context;
+    pthread_mutex_t lock;       /* Held while searching changes and while writing */
+    pthread_cond_t idle;        /* Signalled when a search ends */
+    bool searching;             /* A search is queued or running */
+    bool infinite;              /* Hold the search's answer until stop */
+    atomic_bool stop;
+    bool held;                  /* An infinite search ended before stop */
+    char held_info[512];        /* and its answer, written on stop */
+    char held_bestmove[64];
+    Board board;                /* The position the next go searches */
+    Board search_board;         /* Owned by the worker while searching */
+    SearchLimits limits;
+    EngineSession* next;        /* Link in the search queue */
+};
+
+/* Sessions waiting for a worker, oldest first */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static EngineSession* queue_head;
+static EngineSession* queue_tail;
+static bool engine_stopping;
+
+static pthread_t engine_workers[ENGINE_MAX_WORKERS];
+static int engine_worker_count;
+
+/* ============================================================================
+ * Output
+ * ============================================================================ */
+
+/* Write a line; the session's lock must be held */
+static void emit_locked(EngineSession* session, const char* fmt, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    session->output(session->context, line);
+}
+
+static void emit(EngineSession* session, const char* fmt, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    
+    pthread_mutex_lock(&session->lock);
+    session->output(session->context, line);
+    pthread_mutex_unlock(&session->lock);
+}
+
+/* ============================================================================
+ * Move Notation
+ * ============================================================================ */
+
+static const char PROMOTION_LETTERS[PIECE_KING + 1] = {0, 0, 'n', 'l', 'c', 'q', 0};
+
+bool engine_parse_move(const char* token, Move* move) {
+    int from_q, from_r, to_q, to_r, length;
+    if (sscanf(token, "%d,%d,%d,%d%n", &from_q, &from_r, &to_q, &to_r, &length) != 4) {
+        return false;
+    }
+    
+    move->from = cell_make(from_q, from_r);
+    move->to = cell_make(to_q, to_r);
+    move->promotion = PIECE_NONE;
+    
+    char promo = (char)tolower((unsigned char)token[length]);
+    if (promo != '\0') {
+        for (int type = 0; type <= PIECE_KING; type++) {
+            if (PROMOTION_LETTERS[type] && PROMOTION_LETTERS[type] == promo) {
+                move->promotion = (PieceType)type;
+            }
+        }
+        if (move->promotion == PIECE_NONE || token[length + 1] != '\0') return false;
+    }
+    return true;
+}
+
+void engine_format_move(Move move, char* buf, int bufsize) {
+    if (move.promotion != PIECE_NONE) {
+        snprintf(buf, bufsize, "%d,%d,%d,%d%c", move.from.q, move.from.r,
+                 move.to.q, move.to.r, PROMOTION_LETTERS[move.promotion]);
+    } else {
+        snprintf(buf, bufsize, "%d,%d,%d,%d", move.from.q, move.from.r,
+                 move.to.q, move.to.r);
+    }
+}
+
+/* The legal move the token names, if any */
+static bool find_legal_move(const Board* board, const char* token, Move* move) {
+    Move parsed;
+    if (!engine_parse_move(token, &parsed)) return false;
+    
+    MoveList moves;
+    generate_legal_moves(board, &moves);
+    for (int i = 0; i < moves.count; i++) {
+        Move m = moves.moves[i];
+        if (cell_equals(m.from, parsed.from) && cell_equals(m.to, parsed.to) &&
+            m.promotion == parsed.promotion) {
+            *move = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ============================================================================
+ * Search Workers
+ * ============================================================================ */
+
+static void run_search(EngineSession* session) {
+    SearchStats stats;
+    Move move = find_best_move_limited(&session->search_board, &session->limits, &stats);
+    
+    /* The protocol scores from the side to move's view */
+    int score = (session->search_board.to_move == COLOR_WHITE) ? stats.eval : -stats.eval;
+    char score_str[32];
+    if (score >= ENGINE_MATE_BOUND) {
+        snprintf(score_str, sizeof(score_str), "mate %d", (EVAL_MATE - score + 1) / 2);
+    } else if (score <= -ENGINE_MATE_BOUND) {
+        snprintf(score_str, sizeof(score_str), "mate -%d", (EVAL_MATE + score) / 2);
+    } else {
+        snprintf(score_str, sizeof(score_str), "cp %d", score);
+    }
+    
+    char move_str[32];
+    engine_format_move(move, move_str, sizeof(move_str));
+    char info[512];
+    if (stats.from_book) {
+        snprintf(info, sizeof(info), "info string book move");
+    } else {
+        snprintf(info, sizeof(info), "info depth %d score %s nodes %d tbhits %d",
+                 stats.depth_reached, score_str, stats.nodes_searched, stats.tb_hits);
+    }
+    
+    /* An infinite search answers only once stopped, even if it finished
+     * early (a book or tablebase move, a mate, the depth limit); until
+     * then the answer waits in the session and the worker moves on */
+    pthread_mutex_lock(&session->lock);
+    if (session->infinite && !atomic_load(&session->stop)) {
+        snprintf(session->held_info, sizeof(session->held_info), "%s", info);
+        snprintf(session->held_bestmove, sizeof(session->held_bestmove), "bestmove %s",
+                 move_str);
+        session->held = true;
+    } else {
+        emit_locked(session, "%s", info);
+        emit_locked(session, "bestmove %s", move_str);
+        session->searching = false;
+        pthread_cond_broadcast(&session->idle);
+    }
+    pthread_mutex_unlock(&session->lock);
+}
+
+static void* worker_main(void* arg) {
+    (void)arg;
+    
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!queue_head && !engine_stopping) {
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        }
+        EngineSession* session = queue_head;
+        if (session) {
+            queue_head = session->next;
+            if (!queue_head) queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&queue_lock);
+        
+        if (!session) return NULL;
+        run_search(session);
+    }
+}
+
+static void queue_search(EngineSession* session) {
+    pthread_mutex_lock(&queue_lock);
+    session->next = NULL;
+    if (queue_tail) {
+        queue_tail->next = session;
+    } else {
+        queue_head = session;
+    }
+    queue_tail = session;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+bool engine_start(int workers, const char* tablebase_dir) {
+    if (engine_worker_count > 0) return true;
+    if (workers < 1) workers = 1;
+    if (workers > ENGINE_MAX_WORKERS) workers = ENGINE_MAX_WORKERS;
+    
+    /* Built once here, the tables are only read by the searches */
+    tablebase_init();
+    if (tablebase_dir) {
+        tablebase_load_all(tablebase_dir);
+    }
+    tablebase_generate_all();
+    
+    engine_stopping = false;
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&engine_workers[i], NULL, worker_main, NULL) != 0) break;
+        engine_worker_count++;
+    }
+    return engine_worker_count > 0;
+}
+
+void engine_stop(void) {
+    pthread_mutex_lock(&queue_lock);
+    engine_stopping = true;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+    
+    for (int i = 0; i < engine_worker_count; i++) {
+        pthread_join(engine_workers[i], NULL);
+    }
+    engine_worker_count = 0;
+}
+
+/* ============================================================================
+ * Sessions
+ * ============================================================================ */
+
+EngineSession* engine_session_create(EngineOutput output, void* context) {
+    EngineSession* session = calloc(1, sizeof(EngineSession));
+    if (!session) return NULL;
+    
+    session->output = output;
+    session->context = context;
+    pthread_mutex_init(&session->lock, NULL);
+    pthread_cond_init(&session->idle, NULL);
+    session->infinite = false;
+    session->held = false;
+    atomic_init(&session->stop, false);
+    board_init_starting_position(&session->board);
+    return session;
+}
+
+void engine_session_wait(EngineSession* session) {
+    pthread_mutex_lock(&session->lock);
+    while (session->searching) {
+        pthread_cond_wait(&session->idle, &session->lock);
+    }
+    pthread_mutex_unlock(&session->lock);
+}
+
+/* Raise stop, answering for an infinite search that already ended */
+static void session_signal_stop(EngineSession* session) {
+    pthread_mutex_lock(&session->lock);
+    atomic_store(&session->stop, true);
+    if (session->held) {
+        emit_locked(session, "%s", session->held_info);
+        emit_locked(session, "%s", session->held_bestmove);
+        session->held = false;
+        session->searching = false;
+        pthread_cond_broadcast(&session->idle);
+    }
+    pthread_mutex_unlock(&session->lock);
+}
+
+/* Stop any search and wait for its bestmove */
+static void session_stop(EngineSession* session) {
+    session_signal_stop(session);
+    engine_session_wait(session);
+}
+
+void engine_session_destroy(EngineSession* session) {
+    if (!session) return;
+    session_stop(session);
+    pthread_cond_destroy(&session->idle);
+    pthread_mutex_destroy(&session->lock);
+    free(session);
+}
+
+/* position startpos|fen TEXT [moves M ...]; the position only changes if
+ * it parses and every move is legal */
+static void command_position(EngineSession* session, char** save) {
+    const char* kind = strtok_r(NULL, " \t", save);
+    Board board;
+    const char* token;
+    
+    if (kind && strcmp(kind, "startpos") == 0) {
+        board_init_starting_position(&board);
+        token = strtok_r(NULL, " \t", save);
+    } else if (kind && strcmp(kind, "fen") == 0) {
+        /* The text's fields run up to "moves" */
+        char text[POSITION_TEXT_MAX] = "";
+        int len = 0;
+        while ((token = strtok_r(NULL, " \t", save)) != NULL && strcmp(token, "moves") != 0) {
+            if (len < (int)sizeof(text)) {
+                len += snprintf(text + len, sizeof(text) - len, "%s%s", len ? " " : "", token);
+            }
+        }
+        if (len >= (int)sizeof(text) || !position_from_text(text, &board)) {
+            emit(session, "info string invalid position");
+            return;
+        }
+    } else {
+        emit(session, "info string expected position startpos or position fen");
+        return;
+    }
+    
+    if (token && strcmp(token, "moves") == 0) {
+        while ((token = strtok_r(NULL, " \t", save)) != NULL) {
+            Move move;
+            if (!find_legal_move(&board, token, &move)) {
+                emit(session, "info string illegal move %s", token);
+                return;
+            }
+            make_move(&board, move);
+        }
+    } else if (token) {
+        emit(session, "info string unexpected %s", token);
+        return;
+    }
+    
+    session->board = board;
+}
+
+/* Read a go parameter's value */
+static bool next_int(char** save, int* value) {
+    const char* token = strtok_r(NULL, " \t", save);
+    if (!token) return false;
+    char* end;
+    long v = strtol(token, &end, 10);
+    if (*end != '\0') return false;
+    *value = (int)v;
+    return true;
+}
+
+static void command_go(EngineSession* session, char** save) {
+    int depth = AI_MAX_DEPTH;
+    int movetime = -1;
+    int wtime = -1, btime = -1, winc = 0, binc = 0;
+    bool infinite = false, limited = false;
+    
+    const char* token;
+    while ((token = strtok_r(NULL, " \t", save)) != NULL) {
+        bool ok = true;
+        limited = true;
+        if (strcmp(token, "depth") == 0) {
+            ok = next_int(save, &depth);
+        } else if (strcmp(token, "movetime") == 0) {
+            ok = next_int(save, &movetime);
+        } else if (strcmp(token, "wtime") == 0) {
+            ok = next_int(save, &wtime);
+        } else if (strcmp(token, "btime") == 0) {
+            ok = next_int(save, &btime);
+        } else if (strcmp(token, "winc") == 0) {
+            ok = next_int(save, &winc);
+        } else if (strcmp(token, "binc") == 0) {
+            ok = next_int(save, &binc);
+        } else if (strcmp(token, "infinite") == 0) {
+            infinite = true;
+        } else {
+            emit(session, "info string unknown go parameter %s", token);
+            return;
+        }
+        if (!ok) {
+            emit(session, "info string bad value for %s", token);
+            return;
+        }
+    }
+    
+    /* A clock without movetime spends a share of what is left */
+    bool white = (session->board.to_move == COLOR_WHITE);
+    int clock = white ? wtime : btime;
+    if (movetime < 0 && clock >= 0) {
+        movetime = clock / ENGINE_MOVES_TO_GO + (white ? winc : binc) / 2;
+    }
+    
+    if (count_legal_moves(&session->board) == 0) {
+        emit(session, "bestmove 0000");
+        return;
+    }
+    
+    pthread_mutex_lock(&session->lock);
+    if (session->searching) {
+        emit_locked(session, "info string search already running");
+        pthread_mutex_unlock(&session->lock);
+        return;
+    }
+    session->searching = true;
+    pthread_mutex_unlock(&session->lock);
+    
+    session->search_board = board_copy(&session->board);
+    session->infinite = infinite || !limited;
+    session->limits = (SearchLimits){depth, movetime, &session->stop, true, true,
+                                     NULL, NULL, NULL};
+    atomic_store(&session->stop, false);
+    queue_search(session);
+}
+
+bool engine_session_command(EngineSession* session, const char* line) {
+    char buffer[ENGINE_MAX_LINE];
+    snprintf(buffer, sizeof(buffer), "%s", line);
+    buffer[strcspn(buffer, "\r\n")] = '\0';
+    
+    char* save;
+    const char* command = strtok_r(buffer, " \t", &save);
+    if (!command) return true;
+    
+    if (strcmp(command, "uci") == 0) {
+        pthread_mutex_lock(&session->lock);
+        emit_locked(session, "id name Underchex");
+        emit_locked(session, "id author Underchex project");
+        emit_locked(session, "uciok");
+        pthread_mutex_unlock(&session->lock);
+    } else if (strcmp(command, "isready") == 0) {
+        emit(session, "readyok");
+    } else if (strcmp(command, "ucinewgame") == 0) {
+        session_stop(session);
+        board_init_starting_position(&session->board);
+    } else if (strcmp(command, "position") == 0) {
+        session_stop(session);
+        command_position(session, &save);
+    } else if (strcmp(command, "go") == 0) {
+        command_go(session, &save);
+    } else if (strcmp(command, "stop") == 0) {
+        session_signal_stop(session);
+    } else if (strcmp(command, "quit") == 0) {
+        session_stop(session);
+        return false;
+    } else {
+        emit(session, "info string unknown command %s", command);
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Headless engine: a UCI-style line protocol serving many games at once
+ *
+ * Each game is an EngineSession, a small struct fed one command line at a
+ * time by whoever owns its connection and answering through a callback.
+ * Searches run on one pool of worker threads shared by every session,
+ * against the transposition table and tablebases the process keeps
+ * resident, so a game costs no process or table generation of its own.
+ *
+ * Commands:
+ *   uci                               Answers "id name ..." and "uciok"
+ *   isready                           Answers "readyok"
+ *   ucinewgame                        Back to the starting position
+ *   position startpos [moves M ...]   Set the position
+ *   position fen TEXT [moves M ...]   Set the position from its text form
+ *                                     (see position.h)
+ *   go [depth N] [movetime MS] [wtime MS btime MS [winc MS binc MS]] [infinite]
+ *                                     Queue a search of the position; when
+ *                                     it ends, answers "info ..." then
+ *                                     "bestmove M" ("bestmove 0000" if
+ *                                     there is no legal move). A move from
+ *                                     the opening book (ai_set_book) is
+ *                                     answered at once, with "info string
+ *                                     book move".
+ *   stop                              Finish the running search now
+ *   quit                              End the session
+ *
+ * A go infinite, or a go with no parameters, searches until stop and
+ * answers only then, even if the search ends sooner (a book or tablebase
+ * move, a mate found, the depth limit); a search that ended early keeps
+ * its answer in the session and frees its worker for other sessions.
+ * Moves are written q1,r1,q2,r2 with a promotion letter appended if any,
+ * e.g. 1,-3,1,-4q.
+ * Errors are reported as "info string ..." lines.
+ */
+
+#ifndef UNDERCHEX_ENGINE_H
+#define UNDERCHEX_ENGINE_H
+
+#include "board.h"
+#include "moves.h"
+#include <stdbool.h>
+
+/* Most search workers engine_start accepts */
+#define ENGINE_MAX_WORKERS 64
+
+/* Longest command line a session accepts */
+#define ENGINE_MAX_LINE 8192
+
+/* Receives one output line, without its newline. Called with the
+ * session's lock held, from the thread running the command or from a
+ * search worker; it must not call back into the session. */
+typedef void (*EngineOutput)(void* context, const char* line);
+
+typedef struct EngineSession EngineSession;
+
+/* Make the tablebases resident and start the search workers. Tables
+ * found in tablebase_dir (may be NULL) are loaded, and the rest of the
+ * on-demand ones generated. Returns false if the workers could not be
+ * started. */
+bool engine_start(int workers, const char* tablebase_dir);
+
+/* Stop the workers. Every session must be destroyed first. */
+void engine_stop(void);
+
+/* A new game at the starting position, or NULL if out of memory */
+EngineSession* engine_session_create(EngineOutput output, void* context);
+
+/* Stop the session's search, wait for it and free the session */
+void engine_session_destroy(EngineSession* session);
+
+/* Run one command line. Returns false once the session has quit. */
+bool engine_session_command(EngineSession* session, const char* line);
+
+/* Wait until the session has no search queued or running */
+void engine_session_wait(EngineSession* session);
+
+/* Protocol move notation */
+bool engine_parse_move(const char* token, Move* move);
+void engine_format_move(Move move, char* buf, int bufsize);
+
+#endif /* UNDERCHEX_ENGINE_H */
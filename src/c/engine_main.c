@@ -0,0 +1,192 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Headless engine server (see engine.h for the protocol)
+ *
+ * Usage: ./underchex-engine [options]
+ * Options:
+ *   -p PORT   Serve a game per TCP connection on PORT instead of one on stdin
+ *   -w N      Search workers shared by all games (default: one per core)
+ *   -H MB     Transposition table size in megabytes
+ *   -T DIR    Load tablebase files from DIR before generating the rest
+ *   -B FILE   Play book moves from the opening book FILE
+ *   -h        Show help
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "ai.h"
+#include "engine.h"
+#include "tablebase.h"
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("Options:\n");
+    printf("  -p PORT   Serve a game per TCP connection on PORT instead of one on stdin\n");
+    printf("  -w N      Search workers shared by all games (default: one per core)\n");
+    printf("  -H MB     Transposition table size in megabytes\n");
+    printf("  -T DIR    Load tablebase files from DIR before generating the rest\n");
+    printf("  -B FILE   Play book moves from the opening book FILE\n");
+    printf("  -h        Show this help\n");
+}
+
+/* Read command lines from in until quit or end of input */
+static void serve(FILE* in, EngineSession* session) {
+    char line[ENGINE_MAX_LINE];
+    while (fgets(line, sizeof(line), in)) {
+        if (!engine_session_command(session, line)) break;
+    }
+}
+
+static void write_stdout(void* context, const char* line) {
+    (void)context;
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+/* Output to a connection; a failed write just drops the line, and the
+ * reader sees the connection close */
+static void write_socket(void* context, const char* line) {
+    int fd = *(int*)context;
+    char buffer[ENGINE_MAX_LINE];
+    int length = snprintf(buffer, sizeof(buffer), "%s\n", line);
+    if (length >= (int)sizeof(buffer)) length = (int)sizeof(buffer) - 1;
+    for (int sent = 0; sent < length; ) {
+        ssize_t n = write(fd, buffer + sent, length - sent);
+        if (n <= 0) return;
+        sent += (int)n;
+    }
+}
+
+static void* connection_main(void* arg) {
+    int fd = *(int*)arg;
+    FILE* in = fdopen(dup(fd), "r");
+    EngineSession* session = in ? engine_session_create(write_socket, arg) : NULL;
+    
+    if (session) {
+        serve(in, session);
+        engine_session_destroy(session);
+    }
+    if (in) fclose(in);
+    close(fd);
+    free(arg);
+    return NULL;
+}
+
+static int serve_port(int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        perror("bind");
+        close(listener);
+        return 1;
+    }
+    
+    /* A client that hangs up mid-write must not kill every other game */
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Listening on port %d\n", port);
+    
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+        
+        int* context = malloc(sizeof(int));
+        pthread_t thread;
+        if (!context) {
+            close(fd);
+            continue;
+        }
+        *context = fd;
+        if (pthread_create(&thread, NULL, connection_main, context) != 0) {
+            close(fd);
+            free(context);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int port = 0;
+    int workers = tablebase_default_threads();
+    const char* tablebase_dir = NULL;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "p:w:H:T:B:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = atoi(optarg);
+                if (port < 1 || port > 65535) {
+                    fprintf(stderr, "Invalid port: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                break;
+            case 'H':
+                if (!ai_set_hash_size((size_t)atoi(optarg))) {
+                    fprintf(stderr, "Could not allocate %s MB of hash\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T':
+                tablebase_dir = optarg;
+                break;
+            case 'B':
+                if (!ai_set_book(optarg)) {
+                    fprintf(stderr, "Could not open opening book %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if (!engine_start(workers, tablebase_dir)) {
+        fprintf(stderr, "Could not start the search workers\n");
+        return 1;
+    }
+    
+    int status = 0;
+    if (port) {
+        status = serve_port(port);
+    } else {
+        EngineSession* session = engine_session_create(write_stdout, NULL);
+        if (session) {
+            serve(stdin, session);
+            engine_session_destroy(session);
+        } else {
+            status = 1;
+        }
+    }
+    
+    engine_stop();
+    tablebase_cleanup();
+    return status;
+}
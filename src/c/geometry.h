@@ -0,0 +1,33 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Board geometry tables
+ *
+ * Everything about the shape of the hex that does not depend on the
+ * pieces: which squares are cells, the dense numbering, each cell's
+ * neighbours, the rays and leaper targets of bitboard.h, distances to the
+ * centre and the promotion ranks. The tables are written to geometry.c by
+ * geometry_gen for the BOARD_RADIUS in board.h, which the Makefile reruns
+ * when board.h changes, so lookups replace the coordinate arithmetic of
+ * the hot loops and nothing is filled in at startup.
+ */
+
+#ifndef UNDERCHEX_GEOMETRY_H
+#define UNDERCHEX_GEOMETRY_H
+
+#include "board.h"
+#include "bitboard.h"
+
+/* Cell of each dense index */
+extern const Cell geo_index_cell[NUM_CELLS];
+
+/* Dense index of the neighbour of each cell along DIRECTIONS, or -1 off
+ * the hex */
+extern const int8_t geo_neighbors[6][NUM_CELLS];
+
+/* Hex distance from each cell to the centre, 0..BOARD_RADIUS */
+extern const uint8_t geo_center_distance[NUM_CELLS];
+
+/* Cells where a pawn of each colour promotes, [color - 1] */
+extern const Bitboard geo_promotion_mask[2];
+
+#endif /* UNDERCHEX_GEOMETRY_H */
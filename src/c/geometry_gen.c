@@ -0,0 +1,179 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Geometry table generator (see geometry.h)
+ *
+ * Usage: ./geometry_gen > geometry.c
+ *
+ * Writes the C source of the geometry and bitboard tables for the
+ * BOARD_RADIUS this is compiled with. It uses only the constants and
+ * inline helpers of board.h, so it builds before the rest of the tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "board.h"
+
+typedef uint64_t Bitboard;
+
+/* The hex directions, in the order of DIRECTIONS in board.c */
+static const int STEPS[6][2] = {
+    { 0, -1},  /* N  */
+    { 0,  1},  /* S  */
+    { 1, -1},  /* NE */
+    {-1,  1},  /* SW */
+    {-1,  0},  /* NW */
+    { 1,  0}   /* SE */
+};
+
+/* Knight jumps, matching KNIGHT_SQUARES in moves.c */
+static const int JUMPS[6][2] = {
+    { 1, -2}, {-1, -1}, { 2, -1}, { 1,  1}, {-1,  2}, {-2,  1}
+};
+
+static int distance(int q, int r) {
+    int s = -q - r;
+    int d = abs(q);
+    if (abs(r) > d) d = abs(r);
+    if (abs(s) > d) d = abs(s);
+    return d;
+}
+
+static int index_of[BOARD_SIZE][BOARD_SIZE];   /* By q, r + BOARD_RADIUS; -1 off the hex */
+static Cell cells[NUM_CELLS];
+
+/* Dense index of (q, r), or -1 if it is off the hex */
+static int cell_index(int q, int r) {
+    if (distance(q, r) > BOARD_RADIUS) return -1;
+    return index_of[q + BOARD_RADIUS][r + BOARD_RADIUS];
+}
+
+static Bitboard cell_bit(int q, int r) {
+    int index = cell_index(q, r);
+    return index < 0 ? 0 : (Bitboard)1 << index;
+}
+
+/* Print a braced initializer list whose closing brace is indented by
+ * indent spaces and its lines by four more */
+static void print_bitboards(const Bitboard* boards, int count, int indent) {
+    printf("{");
+    for (int i = 0; i < count; i++) {
+        if (i % 4 == 0) printf("%s\n%*s", i ? "," : "", indent + 4, "");
+        printf("%s0x%016llxULL", i % 4 ? ", " : "", (unsigned long long)boards[i]);
+    }
+    printf("\n%*s}", indent, "");
+}
+
+static void print_ints(const int* values, int count, int indent) {
+    printf("{");
+    for (int i = 0; i < count; i++) {
+        if (i % 16 == 0) printf("%s\n%*s", i ? "," : "", indent + 4, "");
+        printf("%s%d", i % 16 ? ", " : "", values[i]);
+    }
+    printf("\n%*s}", indent, "");
+}
+
+/* A table of rows, e.g. one per direction */
+static void print_int_rows(const char* declaration, const int* rows, int row_count, int count) {
+    printf("%s = {\n    ", declaration);
+    for (int row = 0; row < row_count; row++) {
+        print_ints(rows + row * count, count, 4);
+        printf(row < row_count - 1 ? ",\n    " : "\n");
+    }
+    printf("};\n\n");
+}
+
+static void print_bitboard_rows(const char* declaration, const Bitboard* rows, int row_count,
+                                int count) {
+    printf("%s = {\n    ", declaration);
+    for (int row = 0; row < row_count; row++) {
+        print_bitboards(rows + row * count, count, 4);
+        printf(row < row_count - 1 ? ",\n    " : "\n");
+    }
+    printf("};\n\n");
+}
+
+int main(void) {
+    int count = 0;
+    for (int q = -BOARD_RADIUS; q <= BOARD_RADIUS; q++) {
+        for (int r = -BOARD_RADIUS; r <= BOARD_RADIUS; r++) {
+            index_of[q + BOARD_RADIUS][r + BOARD_RADIUS] = -1;
+            if (distance(q, r) <= BOARD_RADIUS) {
+                cells[count] = (Cell){(int8_t)q, (int8_t)r};
+                index_of[q + BOARD_RADIUS][r + BOARD_RADIUS] = count++;
+            }
+        }
+    }
+    if (count != NUM_CELLS || NUM_CELLS > 64) {
+        fprintf(stderr, "geometry_gen: %d cells do not fit a 64-bit mask\n", count);
+        return 1;
+    }
+    
+    static int square_index[BOARD_SQUARES];
+    for (int square = 0; square < BOARD_SQUARES; square++) {
+        Cell c = square_cell(square);
+        square_index[square] = cell_index(c.q, c.r);
+    }
+    
+    int index_square[NUM_CELLS], neighbors[6][NUM_CELLS], center[NUM_CELLS];
+    Bitboard knight[NUM_CELLS], king[NUM_CELLS], pawn[2][NUM_CELLS], rays[6][NUM_CELLS];
+    Bitboard promotion[2] = {0, 0};
+    for (int i = 0; i < NUM_CELLS; i++) {
+        int q = cells[i].q, r = cells[i].r;
+        index_square[i] = cell_square(cells[i]);
+        center[i] = distance(q, r);
+        if (r == -BOARD_RADIUS) promotion[0] |= (Bitboard)1 << i;
+        if (r == BOARD_RADIUS) promotion[1] |= (Bitboard)1 << i;
+        
+        knight[i] = king[i] = 0;
+        for (int k = 0; k < 6; k++) {
+            knight[i] |= cell_bit(q + JUMPS[k][0], r + JUMPS[k][1]);
+        }
+        for (int dir = 0; dir < 6; dir++) {
+            int dq = STEPS[dir][0], dr = STEPS[dir][1];
+            neighbors[dir][i] = cell_index(q + dq, r + dr);
+            king[i] |= cell_bit(q + dq, r + dr);
+            
+            rays[dir][i] = 0;
+            for (int k = 1; cell_index(q + k * dq, r + k * dr) >= 0; k++) {
+                rays[dir][i] |= cell_bit(q + k * dq, r + k * dr);
+            }
+        }
+        
+        /* Pawns capture forward and diagonally forward */
+        pawn[0][i] = cell_bit(q, r - 1) | cell_bit(q + 1, r - 1) | cell_bit(q - 1, r);
+        pawn[1][i] = cell_bit(q, r + 1) | cell_bit(q - 1, r + 1) | cell_bit(q + 1, r);
+    }
+    
+    printf("/*\n * Underchex - Hexagonal Chess Variant\n");
+    printf(" * Geometry tables for BOARD_RADIUS %d, generated by geometry_gen; do not edit\n */\n\n",
+           BOARD_RADIUS);
+    printf("#include \"geometry.h\"\n\n");
+    printf("_Static_assert(BOARD_RADIUS == %d, \"geometry.c is stale: rerun geometry_gen\");\n\n",
+           BOARD_RADIUS);
+    
+    printf("const int8_t bb_square_index[BOARD_SQUARES] = ");
+    print_ints(square_index, BOARD_SQUARES, 0);
+    printf(";\n\nconst uint8_t bb_index_square[NUM_CELLS] = ");
+    print_ints(index_square, NUM_CELLS, 0);
+    printf(";\n\nconst Cell geo_index_cell[NUM_CELLS] = {");
+    for (int i = 0; i < NUM_CELLS; i++) {
+        if (i % 8 == 0) printf("%s\n    ", i ? "," : "");
+        printf("%s{%d, %d}", i % 8 ? ", " : "", cells[i].q, cells[i].r);
+    }
+    printf("\n};\n\n");
+    
+    print_int_rows("const int8_t geo_neighbors[6][NUM_CELLS]", &neighbors[0][0], 6, NUM_CELLS);
+    printf("const uint8_t geo_center_distance[NUM_CELLS] = ");
+    print_ints(center, NUM_CELLS, 0);
+    printf(";\n\nconst Bitboard geo_promotion_mask[2] = ");
+    print_bitboards(promotion, 2, 0);
+    printf(";\n\nconst Bitboard bb_knight_attacks[NUM_CELLS] = ");
+    print_bitboards(knight, NUM_CELLS, 0);
+    printf(";\n\nconst Bitboard bb_king_attacks[NUM_CELLS] = ");
+    print_bitboards(king, NUM_CELLS, 0);
+    printf(";\n\n");
+    print_bitboard_rows("const Bitboard bb_pawn_attacks[2][NUM_CELLS]", &pawn[0][0], 2, NUM_CELLS);
+    print_bitboard_rows("const Bitboard bb_rays[6][NUM_CELLS]", &rays[0][0], 6, NUM_CELLS);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Game history (see history.h)
+ */
+
+#include "history.h"
+#include "zobrist.h"
+#include <stdlib.h>
+#include <string.h>
+
+void history_init(GameHistory* history, const Board* start) {
+    history->board = board_copy(start);
+    history->entries = NULL;
+    history->count = 0;
+    history->length = 0;
+    history->capacity = 0;
+}
+
+void history_free(GameHistory* history) {
+    free(history->entries);
+    history->entries = NULL;
+    history->count = history->length = history->capacity = 0;
+}
+
+/* Room for at least capacity entries */
+static bool reserve(GameHistory* history, int capacity) {
+    if (capacity <= history->capacity) return true;
+    
+    int grown = history->capacity ? history->capacity * 2 : 256;
+    while (grown < capacity) grown *= 2;
+    HistoryEntry* entries = realloc(history->entries, sizeof(HistoryEntry) * grown);
+    if (!entries) return false;
+    history->entries = entries;
+    history->capacity = grown;
+    return true;
+}
+
+bool history_push(GameHistory* history, Move move) {
+    if (!reserve(history, history->count + 1)) return false;
+    
+    HistoryEntry* entry = &history->entries[history->count++];
+    entry->move = move_encode(move);
+    make_move_with_undo(&history->board, move, &entry->undo);
+    history->length = history->count;
+    return true;
+}
+
+bool history_undo(GameHistory* history) {
+    if (history->count == 0) return false;
+    
+    const HistoryEntry* entry = &history->entries[--history->count];
+    unmake_move(&history->board, move_decode(entry->move), &entry->undo);
+    return true;
+}
+
+bool history_redo(GameHistory* history) {
+    if (history->count == history->length) return false;
+    
+    HistoryEntry* entry = &history->entries[history->count++];
+    make_move_with_undo(&history->board, move_decode(entry->move), &entry->undo);
+    return true;
+}
+
+int history_repetitions(const GameHistory* history) {
+    uint64_t key = zobrist_key(&history->board);
+    int repeats = 0;
+    
+    /* Walk back over reversible moves; the position before entry i has
+     * the same side to move as now when an even number of plies follow */
+    for (int i = history->count - 1; i >= 0; i--) {
+        const UndoInfo* undo = &history->entries[i].undo;
+        if (undo->captured.type != PIECE_NONE || undo->moved.type == PIECE_PAWN) break;
+        
+        uint64_t before = undo->hash ^ (undo->moved.color == COLOR_BLACK ? zobrist_black_to_move : 0);
+        if ((history->count - i) % 2 == 0 && before == key) repeats++;
+    }
+    return repeats;
+}
+
+bool history_fork(const GameHistory* from, GameHistory* to) {
+    history_init(to, &from->board);
+    if (!reserve(to, from->count)) return false;
+    
+    if (from->count > 0) {
+        memcpy(to->entries, from->entries, sizeof(HistoryEntry) * from->count);
+    }
+    to->count = to->length = from->count;
+    return true;
+}
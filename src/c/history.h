@@ -0,0 +1,62 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Game history: the moves of a game as a log, with undo and redo
+ *
+ * A GameHistory holds the current position and, for every ply played
+ * into it, the move and the UndoInfo that takes it back, so undoing is
+ * unmake_move rather than a copy of an earlier board. Undone plies stay
+ * in the log until a different move is played, and can be redone. The log
+ * grows as needed, so a game has no length limit.
+ *
+ * Each UndoInfo keeps the hash of the position its move was played from,
+ * which is all repetition detection needs.
+ */
+
+#ifndef UNDERCHEX_HISTORY_H
+#define UNDERCHEX_HISTORY_H
+
+#include "board.h"
+#include "moves.h"
+#include <stdbool.h>
+
+typedef struct {
+    MoveCode move;
+    UndoInfo undo;
+} HistoryEntry;
+
+typedef struct {
+    Board board;              /* Current position */
+    HistoryEntry* entries;
+    int count;                /* Plies played into board */
+    int length;               /* Plies logged; those past count can be redone */
+    int capacity;
+} GameHistory;
+
+/* Start an empty history at start; history_free releases it */
+void history_init(GameHistory* history, const Board* start);
+void history_free(GameHistory* history);
+
+/* Play move, which must be legal, dropping any plies there were to redo.
+ * Returns false, leaving the history as it was, if out of memory. */
+bool history_push(GameHistory* history, Move move);
+
+/* Take back the last ply, or play the next undone one again. Return false
+ * if there is none. */
+bool history_undo(GameHistory* history);
+bool history_redo(GameHistory* history);
+
+/* The move of ply (0 for the first), ply < history->length */
+static inline Move history_move(const GameHistory* history, int ply) {
+    return move_decode(history->entries[ply].move);
+}
+
+/* Earlier occurrences of the current position, same side to move, since
+ * the last capture or pawn move (positions before one cannot recur) */
+int history_repetitions(const GameHistory* history);
+
+/* Copy the played part of from into to, which must not be initialised, to
+ * explore a line without disturbing the game. Returns false if out of
+ * memory. */
+bool history_fork(const GameHistory* from, GameHistory* to);
+
+#endif /* UNDERCHEX_HISTORY_H */
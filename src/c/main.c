@@ -5,7 +5,12 @@
  * Usage: ./underchex [options]
  * Options:
  *   -d N    Set AI depth (1-7, default 3)
+ *   -t MS   Give the AI MS milliseconds per move (iterative deepening)
+ *   -j N    Search with N threads (default 1)
  *   -c W|B  Play as White or Black (default White)
+ *   -P      Don't let the AI think during your turn
+ *   -b FILE Let the AI play from the opening book FILE
+ *   -S FILE Append the search statistics of each AI move to FILE as JSON
  *   -2      Two-player mode (no AI)
  *   -h      Show help
  * 
@@ -22,22 +27,31 @@
 #include "moves.h"
 #include "ai.h"
 #include "display.h"
+#include "history.h"
+#include "ponder.h"
 
 /* Game configuration */
 typedef struct {
     int ai_depth;
+    int ai_time_ms;     /* 0 = fixed-depth search */
+    int ai_threads;
     Color human_color;
     bool two_player;
+    bool ponder;        /* Search while the human thinks */
+    FILE* stats_log;    /* One JSON line per AI move, or NULL */
 } GameConfig;
 
 /* Game state */
 typedef struct {
-    Board board;
-    Move history[1000];
-    int history_count;
-    Board history_boards[1000];  /* For undo */
+    GameHistory history;        /* The position, and the moves to undo and redo */
     bool game_over;
     char status_message[256];
+    
+    /* The legal moves and check status of board, worked out once per
+     * position by game_legal_moves */
+    MoveList legal_moves;
+    bool in_check;
+    bool legal_moves_known;
 } GameState;
 
 static void print_usage(const char* prog) {
@@ -45,61 +59,104 @@ static void print_usage(const char* prog) {
     printf("Usage: %s [options]\n", prog);
     printf("Options:\n");
     printf("  -d N    Set AI depth (1-7, default 3)\n");
+    printf("  -t MS   Give the AI MS milliseconds per move\n");
+    printf("  -j N    Search with N threads (default 1)\n");
     printf("  -c W|B  Play as White or Black (default White)\n");
+    printf("  -P      Don't let the AI think during your turn\n");
+    printf("  -b FILE Let the AI play from the opening book FILE\n");
+    printf("  -S FILE Append the search statistics of each AI move to FILE as JSON\n");
     printf("  -2      Two-player mode (no AI)\n");
     printf("  -h      Show this help\n");
 }
 
 static void game_init(GameState* state) {
-    board_init_starting_position(&state->board);
-    state->history_count = 0;
+    Board start;
+    board_init_starting_position(&start);
+    history_init(&state->history, &start);
     state->game_over = false;
     state->status_message[0] = '\0';
+    state->legal_moves_known = false;
+}
+
+static void game_restart(GameState* state) {
+    history_free(&state->history);
+    game_init(state);
 }
 
-static void game_save_state(GameState* state) {
-    if (state->history_count < 1000) {
-        state->history_boards[state->history_count] = board_copy(&state->board);
+/* The current position's legal moves, generated on first use after the
+ * position changes */
+static const MoveList* game_legal_moves(GameState* state) {
+    if (!state->legal_moves_known) {
+        generate_legal_moves(&state->history.board, &state->legal_moves);
+        state->in_check = is_in_check(&state->history.board, state->history.board.to_move);
+        state->legal_moves_known = true;
     }
+    return &state->legal_moves;
 }
 
-static bool game_undo(GameState* state) {
-    if (state->history_count > 0) {
-        state->history_count--;
-        state->board = board_copy(&state->history_boards[state->history_count]);
-        state->game_over = false;
-        return true;
+/* Whether move is one of the current position's legal moves */
+static bool game_is_legal(GameState* state, Move move) {
+    const MoveList* moves = game_legal_moves(state);
+    MoveCode code = move_encode(move);
+    for (int i = 0; i < moves->count; i++) {
+        if (move_encode(moves->moves[i]) == code) return true;
     }
     return false;
 }
 
-static void game_make_move(GameState* state, Move move) {
-    game_save_state(state);
-    state->history[state->history_count++] = move;
-    make_move(&state->board, move);
+/* Check the new position for the end of the game */
+static void game_position_changed(GameState* state) {
+    state->legal_moves_known = false;
+    state->game_over = false;
     
-    /* Check for game over */
-    if (is_checkmate(&state->board)) {
+    if (game_legal_moves(state)->count > 0) {
+        if (history_repetitions(&state->history) >= 2) {
+            state->game_over = true;
+            snprintf(state->status_message, sizeof(state->status_message),
+                     "REPETITION! Game is a draw.");
+        } else {
+            state->status_message[0] = '\0';
+        }
+    } else if (state->in_check) {
         state->game_over = true;
-        Color winner = opponent_color(state->board.to_move);
+        Color winner = opponent_color(state->history.board.to_move);
         snprintf(state->status_message, sizeof(state->status_message),
                  "CHECKMATE! %s wins!", color_name(winner));
-    } else if (is_stalemate(&state->board)) {
+    } else {
         state->game_over = true;
         snprintf(state->status_message, sizeof(state->status_message),
                  "STALEMATE! Game is a draw.");
-    } else {
-        state->status_message[0] = '\0';
     }
 }
 
+static bool game_undo(GameState* state) {
+    if (!history_undo(&state->history)) return false;
+    game_position_changed(state);
+    return true;
+}
+
+static bool game_redo(GameState* state) {
+    if (!history_redo(&state->history)) return false;
+    game_position_changed(state);
+    return true;
+}
+
+static void game_make_move(GameState* state, Move move) {
+    if (!history_push(&state->history, move)) {
+        snprintf(state->status_message, sizeof(state->status_message),
+                 "Out of memory: move not played");
+        return;
+    }
+    game_position_changed(state);
+}
+
 /* Try to parse and execute a move from user input */
 static bool try_execute_move(GameState* state, const char* input) {
     Move move;
     
     /* Try to parse as a full move */
     if (parse_move(input, &move)) {
-        if (is_move_legal(&state->board, move)) {
+        if (game_is_legal(state, move)) {
             game_make_move(state, move);
             return true;
         } else {
@@ -112,25 +169,59 @@ static bool try_execute_move(GameState* state, const char* input) {
     return false;
 }
 
-/* AI makes a move */
-static void ai_move(GameState* state, int depth) {
+/* AI makes a move, taking over the pondering search if it guessed the
+ * human's move, then ponders the reply to its own (ponder may be NULL) */
+static void ai_move(GameState* state, const GameConfig* config, Ponder* ponder) {
     snprintf(state->status_message, sizeof(state->status_message),
              "AI thinking...");
-    display_board(&state->board);
-    display_status(&state->board, state->status_message);
+    display_board(&state->history.board);
+    display_status(&state->history.board, state->status_message);
     
     SearchStats stats;
-    Move move = find_best_move(&state->board, depth, &stats);
+    Move move;
+    bool pondered = ponder && ponder_hit(ponder, &state->history.board, config->ai_time_ms,
+                                         &move, &stats);
+    if (!pondered) {
+        SearchLimits limits = {
+            config->ai_time_ms > 0 ? AI_MAX_DEPTH : config->ai_depth,
+            config->ai_time_ms > 0 ? config->ai_time_ms : -1,
+            NULL,
+            true,
+            true,
+            NULL,
+            game_legal_moves(state),
+            NULL
+        };
+        move = find_best_move_limited(&state->history.board, &limits, &stats);
+    }
     
     char move_str[64];
     format_move(move, move_str, sizeof(move_str));
     
+    if (config->stats_log) {
+        char stats_json[4096];
+        search_stats_json(&stats, stats_json, sizeof(stats_json));
+        fprintf(config->stats_log, "{\"ply\":%d,\"move\":\"%s\",\"pondered\":%s,\"stats\":%s}\n",
+                state->history.count, move_str, pondered ? "true" : "false", stats_json);
+        fflush(config->stats_log);
+    }
+    
     game_make_move(state, move);
     
     if (!state->game_over) {
-        snprintf(state->status_message, sizeof(state->status_message),
-                 "AI played: %s (eval: %d, nodes: %d)",
-                 move_str, stats.eval, stats.nodes_searched);
+        if (stats.from_book) {
+            snprintf(state->status_message, sizeof(state->status_message),
+                     "AI played: %s (book)", move_str);
+        } else {
+            snprintf(state->status_message, sizeof(state->status_message),
+                     "AI played: %s (eval: %d, depth: %d, nodes: %d%s)",
+                     move_str, stats.eval, stats.depth_reached, stats.nodes_searched,
+                     pondered ? ", pondered" : "");
+        }
+        if (ponder) {
+            ponder_start(ponder, &state->history.board,
+                         config->ai_time_ms > 0 ? AI_MAX_DEPTH : config->ai_depth);
+        }
     }
 }
 
@@ -144,8 +235,8 @@ static bool select_and_move(GameState* state) {
     movelist_init(&valid_moves);
     
     /* First, get the 'from' cell */
-    display_board(&state->board);
-    display_status(&state->board, "Select piece (q,r) or enter full move:");
+    display_board(&state->history.board);
+    display_status(&state->history.board, "Select piece (q,r) or enter full move:");
     
     if (!display_get_input(input, sizeof(input), "> ")) {
         return false;
@@ -169,8 +260,21 @@ static bool select_and_move(GameState* state) {
         }
         return true;
     }
+    if (input[0] == 'r' || input[0] == 'R') {
+        if (game_redo(state)) {
+            /* Redoing the last move of a finished game shows its result */
+            if (!state->game_over) {
+                snprintf(state->status_message, sizeof(state->status_message),
+                         "Move redone");
+            }
+        } else {
+            snprintf(state->status_message, sizeof(state->status_message),
+                     "Nothing to redo");
+        }
+        return true;
+    }
     if (input[0] == 'n' || input[0] == 'N') {
-        game_init(state);
+        game_restart(state);
         snprintf(state->status_message, sizeof(state->status_message),
                  "New game started");
         return true;
@@ -192,26 +296,25 @@ static bool select_and_move(GameState* state) {
             return true;
         }
         
-        Piece* p = board_get(&state->board, from_cell);
+        Piece* p = board_get(&state->history.board, from_cell);
         if (p->type == PIECE_NONE) {
             snprintf(state->status_message, sizeof(state->status_message),
                      "No piece at that cell");
             return true;
         }
-        if (p->color != state->board.to_move) {
+        if (p->color != state->history.board.to_move) {
             snprintf(state->status_message, sizeof(state->status_message),
                      "That's not your piece!");
             return true;
         }
         
-        /* Generate valid moves for this piece */
-        MoveList all_moves;
-        generate_legal_moves(&state->board, &all_moves);
+        /* Valid moves for this piece */
+        const MoveList* all_moves = game_legal_moves(state);
         
         movelist_init(&valid_moves);
-        for (int i = 0; i < all_moves.count; i++) {
-            if (cell_equals(all_moves.moves[i].from, from_cell)) {
-                movelist_add(&valid_moves, all_moves.moves[i]);
+        for (int i = 0; i < all_moves->count; i++) {
+            if (cell_equals(all_moves->moves[i].from, from_cell)) {
+                movelist_add(&valid_moves, all_moves->moves[i]);
             }
         }
         
@@ -222,8 +325,8 @@ static bool select_and_move(GameState* state) {
         }
         
         /* Show board with highlighted moves */
-        display_board_highlighted(&state->board, from_cell, &valid_moves);
-        display_status(&state->board, "Select destination (q,r):");
+        display_board_highlighted(&state->history.board, from_cell, &valid_moves);
+        display_status(&state->history.board, "Select destination (q,r):");
         
         if (!display_get_input(input, sizeof(input), "> ")) {
             return true;  /* Cancelled */
@@ -241,7 +344,7 @@ static bool select_and_move(GameState* state) {
                         /* Find all promotion options for this destination */
                         snprintf(state->status_message, sizeof(state->status_message),
                                  "Promote to (Q/L/C/N):");
-                        display_status(&state->board, state->status_message);
+                        display_status(&state->history.board, state->status_message);
                         
                         if (display_get_input(input, sizeof(input), "> ")) {
                             char promo = toupper(input[0]);
@@ -283,24 +386,53 @@ static bool select_and_move(GameState* state) {
 int main(int argc, char* argv[]) {
     GameConfig config = {
         .ai_depth = 3,
+        .ai_time_ms = 0,
+        .ai_threads = 1,
         .human_color = COLOR_WHITE,
-        .two_player = false
+        .two_player = false,
+        .ponder = true,
+        .stats_log = NULL
     };
     
     /* Parse command line arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "d:c:2h")) != -1) {
+    while ((opt = getopt(argc, argv, "d:t:j:c:Pb:S:2h")) != -1) {
         switch (opt) {
             case 'd':
                 config.ai_depth = atoi(optarg);
                 if (config.ai_depth < 1) config.ai_depth = 1;
                 if (config.ai_depth > 7) config.ai_depth = 7;
                 break;
+            case 't':
+                config.ai_time_ms = atoi(optarg);
+                if (config.ai_time_ms < 1) config.ai_time_ms = 1;
+                break;
+            case 'j':
+                config.ai_threads = atoi(optarg);
+                if (config.ai_threads < 1) config.ai_threads = 1;
+                if (config.ai_threads > AI_MAX_THREADS) config.ai_threads = AI_MAX_THREADS;
+                break;
             case 'c':
                 if (optarg[0] == 'B' || optarg[0] == 'b') {
                     config.human_color = COLOR_BLACK;
                 }
                 break;
+            case 'P':
+                config.ponder = false;
+                break;
+            case 'b':
+                if (!ai_set_book(optarg)) {
+                    fprintf(stderr, "Could not open opening book %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'S':
+                config.stats_log = fopen(optarg, "a");
+                if (!config.stats_log) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
             case '2':
                 config.two_player = true;
                 break;
@@ -313,9 +445,14 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    ai_set_threads(config.ai_threads);
+    
     /* Initialize game */
     GameState state;
     game_init(&state);
+    Ponder ponder;
+    ponder_init(&ponder);
+    Ponder* ai_ponder = (config.ponder && !config.two_player) ? &ponder : NULL;
     
     /* Initialize display */
     display_init();
@@ -323,21 +460,22 @@ int main(int argc, char* argv[]) {
     /* Main game loop */
     bool running = true;
     while (running) {
-        display_board(&state.board);
-        display_status(&state.board, state.status_message);
+        display_board(&state.history.board);
+        display_status(&state.history.board, state.status_message);
         
-        if (state.history_count > 0) {
-            display_move_history(state.history, state.history_count);
+        if (state.history.count > 0) {
+            display_move_history(&state.history);
         }
         
         if (state.game_over) {
+            ponder_stop(&ponder);
             display_message(state.status_message);
             
             /* Ask for new game */
             char input[32];
             if (display_get_input(input, sizeof(input), "New game? (y/n): ")) {
                 if (input[0] == 'y' || input[0] == 'Y') {
-                    game_init(&state);
+                    game_restart(&state);
                     continue;
                 }
             }
@@ -346,17 +484,22 @@ int main(int argc, char* argv[]) {
         
         /* Determine whose turn it is */
         bool human_turn = config.two_player || 
-                          (state.board.to_move == config.human_color);
+                          (state.history.board.to_move == config.human_color);
         
         if (human_turn) {
+            /* An undo or new game leaves nothing to ponder */
+            ponder_discard_stale(&ponder, &state.history.board);
             running = select_and_move(&state);
         } else {
             /* AI turn */
-            ai_move(&state, config.ai_depth);
+            ai_move(&state, &config, ai_ponder);
         }
     }
     
     /* Cleanup */
+    ponder_destroy(&ponder);
+    history_free(&state.history);
+    if (config.stats_log) fclose(config.stats_log);
     display_cleanup();
     
     printf("Thanks for playing Underchex!\n");
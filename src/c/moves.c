@@ -6,21 +6,13 @@
  */
 
 #include "moves.h"
+#include "bitboard.h"
+#include "geometry.h"
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
 
-/* Unique knight offsets (6 unique destinations) */
-static const Direction KNIGHT_OFFSETS[6] = {
-    { 1, -2},  /* N-NE or NE-N */
-    {-1, -1},  /* N-NW or NW-N */
-    { 2, -1},  /* NE-SE or SE-NE */
-    { 1,  1},  /* SE-S or S-SE */
-    {-1,  2},  /* S-SW or SW-S */
-    {-2,  1}   /* SW-NW or NW-SW */
-};
-
 /* Lance A directions: N, S, NW, SE */
 static const int LANCE_A_DIRS[4] = {DIR_N, DIR_S, DIR_NW, DIR_SE};
 
@@ -40,251 +32,153 @@ void movelist_add(MoveList* list, Move move) {
     }
 }
 
-/* Generate rider moves in a direction */
-static void generate_rider_moves(const Board* board, Cell from, Color color,
-                                  int dir_idx, MoveList* list) {
-    Direction d = DIRECTIONS[dir_idx];
-    Cell to = cell_add(from, d);
-    
-    while (cell_is_valid(to)) {
-        Piece* target = board_get((Board*)board, to);
-        if (target->type == PIECE_NONE) {
-            Move m = {from, to, PIECE_NONE};
-            movelist_add(list, m);
-        } else if (target->color != color) {
-            /* Capture */
-            Move m = {from, to, PIECE_NONE};
-            movelist_add(list, m);
-            break;
-        } else {
-            /* Blocked by own piece */
-            break;
-        }
-        to = cell_add(to, d);
-    }
+MoveCode move_encode(Move move) {
+    if (cell_equals(move.from, move.to)) return MOVE_CODE_NONE;
+    return move_code_make(bb_square_index[cell_square(move.from)],
+                          bb_square_index[cell_square(move.to)], move.promotion);
 }
 
-/* Generate step moves (king-like) */
-static void generate_step_moves(const Board* board, Cell from, Color color,
-                                 const int* dirs, int num_dirs, MoveList* list) {
-    for (int i = 0; i < num_dirs; i++) {
-        Direction d = DIRECTIONS[dirs[i]];
-        Cell to = cell_add(from, d);
-        
-        if (!cell_is_valid(to)) continue;
-        
-        Piece* target = board_get((Board*)board, to);
-        if (target->type == PIECE_NONE || target->color != color) {
-            Move m = {from, to, PIECE_NONE};
-            movelist_add(list, m);
-        }
-    }
+Move move_decode(MoveCode code) {
+    if (code == MOVE_CODE_NONE) return (Move){{0, 0}, {0, 0}, PIECE_NONE};
+    return (Move){square_cell(bb_index_square[move_code_from(code)]),
+                  square_cell(bb_index_square[move_code_to(code)]),
+                  move_code_promotion(code)};
 }
 
-/* Check if a pawn move results in promotion */
-static bool is_promotion_rank(Cell to, Color color) {
-    if (color == COLOR_WHITE) {
-        return to.r == -BOARD_RADIUS;
-    } else {
-        return to.r == BOARD_RADIUS;
+void movelist_encode(const MoveList* list, MoveCode* out) {
+    for (int i = 0; i < list->count; i++) {
+        Move move = list->moves[i];
+        out[i] = move_code_make(bb_square_index[cell_square(move.from)],
+                                bb_square_index[cell_square(move.to)], move.promotion);
     }
 }
 
-/* Generate pawn moves */
-static void generate_pawn_moves(const Board* board, Cell from, Color color, MoveList* list) {
-    /* Forward direction depends on color */
-    int forward_dir = (color == COLOR_WHITE) ? DIR_N : DIR_S;
-    int forward_left = (color == COLOR_WHITE) ? DIR_NW : DIR_SW;
-    int forward_right = (color == COLOR_WHITE) ? DIR_NE : DIR_SE;
-    
-    Direction fwd = DIRECTIONS[forward_dir];
-    Direction fwd_left = DIRECTIONS[forward_left];
-    Direction fwd_right = DIRECTIONS[forward_right];
-    
-    /* Forward move */
-    Cell to = cell_add(from, fwd);
-    if (cell_is_valid(to)) {
-        Piece* target = board_get((Board*)board, to);
-        if (target->type == PIECE_NONE) {
-            if (is_promotion_rank(to, color)) {
-                /* Promotion - generate all promotion options */
-                PieceType promos[] = {PIECE_QUEEN, PIECE_LANCE, PIECE_CHARIOT, PIECE_KNIGHT};
-                for (int i = 0; i < 4; i++) {
-                    Move m = {from, to, promos[i]};
-                    movelist_add(list, m);
-                }
-            } else {
-                Move m = {from, to, PIECE_NONE};
-                movelist_add(list, m);
-            }
-        }
-    }
+/* Square offsets of DIRECTIONS and the knight jumps in Board.squares */
+#define SQUARE_OFFSET(dq, dr) ((dq) * BOARD_STRIDE + (dr))
+
+static const int DIRECTION_SQUARES[6] = {
+    SQUARE_OFFSET( 0, -1),  /* N  */
+    SQUARE_OFFSET( 0,  1),  /* S  */
+    SQUARE_OFFSET( 1, -1),  /* NE */
+    SQUARE_OFFSET(-1,  1),  /* SW */
+    SQUARE_OFFSET(-1,  0),  /* NW */
+    SQUARE_OFFSET( 1,  0)   /* SE */
+};
+
+static const int KNIGHT_SQUARES[6] = {
+    SQUARE_OFFSET( 1, -2),  /* N-NE or NE-N */
+    SQUARE_OFFSET(-1, -1),  /* N-NW or NW-N */
+    SQUARE_OFFSET( 2, -1),  /* NE-SE or SE-NE */
+    SQUARE_OFFSET( 1,  1),  /* SE-S or S-SE */
+    SQUARE_OFFSET(-1,  2),  /* S-SW or SW-S */
+    SQUARE_OFFSET(-2,  1)   /* SW-NW or NW-SW */
+};
+
+/* Add a move to every cell in targets, lowest index first. Pawn moves to
+ * the last rank expand into every promotion. */
+static void add_moves(MoveList* list, Cell from, Bitboard targets, bool pawn, Color color) {
+    static const PieceType PROMOTIONS[4] = {PIECE_QUEEN, PIECE_LANCE, PIECE_CHARIOT, PIECE_KNIGHT};
+    Bitboard promoting = pawn ? geo_promotion_mask[color - 1] : 0;
     
-    /* Capture moves (forward, forward-left, forward-right in Underchex) */
-    Direction capture_dirs[] = {fwd, fwd_left, fwd_right};
-    for (int i = 0; i < 3; i++) {
-        to = cell_add(from, capture_dirs[i]);
-        if (!cell_is_valid(to)) continue;
+    while (targets) {
+        int index = bb_first(targets);
+        Cell to = geo_index_cell[index];
+        targets &= targets - 1;
         
-        Piece* target = board_get((Board*)board, to);
-        if (target->type != PIECE_NONE && target->color != color) {
-            if (is_promotion_rank(to, color)) {
-                PieceType promos[] = {PIECE_QUEEN, PIECE_LANCE, PIECE_CHARIOT, PIECE_KNIGHT};
-                for (int j = 0; j < 4; j++) {
-                    Move m = {from, to, promos[j]};
-                    movelist_add(list, m);
-                }
-            } else {
-                Move m = {from, to, PIECE_NONE};
+        if (BB_CELL(index) & promoting) {
+            for (int i = 0; i < 4; i++) {
+                Move m = {from, to, PROMOTIONS[i]};
                 movelist_add(list, m);
             }
-        }
-    }
-}
-
-/* Generate knight moves */
-static void generate_knight_moves(const Board* board, Cell from, Color color, MoveList* list) {
-    for (int i = 0; i < 6; i++) {
-        Cell to = cell_make(from.q + KNIGHT_OFFSETS[i].dq, 
-                           from.r + KNIGHT_OFFSETS[i].dr);
-        
-        if (!cell_is_valid(to)) continue;
-        
-        Piece* target = board_get((Board*)board, to);
-        if (target->type == PIECE_NONE || target->color != color) {
+        } else {
             Move m = {from, to, PIECE_NONE};
             movelist_add(list, m);
         }
     }
 }
 
-void generate_pseudo_legal_moves(const Board* board, MoveList* list) {
+/* Which moves generate_moves produces */
+typedef enum {
+    GEN_ALL,
+    GEN_CAPTURES,      /* Captures, including capturing promotions */
+    GEN_NOISY          /* Captures and every promotion */
+} GenMode;
+
+/* Shared by full and capture-only generation: each piece of the side to
+ * move in list order, with its attacked cells masked to the targets */
+static void generate_moves(const Board* board, MoveList* list, GenMode mode) {
     movelist_init(list);
     Color color = board->to_move;
+    int side = color - 1;
+    Bitboard own = board->occupied[side];
+    Bitboard enemy = board->occupied[1 - side];
+    Bitboard occupied = own | enemy;
+    Bitboard targets = (mode == GEN_ALL) ? ~own : enemy;
     
-    /* All 6 directions for king/queen */
-    int all_dirs[6] = {0, 1, 2, 3, 4, 5};
-    
-    /* Iterate over all cells */
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell cell = cell_make(q, r);
-            if (!cell_is_valid(cell)) continue;
-            
-            Piece* p = board_get((Board*)board, cell);
-            if (p->type == PIECE_NONE || p->color != color) continue;
-            
-            switch (p->type) {
-                case PIECE_PAWN:
-                    generate_pawn_moves(board, cell, color, list);
-                    break;
-                    
-                case PIECE_KNIGHT:
-                    generate_knight_moves(board, cell, color, list);
-                    break;
-                    
-                case PIECE_LANCE:
-                    if (p->variant == 0) {
-                        /* Lance A: N, S, NW, SE */
-                        for (int i = 0; i < 4; i++) {
-                            generate_rider_moves(board, cell, color, LANCE_A_DIRS[i], list);
-                        }
-                    } else {
-                        /* Lance B: N, S, NE, SW */
-                        for (int i = 0; i < 4; i++) {
-                            generate_rider_moves(board, cell, color, LANCE_B_DIRS[i], list);
-                        }
-                    }
-                    break;
-                    
-                case PIECE_CHARIOT:
-                    for (int i = 0; i < 4; i++) {
-                        generate_rider_moves(board, cell, color, CHARIOT_DIRS[i], list);
-                    }
-                    break;
-                    
-                case PIECE_QUEEN:
-                    for (int i = 0; i < 6; i++) {
-                        generate_rider_moves(board, cell, color, i, list);
-                    }
-                    break;
-                    
-                case PIECE_KING:
-                    generate_step_moves(board, cell, color, all_dirs, 6, list);
-                    break;
-                    
-                default:
-                    break;
-            }
-        }
-    }
-}
-
-/* Check if a cell is attacked by a specific color */
-bool is_cell_attacked(const Board* board, Cell target, Color by_color) {
-    /* Check attacks from each direction (riders) */
-    for (int dir = 0; dir < 6; dir++) {
-        Direction d = DIRECTIONS[dir];
-        Cell from = cell_add(target, d);
-        int dist = 1;
+    for (int i = 0; i < board->piece_count[side]; i++) {
+        int square = board->pieces[side][i];
+        int index = bb_square_index[square];
+        Cell from = square_cell(square);
+        Piece p = board->squares[square];
         
-        while (cell_is_valid(from)) {
-            Piece* p = board_get((Board*)board, from);
-            if (p->type != PIECE_NONE) {
-                if (p->color == by_color) {
-                    /* Check if this piece can attack along this direction */
-                    bool can_attack = false;
-                    
-                    if (p->type == PIECE_QUEEN) {
-                        can_attack = true;
-                    } else if (p->type == PIECE_KING && dist == 1) {
-                        can_attack = true;
-                    } else if (p->type == PIECE_LANCE) {
-                        if (p->variant == 0) {
-                            /* Lance A: N, S, NW, SE */
-                            can_attack = (dir == DIR_N || dir == DIR_S || 
-                                         dir == DIR_NW || dir == DIR_SE);
-                        } else {
-                            /* Lance B: N, S, NE, SW */
-                            can_attack = (dir == DIR_N || dir == DIR_S || 
-                                         dir == DIR_NE || dir == DIR_SW);
-                        }
-                    } else if (p->type == PIECE_CHARIOT) {
-                        can_attack = (dir == DIR_NE || dir == DIR_NW || 
-                                     dir == DIR_SE || dir == DIR_SW);
-                    } else if (p->type == PIECE_PAWN && dist == 1) {
-                        /* Pawns capture forward and diagonally forward */
-                        if (by_color == COLOR_WHITE) {
-                            /* White attacks N, NE, NW */
-                            can_attack = (dir == DIR_S || dir == DIR_SE || dir == DIR_SW);
-                        } else {
-                            /* Black attacks S, SE, SW */
-                            can_attack = (dir == DIR_N || dir == DIR_NE || dir == DIR_NW);
-                        }
-                    }
-                    
-                    if (can_attack) return true;
+        if (p.type == PIECE_PAWN) {
+            /* Captures on the three forward cells, plus a step forward */
+            Bitboard moves = bb_pawn_attacks[side][index] & enemy;
+            if (mode != GEN_CAPTURES) {
+                int ahead = geo_neighbors[(color == COLOR_WHITE) ? DIR_N : DIR_S][index];
+                if (ahead >= 0 && !(occupied & BB_CELL(ahead)) &&
+                    (mode == GEN_ALL || (geo_promotion_mask[side] & BB_CELL(ahead)))) {
+                    moves |= BB_CELL(ahead);
                 }
-                break;  /* Blocked */
             }
-            from = cell_add(from, d);
-            dist++;
+            add_moves(list, from, moves, true, color);
+        } else {
+            add_moves(list, from, bb_piece_attacks(p, index, occupied) & targets, false, color);
         }
     }
-    
-    /* Check knight attacks */
-    for (int i = 0; i < 6; i++) {
-        Cell from = cell_make(target.q + KNIGHT_OFFSETS[i].dq,
-                             target.r + KNIGHT_OFFSETS[i].dr);
-        if (!cell_is_valid(from)) continue;
-        
-        Piece* p = board_get((Board*)board, from);
-        if (p->type == PIECE_KNIGHT && p->color == by_color) {
+}
+
+void generate_pseudo_legal_moves(const Board* board, MoveList* list) {
+    generate_moves(board, list, GEN_ALL);
+}
+
+void generate_pseudo_legal_captures(const Board* board, MoveList* list) {
+    generate_moves(board, list, GEN_CAPTURES);
+}
+
+/* Whether p, standing dist steps from a target in direction dir, attacks
+ * the target along that line */
+static bool attacks_along(Piece p, int dir, int dist) {
+    switch (p.type) {
+        case PIECE_QUEEN:
             return true;
-        }
+        case PIECE_KING:
+            return dist == 1;
+        case PIECE_LANCE:
+            /* Lance A: N, S, NW, SE; Lance B: N, S, NE, SW */
+            if (dir == DIR_N || dir == DIR_S) return true;
+            return (p.variant == 0) ? (dir == DIR_NW || dir == DIR_SE)
+                                    : (dir == DIR_NE || dir == DIR_SW);
+        case PIECE_CHARIOT:
+            return dir == DIR_NE || dir == DIR_NW || dir == DIR_SE || dir == DIR_SW;
+        case PIECE_PAWN:
+            /* Pawns capture forward and diagonally forward: white attacks
+             * N, NE, NW, so a white attacker sits S, SE or SW of its target */
+            if (dist != 1) return false;
+            if (p.color == COLOR_WHITE) {
+                return dir == DIR_S || dir == DIR_SE || dir == DIR_SW;
+            }
+            return dir == DIR_N || dir == DIR_NE || dir == DIR_NW;
+        default:
+            return false;
     }
-    
-    return false;
+}
+
+/* Check if a cell is attacked by a specific color */
+bool is_cell_attacked(const Board* board, Cell target, Color by_color) {
+    if (!cell_is_valid(target)) return false;
+    return bb_cell_attacked(board, cell_to_index(target), by_color,
+                            board->occupied[0] | board->occupied[1]);
 }
 
 bool is_in_check(const Board* board, Color color) {
@@ -293,8 +187,26 @@ bool is_in_check(const Board* board, Color color) {
 }
 
 void make_move(Board* board, Move move) {
-    Piece* from_piece = board_get(board, move.from);
-    Piece moving = *from_piece;
+    UndoInfo undo;
+    make_move_with_undo(board, move, &undo);
+}
+
+void make_move_with_undo(Board* board, Move move, UndoInfo* undo) {
+    Piece moving = board->squares[cell_square(move.from)];
+    
+    undo->moved = moving;
+    undo->captured = board->squares[cell_square(move.to)];
+    undo->captured_slot = 0;
+    undo->white_king = board->white_king;
+    undo->black_king = board->black_king;
+    undo->half_move_count = board->half_move_count;
+    undo->full_move_count = board->full_move_count;
+    undo->hash = board->hash;
+    
+    /* Take off a captured piece */
+    if (undo->captured.type != PIECE_NONE) {
+        undo->captured_slot = (uint8_t)board_remove_piece(board, move.to);
+    }
     
     /* Handle promotion */
     if (move.promotion != PIECE_NONE) {
@@ -305,12 +217,7 @@ void make_move(Board* board, Move move) {
         }
     }
     
-    /* Clear from square */
-    Piece empty = {PIECE_NONE, COLOR_NONE, 0};
-    board_set(board, move.from, empty);
-    
-    /* Place piece on destination */
-    board_set(board, move.to, moving);
+    board_move_piece(board, move.from, move.to, moving);
     
     /* Update turn */
     if (board->to_move == COLOR_BLACK) {
@@ -320,49 +227,312 @@ void make_move(Board* board, Move move) {
     board->half_move_count++;
 }
 
-bool is_move_legal(const Board* board, Move move) {
-    /* Check basic validity */
-    if (!cell_is_valid(move.from) || !cell_is_valid(move.to)) return false;
+void unmake_move(Board* board, Move move, const UndoInfo* undo) {
+    board_move_piece(board, move.to, move.from, undo->moved);
+    if (undo->captured.type != PIECE_NONE) {
+        board_restore_piece(board, move.to, undo->captured, undo->captured_slot);
+    }
     
-    Piece* from_piece = board_get((Board*)board, move.from);
-    if (from_piece->type == PIECE_NONE) return false;
-    if (from_piece->color != board->to_move) return false;
+    board->white_king = undo->white_king;
+    board->black_king = undo->black_king;
+    board->half_move_count = undo->half_move_count;
+    board->full_move_count = undo->full_move_count;
+    board->hash = undo->hash;
+    board->to_move = undo->moved.color;
+}
+
+/* Add unmoves for a piece on 'to' that arrived by riding along dir_idx */
+static void generate_rider_unmoves(const Board* board, int to, Cell to_cell, int dir_idx,
+                                   MoveList* list) {
+    int step = DIRECTION_SQUARES[dir_idx];
+    
+    for (int from = to - step; board->squares[from].type == PIECE_NONE; from -= step) {
+        Move m = {square_cell(from), to_cell, PIECE_NONE};
+        movelist_add(list, m);
+    }
+}
+
+/* Add an unmove from 'to' back to to - offset if that square is empty */
+static void add_step_unmove(const Board* board, int to, Cell to_cell, int offset, MoveList* list) {
+    int from = to - offset;
     
-    /* Check if move is in the pseudo-legal list */
-    MoveList pseudo;
-    generate_pseudo_legal_moves(board, &pseudo);
+    if (board->squares[from].type == PIECE_NONE) {
+        Move m = {square_cell(from), to_cell, PIECE_NONE};
+        movelist_add(list, m);
+    }
+}
+
+void generate_unmoves(const Board* board, MoveList* list) {
+    movelist_init(list);
+    Color color = opponent_color(board->to_move);
+    int side = color - 1;
     
-    bool found = false;
-    for (int i = 0; i < pseudo.count; i++) {
-        if (cell_equals(pseudo.moves[i].from, move.from) && 
-            cell_equals(pseudo.moves[i].to, move.to)) {
-            found = true;
+    for (int i = 0; i < board->piece_count[side]; i++) {
+        int to = board->pieces[side][i];
+        Cell cell = square_cell(to);
+        Piece p = board->squares[to];
+        
+        switch (p.type) {
+            case PIECE_PAWN:
+                /* Only the non-capturing forward step can be retracted */
+                add_step_unmove(board, to, cell,
+                                DIRECTION_SQUARES[(color == COLOR_WHITE) ? DIR_N : DIR_S], list);
+                break;
+            
+            case PIECE_KNIGHT:
+                for (int d = 0; d < 6; d++) {
+                    add_step_unmove(board, to, cell, KNIGHT_SQUARES[d], list);
+                }
+                break;
+            
+            case PIECE_LANCE:
+                for (int d = 0; d < 4; d++) {
+                    generate_rider_unmoves(board, to, cell,
+                                           p.variant == 0 ? LANCE_A_DIRS[d] : LANCE_B_DIRS[d],
+                                           list);
+                }
+                break;
+            
+            case PIECE_CHARIOT:
+                for (int d = 0; d < 4; d++) {
+                    generate_rider_unmoves(board, to, cell, CHARIOT_DIRS[d], list);
+                }
+                break;
+            
+            case PIECE_QUEEN:
+                for (int d = 0; d < 6; d++) {
+                    generate_rider_unmoves(board, to, cell, d, list);
+                }
+                break;
+            
+            case PIECE_KING:
+                for (int d = 0; d < 6; d++) {
+                    add_step_unmove(board, to, cell, DIRECTION_SQUARES[d], list);
+                }
+                break;
+            
+            default:
+                break;
+        }
+    }
+}
+
+void retract_move(Board* board, Move move) {
+    Piece moving = board->squares[cell_square(move.to)];
+    board_move_piece(board, move.to, move.from, moving);
+    
+    /* Back to the mover's turn */
+    board->to_move = opponent_color(board->to_move);
+    if (board->to_move == COLOR_BLACK) {
+        board->full_move_count--;
+    }
+    board->half_move_count--;
+}
+
+/* Whether a pseudo-legal move keeps the mover's king out of check, by
+ * playing it. The board is left as it was. */
+static bool leaves_king_safe(Board* board, Move move) {
+    Color mover = board->to_move;
+    UndoInfo undo;
+    make_move_with_undo(board, move, &undo);
+    bool safe = !is_in_check(board, mover);
+    unmake_move(board, move, &undo);
+    return safe;
+}
+
+/* If to == from + k * DIRECTIONS[dir] for some k >= 1, return k; else 0 */
+static int ray_steps(Cell from, Cell to, int dir) {
+    Direction d = DIRECTIONS[dir];
+    int dq = to.q - from.q;
+    int dr = to.r - from.r;
+    int k = (d.dq != 0) ? dq / d.dq : dr / d.dr;
+    return (k > 0 && dq == k * d.dq && dr == k * d.dr) ? k : 0;
+}
+
+/* Checks and pins against the side to move, found by scanning out from
+ * its king once */
+typedef struct {
+    Cell king;
+    Color enemy;
+    int checkers;
+    Cell checker;
+    int check_dir;        /* Ray from the king to a sliding checker, or -1 */
+    int check_dist;
+    int8_t pin_dir[BOARD_SIZE][BOARD_SIZE];  /* Ray to the pinner, or -1 */
+} KingSafety;
+
+/* Returns false if the side to move has no king on its recorded square */
+static bool compute_king_safety(const Board* board, KingSafety* ks) {
+    Color color = board->to_move;
+    ks->king = (color == COLOR_WHITE) ? board->white_king : board->black_king;
+    ks->enemy = opponent_color(color);
+    ks->checkers = 0;
+    ks->check_dir = -1;
+    ks->check_dist = 0;
+    memset(ks->pin_dir, -1, sizeof(ks->pin_dir));
+    
+    Piece* king = board_get((Board*)board, ks->king);
+    if (!king || king->type != PIECE_KING || king->color != color) return false;
+    int king_sq = cell_square(ks->king);
+    
+    for (int dir = 0; dir < 6; dir++) {
+        int step = DIRECTION_SQUARES[dir];
+        int own = -1;
+        
+        for (int sq = king_sq + step, dist = 1; ; sq += step, dist++) {
+            Piece p = board->squares[sq];
+            if (p.type == PIECE_NONE) continue;
+            
+            if (p.color == color) {
+                /* A second own piece on the ray shields the first */
+                if (own >= 0) break;
+                own = sq;
+                continue;
+            }
+            
+            /* An enemy piece, or the edge */
+            if (attacks_along(p, dir, dist)) {
+                if (own < 0) {
+                    ks->checkers++;
+                    ks->checker = square_cell(sq);
+                    ks->check_dir = dir;
+                    ks->check_dist = dist;
+                } else {
+                    Cell pinned = square_cell(own);
+                    ks->pin_dir[pinned.q + BOARD_RADIUS][pinned.r + BOARD_RADIUS] = (int8_t)dir;
+                }
+            }
             break;
         }
     }
-    if (!found) return false;
     
-    /* Make move on a copy and check if king is in check */
-    Board copy = board_copy(board);
-    make_move(&copy, move);
+    for (int i = 0; i < 6; i++) {
+        int sq = king_sq + KNIGHT_SQUARES[i];
+        Piece p = board->squares[sq];
+        if (p.type == PIECE_KNIGHT && p.color == ks->enemy) {
+            ks->checkers++;
+            ks->checker = square_cell(sq);
+            ks->check_dir = -1;
+        }
+    }
     
-    /* After the move, check if the moving side's king is in check */
-    return !is_in_check(&copy, board->to_move);
+    return true;
 }
 
-void generate_legal_moves(const Board* board, MoveList* list) {
-    MoveList pseudo;
-    generate_pseudo_legal_moves(board, &pseudo);
+/* Whether a pseudo-legal move leaves the king safe, given its checks and pins */
+static bool move_is_safe(const Board* board, const KingSafety* ks, Move move) {
+    /* The king may not step onto an attacked cell, including one behind
+     * it on a checking ray */
+    if (cell_equals(move.from, ks->king)) {
+        Bitboard occupied = (board->occupied[0] | board->occupied[1]) &
+                            ~BB_CELL(bb_square_index[cell_square(ks->king)]);
+        return !bb_cell_attacked(board, bb_square_index[cell_square(move.to)], ks->enemy,
+                                 occupied);
+    }
     
-    movelist_init(list);
+    if (ks->checkers > 1) return false;
+    
+    /* A pinned piece stays on the line through its king and pinner */
+    int pin = ks->pin_dir[move.from.q + BOARD_RADIUS][move.from.r + BOARD_RADIUS];
+    if (pin >= 0 && !ray_steps(move.from, move.to, pin) &&
+        !ray_steps(move.from, move.to, pin ^ 1)) {
+        return false;
+    }
+    
+    /* A single check must be captured or blocked */
+    if (ks->checkers == 1) {
+        if (cell_equals(move.to, ks->checker)) return true;
+        if (ks->check_dir < 0) return false;
+        int k = ray_steps(ks->king, move.to, ks->check_dir);
+        return k > 0 && k < ks->check_dist;
+    }
     
-    for (int i = 0; i < pseudo.count; i++) {
-        if (is_move_legal(board, pseudo.moves[i])) {
-            movelist_add(list, pseudo.moves[i]);
+    return true;
+}
+
+/* Whether the piece on move.from can make the move, ignoring checks */
+static bool is_pseudo_legal(const Board* board, Move move) {
+    Piece* p = board_get((Board*)board, move.from);
+    Piece* target = board_get((Board*)board, move.to);
+    if (target->type != PIECE_NONE && target->color == p->color) return false;
+    int from = bb_square_index[cell_square(move.from)];
+    int to = bb_square_index[cell_square(move.to)];
+    
+    switch (p->type) {
+        case PIECE_PAWN: {
+            int fwd = (p->color == COLOR_WHITE) ? DIR_N : DIR_S;
+            
+            /* Steps forward onto an empty cell, captures on any forward cell */
+            if (geo_neighbors[fwd][from] == to) return true;
+            return target->type != PIECE_NONE &&
+                   (bb_pawn_attacks[p->color - 1][from] & BB_CELL(to));
         }
+        
+        case PIECE_KNIGHT:
+            return bb_knight_attacks[from] & BB_CELL(to);
+        
+        case PIECE_KING:
+            return bb_king_attacks[from] & BB_CELL(to);
+        
+        case PIECE_LANCE:
+        case PIECE_CHARIOT:
+        case PIECE_QUEEN: {
+            Bitboard occupied = board->occupied[0] | board->occupied[1];
+            return bb_piece_attacks(*p, from, occupied) & BB_CELL(to);
+        }
+        
+        default:
+            return false;
     }
 }
 
+bool is_move_legal(const Board* board, Move move) {
+    /* Check basic validity */
+    if (!cell_is_valid(move.from) || !cell_is_valid(move.to)) return false;
+    
+    Piece* from_piece = board_get((Board*)board, move.from);
+    if (from_piece->type == PIECE_NONE) return false;
+    if (from_piece->color != board->to_move) return false;
+    if (!is_pseudo_legal(board, move)) return false;
+    
+    KingSafety ks;
+    if (compute_king_safety(board, &ks)) {
+        return move_is_safe(board, &ks, move);
+    }
+    
+    /* No king where the board says: try the move on a scratch copy */
+    Board scratch = board_copy(board);
+    return leaves_king_safe(&scratch, move);
+}
+
+/* Drop the moves that would leave the mover's king attacked */
+static void filter_legal(const Board* board, MoveList* list) {
+    KingSafety ks;
+    bool have_king = compute_king_safety(board, &ks);
+    Board scratch;
+    if (!have_king) scratch = board_copy(board);
+    
+    /* Filter the pseudo-legal moves in place */
+    int count = 0;
+    for (int i = 0; i < list->count; i++) {
+        Move move = list->moves[i];
+        bool legal = have_king ? move_is_safe(board, &ks, move)
+                               : leaves_king_safe(&scratch, move);
+        if (legal) list->moves[count++] = move;
+    }
+    list->count = count;
+}
+
+void generate_legal_moves(const Board* board, MoveList* list) {
+    generate_pseudo_legal_moves(board, list);
+    filter_legal(board, list);
+}
+
+void generate_captures(const Board* board, MoveList* list) {
+    generate_moves(board, list, GEN_NOISY);
+    filter_legal(board, list);
+}
+
 int count_legal_moves(const Board* board) {
     MoveList list;
     generate_legal_moves(board, &list);
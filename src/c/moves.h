@@ -17,6 +17,34 @@ typedef struct {
     PieceType promotion;  /* PIECE_NONE if no promotion */
 } Move;
 
+/* Packed move for the search's move stacks: from and to as dense cell
+ * indices (cell_to_index) in bits 0-5 and 6-11, the promotion in bits
+ * 12-14. A move never starts and ends on cell 0, so 0 is no move. */
+typedef uint16_t MoveCode;
+
+#define MOVE_CODE_NONE 0
+
+static inline MoveCode move_code_make(int from_index, int to_index, PieceType promotion) {
+    return (MoveCode)(from_index | to_index << 6 | (int)promotion << 12);
+}
+
+static inline int move_code_from(MoveCode code) {
+    return code & 63;
+}
+
+static inline int move_code_to(MoveCode code) {
+    return code >> 6 & 63;
+}
+
+static inline PieceType move_code_promotion(MoveCode code) {
+    return (PieceType)(code >> 12 & 7);
+}
+
+/* Convert to and from Move; an empty move ({0,0} to {0,0}) is
+ * MOVE_CODE_NONE */
+MoveCode move_encode(Move move);
+Move move_decode(MoveCode code);
+
 /* Move list */
 #define MAX_MOVES 256
 
@@ -27,7 +55,14 @@ typedef struct {
 
 /* Move generation */
 void generate_pseudo_legal_moves(const Board* board, MoveList* list);
+
+/* Pseudo-legal captures only, including capturing promotions */
+void generate_pseudo_legal_captures(const Board* board, MoveList* list);
 void generate_legal_moves(const Board* board, MoveList* list);
+
+/* Legal captures and promotions, for the quiescence search. Never
+ * produces a quiet move. */
+void generate_captures(const Board* board, MoveList* list);
 int count_legal_moves(const Board* board);
 
 /* Move validation */
@@ -35,9 +70,38 @@ bool is_move_legal(const Board* board, Move move);
 bool is_in_check(const Board* board, Color color);
 bool is_cell_attacked(const Board* board, Cell target, Color by_color);
 
+/* Everything unmake_move needs to take back a move */
+typedef struct {
+    Piece moved;          /* Mover as it stood on the from square */
+    Piece captured;       /* Previous occupant of the to square */
+    uint8_t captured_slot;  /* Its place in its colour's piece list */
+    Cell white_king;
+    Cell black_king;
+    int half_move_count;
+    int full_move_count;
+    uint64_t hash;        /* Board hash before the move */
+} UndoInfo;
+
 /* Move execution */
 void make_move(Board* board, Move move);
 
+/* Make a move, recording in undo what unmake_move needs to restore it */
+void make_move_with_undo(Board* board, Move move, UndoInfo* undo);
+
+/* Take back a move made by make_move_with_undo */
+void unmake_move(Board* board, Move move, const UndoInfo* undo);
+
+/* Retrograde move generation (for tablebase construction).
+ * Generates every non-capturing move by the side that just moved (the
+ * opponent of board->to_move) that could have produced this position.
+ * Moves are in forward form: from = earlier square, to = current square.
+ * Un-captures and un-promotions change the material and are not
+ * generated. Predecessors are not checked for legality. */
+void generate_unmoves(const Board* board, MoveList* list);
+
+/* Take back a move produced by generate_unmoves */
+void retract_move(Board* board, Move move);
+
 /* Game state checks */
 bool is_checkmate(const Board* board);
 bool is_stalemate(const Board* board);
@@ -52,4 +116,7 @@ void format_move_algebraic(const Board* board, Move move, char* buf, int bufsize
 void movelist_init(MoveList* list);
 void movelist_add(MoveList* list, Move move);
 
+/* Pack the list's moves into out, which needs room for list->count */
+void movelist_encode(const MoveList* list, MoveCode* out);
+
 #endif /* UNDERCHEX_MOVES_H */
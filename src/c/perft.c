@@ -0,0 +1,128 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Perft implementation and the shared perft positions
+ */
+
+#include "perft.h"
+#include <stddef.h>
+
+uint64_t perft(Board* board, int depth) {
+    if (depth == 0) return 1;
+    
+    MoveList moves;
+    generate_legal_moves(board, &moves);
+    
+    /* Bulk-count the last ply */
+    if (depth == 1) return (uint64_t)moves.count;
+    
+    uint64_t nodes = 0;
+    for (int i = 0; i < moves.count; i++) {
+        UndoInfo undo;
+        make_move_with_undo(board, moves.moves[i], &undo);
+        nodes += perft(board, depth - 1);
+        unmake_move(board, moves.moves[i], &undo);
+    }
+    return nodes;
+}
+
+uint64_t perft_divide(Board* board, int depth, MoveList* moves, uint64_t* counts) {
+    generate_legal_moves(board, moves);
+    
+    uint64_t total = 0;
+    for (int i = 0; i < moves->count; i++) {
+        UndoInfo undo;
+        make_move_with_undo(board, moves->moves[i], &undo);
+        counts[i] = (depth > 1) ? perft(board, depth - 1) : 1;
+        unmake_move(board, moves->moves[i], &undo);
+        total += counts[i];
+    }
+    return total;
+}
+
+/* ============================================================================
+ * Positions (keep in sync with spec/tests/perft_validation.json)
+ * ============================================================================ */
+
+typedef struct {
+    PieceType type;
+    Color color;
+    int q, r;
+    uint8_t variant;
+} PerftPiece;
+
+#define W COLOR_WHITE
+#define B COLOR_BLACK
+
+/* spec/starting_position.json */
+static const PerftPiece START[] = {
+    {PIECE_KING, W, 0, 4, 0}, {PIECE_QUEEN, W, 1, 3, 0},
+    {PIECE_CHARIOT, W, -2, 4, 0}, {PIECE_CHARIOT, W, 2, 3, 0},
+    {PIECE_LANCE, W, -1, 4, 0}, {PIECE_LANCE, W, 1, 4, 1},
+    {PIECE_KNIGHT, W, -2, 3, 0}, {PIECE_KNIGHT, W, 2, 4, 0},
+    {PIECE_PAWN, W, -3, 3, 0}, {PIECE_PAWN, W, -2, 2, 0}, {PIECE_PAWN, W, -1, 2, 0},
+    {PIECE_PAWN, W, 0, 2, 0}, {PIECE_PAWN, W, 1, 2, 0}, {PIECE_PAWN, W, 2, 2, 0},
+    {PIECE_KING, B, 0, -4, 0}, {PIECE_QUEEN, B, -1, -3, 0},
+    {PIECE_CHARIOT, B, 2, -4, 0}, {PIECE_CHARIOT, B, -2, -3, 0},
+    {PIECE_LANCE, B, 1, -4, 0}, {PIECE_LANCE, B, -1, -4, 1},
+    {PIECE_KNIGHT, B, 2, -3, 0}, {PIECE_KNIGHT, B, -2, -4, 0},
+    {PIECE_PAWN, B, 3, -3, 0}, {PIECE_PAWN, B, 2, -2, 0}, {PIECE_PAWN, B, 1, -2, 0},
+    {PIECE_PAWN, B, 0, -2, 0}, {PIECE_PAWN, B, -1, -2, 0}, {PIECE_PAWN, B, -2, -2, 0},
+};
+
+/* Open middlegame: pins on both kings' lines, checks and a promotion */
+static const PerftPiece TACTICAL[] = {
+    {PIECE_KING, W, 0, 3, 0}, {PIECE_QUEEN, W, -3, 0, 0}, {PIECE_CHARIOT, W, 2, 0, 0},
+    {PIECE_LANCE, W, 0, 1, 0}, {PIECE_KNIGHT, W, 1, -1, 0},
+    {PIECE_PAWN, W, 1, -3, 0}, {PIECE_PAWN, W, -1, 2, 0},
+    {PIECE_KING, B, -2, -2, 0}, {PIECE_QUEEN, B, 3, -2, 0}, {PIECE_LANCE, B, 0, -2, 1},
+    {PIECE_CHARIOT, B, -3, 1, 0}, {PIECE_KNIGHT, B, 2, 1, 0},
+    {PIECE_PAWN, B, -1, 0, 0}, {PIECE_PAWN, B, 2, -1, 0},
+};
+
+/* Pawns one step from promotion on both sides */
+static const PerftPiece PROMOTION[] = {
+    {PIECE_KING, W, -3, 2, 0}, {PIECE_PAWN, W, 1, -3, 0}, {PIECE_PAWN, W, -2, -2, 0},
+    {PIECE_KING, B, 3, -2, 0}, {PIECE_PAWN, B, -1, 3, 0}, {PIECE_PAWN, B, 2, 1, 0},
+};
+
+/* KQvKL endgame */
+static const PerftPiece ENDGAME[] = {
+    {PIECE_KING, W, 0, 2, 0}, {PIECE_QUEEN, W, 2, -1, 0},
+    {PIECE_KING, B, 0, -3, 0}, {PIECE_LANCE, B, -2, 0, 1},
+};
+
+#undef W
+#undef B
+
+static const struct {
+    const PerftPiece* pieces;
+    int count;
+    Color to_move;
+} SETUPS[] = {
+    {START, sizeof(START) / sizeof(START[0]), COLOR_WHITE},
+    {TACTICAL, sizeof(TACTICAL) / sizeof(TACTICAL[0]), COLOR_WHITE},
+    {PROMOTION, sizeof(PROMOTION) / sizeof(PROMOTION[0]), COLOR_WHITE},
+    {ENDGAME, sizeof(ENDGAME) / sizeof(ENDGAME[0]), COLOR_BLACK},
+};
+
+const PerftPosition PERFT_POSITIONS[] = {
+    {"perft_start", "Starting position from spec/starting_position.json", 6,
+     {16, 256, 4320, 72916, 1296874, 23057838}},
+    {"perft_tactical", "Middlegame with pins, checks and a promotion", 5,
+     {38, 1022, 38757, 1045287, 39292738}},
+    {"perft_promotion", "Pawns about to promote on both sides", 6,
+     {10, 110, 1290, 14222, 189434, 2275579}},
+    {"perft_endgame", "KQvKL, Black to move", 6,
+     {18, 416, 5606, 116147, 1512522, 30347702}},
+};
+
+const int PERFT_POSITION_COUNT = sizeof(PERFT_POSITIONS) / sizeof(PERFT_POSITIONS[0]);
+
+void perft_setup(int index, Board* board) {
+    board_clear(board);
+    for (int i = 0; i < SETUPS[index].count; i++) {
+        const PerftPiece* p = &SETUPS[index].pieces[i];
+        board_set(board, cell_make(p->q, p->r), (Piece){p->type, p->color, p->variant});
+    }
+    board->to_move = SETUPS[index].to_move;
+}
@@ -0,0 +1,38 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Perft: exhaustive move-generator node counts
+ *
+ * perft(board, depth) counts the leaf nodes of the legal move tree, with
+ * each promotion choice a separate move. Counts for the positions in
+ * spec/tests/perft_validation.json must agree across implementations.
+ */
+
+#ifndef UNDERCHEX_PERFT_H
+#define UNDERCHEX_PERFT_H
+
+#include "board.h"
+#include "moves.h"
+#include <stdint.h>
+
+/* Leaf nodes of the legal move tree to the given depth */
+uint64_t perft(Board* board, int depth);
+
+/* Per-move counts for the root's legal moves, as perft(depth - 1) of each
+ * child; returns their sum. counts[i] belongs to moves->moves[i]. */
+uint64_t perft_divide(Board* board, int depth, MoveList* moves, uint64_t* counts);
+
+/* A named position from spec/tests/perft_validation.json */
+typedef struct {
+    const char* id;
+    const char* description;
+    int depth_count;
+    uint64_t nodes[6];        /* Expected perft(1) .. perft(depth_count) */
+} PerftPosition;
+
+extern const PerftPosition PERFT_POSITIONS[];
+extern const int PERFT_POSITION_COUNT;
+
+/* Set up PERFT_POSITIONS[index] */
+void perft_setup(int index, Board* board);
+
+#endif /* UNDERCHEX_PERFT_H */
@@ -0,0 +1,146 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Perft benchmark and move-generator check
+ *
+ * Usage: ./perft [options]
+ * Options:
+ *   -d N    Search to depth N instead of each position's checked depth
+ *   -p ID   Only run the position with this id (e.g. perft_start)
+ *   -D      Divide: print the node count under each root move
+ *   -J      Print one JSON object per line instead of the table
+ *   -h      Show help
+ *
+ * Exits non-zero if any count differs from spec/tests/perft_validation.json.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "perft.h"
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("Options:\n");
+    printf("  -d N    Search to depth N instead of each position's checked depth\n");
+    printf("  -p ID   Only run the position with this id (e.g. perft_start)\n");
+    printf("  -D      Divide: print the node count under each root move\n");
+    printf("  -J      Print one JSON object per line instead of the table\n");
+    printf("  -h      Show this help\n");
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void divide(Board* board, int depth) {
+    MoveList moves;
+    uint64_t counts[MAX_MOVES];
+    uint64_t total = perft_divide(board, depth, &moves, counts);
+    
+    for (int i = 0; i < moves.count; i++) {
+        char move_str[32];
+        format_move(moves.moves[i], move_str, sizeof(move_str));
+        printf("  %-16s %llu\n", move_str, (unsigned long long)counts[i]);
+    }
+    printf("  %d moves, %llu nodes\n", moves.count, (unsigned long long)total);
+}
+
+int main(int argc, char* argv[]) {
+    int depth_override = 0;
+    const char* only = NULL;
+    bool do_divide = false;
+    bool json = false;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "d:p:DJh")) != -1) {
+        switch (opt) {
+            case 'd':
+                depth_override = atoi(optarg);
+                if (depth_override < 1) depth_override = 1;
+                break;
+            case 'p':
+                only = optarg;
+                break;
+            case 'D':
+                do_divide = true;
+                break;
+            case 'J':
+                json = true;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    int failures = 0;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+    
+    for (int i = 0; i < PERFT_POSITION_COUNT; i++) {
+        const PerftPosition* pos = &PERFT_POSITIONS[i];
+        if (only && strcmp(only, pos->id) != 0) continue;
+        
+        int depth = depth_override ? depth_override : pos->depth_count;
+        Board board;
+        perft_setup(i, &board);
+        if (!json || do_divide) printf("%s: %s\n", pos->id, pos->description);
+        
+        if (do_divide) {
+            divide(&board, depth);
+            continue;
+        }
+        
+        for (int d = 1; d <= depth; d++) {
+            double start = now_seconds();
+            uint64_t nodes = perft(&board, d);
+            double elapsed = now_seconds() - start;
+            
+            bool checked = d <= pos->depth_count;
+            bool ok = !checked || nodes == pos->nodes[d - 1];
+            if (!ok) failures++;
+            
+            double mnps = elapsed > 0 ? nodes / elapsed / 1e6 : 0.0;
+            if (json) {
+                printf("{\"position\":\"%s\",\"depth\":%d,\"nodes\":%llu,"
+                       "\"seconds\":%.6f,\"mnps\":%.3f,\"ok\":%s}\n", pos->id, d,
+                       (unsigned long long)nodes, elapsed, mnps,
+                       !checked ? "null" : ok ? "true" : "false");
+            } else {
+                printf("  depth %d: %12llu nodes  %8.3fs  %7.2f Mnps  %s\n", d,
+                       (unsigned long long)nodes, elapsed, mnps,
+                       !checked ? "" : ok ? "ok" : "MISMATCH");
+            }
+            if (d == depth) {
+                total_nodes += nodes;
+                total_time += elapsed;
+            }
+        }
+    }
+    
+    if (!do_divide && total_time > 0) {
+        if (json) {
+            printf("{\"total_nodes\":%llu,\"seconds\":%.6f,\"mnps\":%.3f,\"failures\":%d}\n",
+                   (unsigned long long)total_nodes, total_time,
+                   total_nodes / total_time / 1e6, failures);
+            return failures ? 1 : 0;
+        }
+        printf("Total: %llu nodes in %.3fs, %.2f Mnps\n", (unsigned long long)total_nodes,
+               total_time, total_nodes / total_time / 1e6);
+    }
+    if (failures) {
+        printf("%d count(s) differ from spec/tests/perft_validation.json\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Pondering: searching on the opponent's time
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "ponder.h"
+#include "zobrist.h"
+#include <time.h>
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void ponder_init(Ponder* ponder) {
+    ponder->active = false;
+    ponder->finished = false;
+    atomic_init(&ponder->stop, false);
+    pthread_mutex_init(&ponder->lock, NULL);
+    
+    /* Timed waits are against the same clock as start_ms */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ponder->finished_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void ponder_destroy(Ponder* ponder) {
+    ponder_stop(ponder);
+    pthread_cond_destroy(&ponder->finished_cond);
+    pthread_mutex_destroy(&ponder->lock);
+}
+
+static void* ponder_main(void* arg) {
+    Ponder* ponder = arg;
+    SearchStats stats;
+    Move move = find_best_move_limited(&ponder->board, &ponder->limits, &stats);
+    
+    pthread_mutex_lock(&ponder->lock);
+    ponder->result = move;
+    ponder->stats = stats;
+    ponder->finished = true;
+    pthread_cond_broadcast(&ponder->finished_cond);
+    pthread_mutex_unlock(&ponder->lock);
+    return NULL;
+}
+
+void ponder_start(Ponder* ponder, const Board* board, int max_depth) {
+    ponder_stop(ponder);
+    
+    ponder->root_key = zobrist_key(board);
+    ponder->board = board_copy(board);
+    ponder->predicted = false;
+    
+    Move expected;
+    if (ai_hash_move(board, &expected)) {
+        make_move(&ponder->board, expected);
+        MoveList replies;
+        generate_legal_moves(&ponder->board, &replies);
+        if (replies.count > 0) {
+            ponder->predicted = true;
+            ponder->expected = expected;
+        } else {
+            ponder->board = board_copy(board);
+        }
+    }
+    
+    /* Searching the opponent's position puts the engine's replies a ply
+     * deeper, so it goes one further to reach them at full depth */
+    if (!ponder->predicted && max_depth < AI_MAX_DEPTH) max_depth++;
+    
+    ponder->limits = (SearchLimits){max_depth, -1, &ponder->stop, true, true, NULL, NULL, NULL};
+    ponder->start_ms = now_ms();
+    ponder->finished = false;
+    atomic_store(&ponder->stop, false);
+    ponder->active = pthread_create(&ponder->thread, NULL, ponder_main, ponder) == 0;
+}
+
+void ponder_discard_stale(Ponder* ponder, const Board* board) {
+    if (ponder->active && zobrist_key(board) != ponder->root_key) ponder_stop(ponder);
+}
+
+bool ponder_hit(Ponder* ponder, const Board* board, int time_ms, Move* move,
+                SearchStats* stats) {
+    if (!ponder->active || !ponder->predicted ||
+        zobrist_key(board) != zobrist_key(&ponder->board)) {
+        ponder_stop(ponder);
+        return false;
+    }
+    
+    pthread_mutex_lock(&ponder->lock);
+    if (time_ms > 0) {
+        long long deadline = ponder->start_ms + time_ms;
+        struct timespec until = {deadline / 1000, (deadline % 1000) * 1000000};
+        int waited = 0;
+        while (!ponder->finished && waited == 0) {
+            waited = pthread_cond_timedwait(&ponder->finished_cond, &ponder->lock, &until);
+        }
+    } else {
+        while (!ponder->finished) {
+            pthread_cond_wait(&ponder->finished_cond, &ponder->lock);
+        }
+    }
+    pthread_mutex_unlock(&ponder->lock);
+    
+    ponder_stop(ponder);
+    *move = ponder->result;
+    *stats = ponder->stats;
+    return true;
+}
+
+void ponder_stop(Ponder* ponder) {
+    if (!ponder->active) return;
+    atomic_store(&ponder->stop, true);
+    pthread_join(ponder->thread, NULL);
+    ponder->active = false;
+}
@@ -0,0 +1,68 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Pondering: searching on the opponent's time
+ *
+ * After the engine moves, a background thread keeps searching while the
+ * opponent thinks. If the last search left an expected reply in the
+ * transposition table, it searches the position after that reply, as the
+ * next search would; otherwise it searches the opponent's position, which
+ * fills the table for every reply. When the reply was the expected one
+ * the pondered search is taken over and its time counts towards the move,
+ * so a long think by the opponent leaves the answer ready. Any other
+ * reply stops it, and the next search starts with its table entries.
+ */
+
+#ifndef UNDERCHEX_PONDER_H
+#define UNDERCHEX_PONDER_H
+
+#include "ai.h"
+#include "board.h"
+#include "moves.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    pthread_t thread;
+    bool active;              /* A search thread is running or unjoined */
+    uint64_t root_key;        /* Position the opponent is to move in */
+    bool predicted;           /* Searching after expected, not the root */
+    Move expected;
+    Board board;              /* Position being searched */
+    SearchLimits limits;
+    long long start_ms;
+    atomic_bool stop;
+    
+    pthread_mutex_t lock;     /* Guards the fields below */
+    pthread_cond_t finished_cond;
+    bool finished;
+    Move result;
+    SearchStats stats;
+} Ponder;
+
+void ponder_init(Ponder* ponder);
+
+/* Stop any search and free the ponder's resources */
+void ponder_destroy(Ponder* ponder);
+
+/* Start pondering board, the opponent to move. max_depth is the depth the
+ * engine's own searches go to (AI_MAX_DEPTH when they are timed). Any
+ * previous pondering is stopped first. */
+void ponder_start(Ponder* ponder, const Board* board, int max_depth);
+
+/* Stop pondering unless board is the position it started from */
+void ponder_discard_stale(Ponder* ponder, const Board* board);
+
+/* The engine is to move in board. If the ponder searched exactly this
+ * position, finish its search and return true with its move and stats: a
+ * fixed-depth search (time_ms 0) runs to its depth, and a timed one
+ * until time_ms after pondering began, so it answers at once if the
+ * opponent took longer. Otherwise stop pondering and return false. */
+bool ponder_hit(Ponder* ponder, const Board* board, int time_ms, Move* move,
+                SearchStats* stats);
+
+/* Stop and join the pondering search, if any */
+void ponder_stop(Ponder* ponder);
+
+#endif /* UNDERCHEX_PONDER_H */
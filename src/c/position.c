@@ -0,0 +1,197 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Position serialization (see position.h)
+ */
+
+#include "position.h"
+#include "bitboard.h"
+#include "geometry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Pieces by BitboardKind, and their letters */
+static const Piece KIND_PIECES[BB_KIND_COUNT] = {
+    {PIECE_PAWN, COLOR_WHITE, 0},
+    {PIECE_KNIGHT, COLOR_WHITE, 0},
+    {PIECE_LANCE, COLOR_WHITE, 0},
+    {PIECE_LANCE, COLOR_WHITE, 1},
+    {PIECE_CHARIOT, COLOR_WHITE, 0},
+    {PIECE_QUEEN, COLOR_WHITE, 0},
+    {PIECE_KING, COLOR_WHITE, 0}
+};
+
+static const char KIND_LETTERS[BB_KIND_COUNT] = {'P', 'N', 'A', 'B', 'C', 'Q', 'K'};
+
+static int kind_of_letter(char letter) {
+    for (int kind = 0; kind < BB_KIND_COUNT; kind++) {
+        if (KIND_LETTERS[kind] == letter) return kind;
+    }
+    return -1;
+}
+
+/* Set up board from cells (a kind + 1 per dense index, 8 added for
+ * Black, 0 if empty) and the side to move. Returns false unless each side
+ * has exactly one king, the kings do not touch and the side that has just
+ * moved is not in check. */
+static bool place_pieces(Board* board, const uint8_t cells[NUM_CELLS], Color to_move) {
+    board_clear(board);
+    for (int i = 0; i < NUM_CELLS; i++) {
+        if (cells[i] == 0) continue;
+        Piece piece = KIND_PIECES[(cells[i] & 7) - 1];
+        if (cells[i] & 8) piece.color = COLOR_BLACK;
+        board_set(board, geo_index_cell[i], piece);
+    }
+    board->to_move = to_move;
+    
+    Bitboard white = board->kinds[BB_KING] & board->occupied[COLOR_WHITE - 1];
+    Bitboard black = board->kinds[BB_KING] & board->occupied[COLOR_BLACK - 1];
+    if (bb_popcount(white) != 1 || bb_popcount(black) != 1) return false;
+    if (bb_king_attacks[bb_first(white)] & black) return false;
+    return !is_in_check(board, opponent_color(to_move));
+}
+
+static uint8_t cell_code(const Board* board, int index) {
+    Piece p = board->squares[bb_index_square[index]];
+    if (p.type == PIECE_NONE) return 0;
+    return (uint8_t)((bb_kind(p) + 1) | (p.color == COLOR_BLACK ? 8 : 0));
+}
+
+/* ============================================================================
+ * Text
+ * ============================================================================ */
+
+bool position_from_text(const char* text, Board* board) {
+    uint8_t cells[NUM_CELLS];
+    memset(cells, 0, sizeof(cells));
+    
+    /* Placement: each column must hold exactly its cells */
+    const char* p = text;
+    while (*p == ' ') p++;
+    int index = 0;
+    for (int q = MIN_Q; q <= MAX_Q; q++) {
+        int column_end = index + 2 * BOARD_RADIUS + 1 - abs_int(q);
+        while (index < column_end) {
+            char c = *p++;
+            if (c >= '1' && c <= '9') {
+                index += c - '0';
+                if (index > column_end) return false;
+                continue;
+            }
+            bool black = c >= 'a' && c <= 'z';
+            int kind = kind_of_letter(black ? (char)(c - 'a' + 'A') : c);
+            if (kind < 0) return false;
+            cells[index++] = (uint8_t)((kind + 1) | (black ? 8 : 0));
+        }
+        if (q < MAX_Q && *p++ != '/') return false;
+    }
+    
+    /* Side to move, then the optional counters */
+    char side;
+    int half_move = 0, full_move = 1, consumed = 0;
+    char rest;
+    int fields = sscanf(p, " %c%n %d %d %c", &side, &consumed, &half_move, &full_move, &rest);
+    if (fields < 1 || (side != 'w' && side != 'b') ||
+        (p[consumed] != '\0' && p[consumed] != ' ' && p[consumed] != '\n') ||
+        fields == 2 || fields > 3 || half_move < 0 || full_move < 1 ||
+        half_move > UINT16_MAX || full_move > UINT16_MAX) {
+        return false;
+    }
+    
+    if (!place_pieces(board, cells, side == 'w' ? COLOR_WHITE : COLOR_BLACK)) return false;
+    board->half_move_count = half_move;
+    board->full_move_count = full_move;
+    return true;
+}
+
+int position_to_text(const Board* board, char* buf, int bufsize) {
+    char text[POSITION_TEXT_MAX];
+    int len = 0;
+    int index = 0;
+    for (int q = MIN_Q; q <= MAX_Q; q++) {
+        int column_end = index + 2 * BOARD_RADIUS + 1 - abs_int(q);
+        int empty = 0;
+        for (; index < column_end; index++) {
+            uint8_t code = cell_code(board, index);
+            if (code == 0) {
+                empty++;
+                continue;
+            }
+            if (empty) text[len++] = (char)('0' + empty);
+            empty = 0;
+            char letter = KIND_LETTERS[(code & 7) - 1];
+            text[len++] = (code & 8) ? (char)(letter - 'A' + 'a') : letter;
+        }
+        if (empty) text[len++] = (char)('0' + empty);
+        if (q < MAX_Q) text[len++] = '/';
+    }
+    text[len] = '\0';
+    
+    return snprintf(buf, (size_t)bufsize, "%s %c %d %d", text,
+                    board->to_move == COLOR_BLACK ? 'b' : 'w',
+                    board->half_move_count, board->full_move_count);
+}
+
+/* ============================================================================
+ * Records
+ * ============================================================================ */
+
+#define RECORD_FLAGS 31
+#define RECORD_HALF_MOVE 32
+#define RECORD_FULL_MOVE 34
+#define RECORD_SCORE 36
+#define RECORD_MOVE 40
+#define RECORD_DEPTH 42
+
+static void put16(uint8_t* bytes, unsigned value) {
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+}
+
+static unsigned get16(const uint8_t* bytes) {
+    return bytes[0] | (unsigned)bytes[1] << 8;
+}
+
+void position_pack(const Board* board, PositionRecord* record) {
+    memset(record, 0, sizeof(*record));
+    for (int i = 0; i < NUM_CELLS; i++) {
+        record->bytes[i / 2] |= (uint8_t)(cell_code(board, i) << (4 * (i % 2)));
+    }
+    record->bytes[RECORD_FLAGS] = (uint8_t)board->to_move;
+    put16(&record->bytes[RECORD_HALF_MOVE], (unsigned)board->half_move_count);
+    put16(&record->bytes[RECORD_FULL_MOVE], (unsigned)board->full_move_count);
+}
+
+bool position_unpack(const PositionRecord* record, Board* board) {
+    uint8_t cells[NUM_CELLS];
+    for (int i = 0; i < NUM_CELLS; i++) {
+        cells[i] = (record->bytes[i / 2] >> (4 * (i % 2))) & 15;
+        if ((cells[i] & 7) == 0 && cells[i] != 0) return false;
+    }
+    
+    Color side = (Color)(record->bytes[RECORD_FLAGS] & 3);
+    if (side != COLOR_WHITE && side != COLOR_BLACK) return false;
+    if (!place_pieces(board, cells, side)) return false;
+    board->half_move_count = (int)get16(&record->bytes[RECORD_HALF_MOVE]);
+    board->full_move_count = (int)get16(&record->bytes[RECORD_FULL_MOVE]);
+    return true;
+}
+
+void position_get_label(const PositionRecord* record, PositionLabel* label) {
+    const uint8_t* bytes = record->bytes;
+    label->kind = (AnalysisKind)((bytes[RECORD_FLAGS] >> 2) & 3);
+    uint32_t score = get16(&bytes[RECORD_SCORE]) | (uint32_t)get16(&bytes[RECORD_SCORE + 2]) << 16;
+    label->score = (int32_t)score;
+    label->move = (MoveCode)get16(&bytes[RECORD_MOVE]);
+    label->depth = bytes[RECORD_DEPTH];
+}
+
+void position_set_label(PositionRecord* record, const PositionLabel* label) {
+    uint8_t* bytes = record->bytes;
+    bytes[RECORD_FLAGS] = (uint8_t)((bytes[RECORD_FLAGS] & 3) | (label->kind & 3) << 2);
+    uint32_t score = (uint32_t)label->score;
+    put16(&bytes[RECORD_SCORE], score & 0xFFFF);
+    put16(&bytes[RECORD_SCORE + 2], score >> 16);
+    put16(&bytes[RECORD_MOVE], label->move);
+    bytes[RECORD_DEPTH] = (uint8_t)(label->depth < 0 ? 0 : label->depth > 255 ? 255 : label->depth);
+}
@@ -0,0 +1,86 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Position serialization: text and fixed-size binary records
+ *
+ * The text form is FEN-like. Its fields, separated by spaces, are the
+ * placement, the side to move (w or b) and optionally Board's half-move
+ * and full-move counters (0 and 1 if left out). The placement lists the
+ * columns from q = -BOARD_RADIUS to q = BOARD_RADIUS, separated by '/',
+ * each from its lowest r to its highest: the cells in dense index order.
+ * A piece is its letter, uppercase for White and lowercase for Black:
+ * P, N, C, Q, K, and A or B for a lance of that variant. A digit is that
+ * many empty cells. The starting position is
+ *
+ *   5/6/p3P1A/cp3PCQ/knp3PNK/qcp3PC/a1p3P/6/5 w 0 1
+ *
+ * A record is POSITION_RECORD_BYTES bytes, laid out the same on every host:
+ *
+ *   0..30   the cells, a nibble each in dense index order, low nibble
+ *           first: 0 empty, 1 + BitboardKind for White, 9 + for Black
+ *   31      bits 0-1 the side to move, bits 2-3 the AnalysisKind of the
+ *           label, bits 4-7 zero
+ *   32..33  half-move counter
+ *   34..35  full-move counter
+ *   36..39  label score, from White's point of view (signed)
+ *   40..41  label move, a MoveCode (MOVE_CODE_NONE if none)
+ *   42      label depth: of the search, or the distance to mate of a
+ *           tablebase label
+ *   43      zero
+ *
+ * with the multi-byte fields little-endian, so a file of records can be
+ * read by index and labelled in place.
+ */
+
+#ifndef UNDERCHEX_POSITION_H
+#define UNDERCHEX_POSITION_H
+
+#include "board.h"
+#include "moves.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define POSITION_RECORD_BYTES 44
+
+/* Longest text position, terminator included */
+#define POSITION_TEXT_MAX 128
+
+typedef struct {
+    uint8_t bytes[POSITION_RECORD_BYTES];
+} PositionRecord;
+
+/* What a record's label holds */
+typedef enum {
+    ANALYSIS_NONE = 0,        /* Unlabelled */
+    ANALYSIS_EVAL = 1,        /* evaluate */
+    ANALYSIS_SEARCH = 2,      /* A fixed-depth search: its score and move */
+    ANALYSIS_TABLEBASE = 3    /* The tablebase score, and move if winning */
+} AnalysisKind;
+
+typedef struct {
+    AnalysisKind kind;
+    int score;                /* From White's point of view */
+    MoveCode move;
+    int depth;
+} PositionLabel;
+
+/* Parse a text position. Returns false, leaving board unspecified, if it
+ * is malformed or could not arise in a game: each side needs exactly one
+ * king, the kings may not touch, and the side not to move may not be in
+ * check. */
+bool position_from_text(const char* text, Board* board);
+
+/* board as text. Returns the length written, or that would have been
+ * written, like snprintf. */
+int position_to_text(const Board* board, char* buf, int bufsize);
+
+/* Pack board into an unlabelled record */
+void position_pack(const Board* board, PositionRecord* record);
+
+/* Unpack a record. Returns false if it is not a valid position, as for
+ * position_from_text. */
+bool position_unpack(const PositionRecord* record, Board* board);
+
+void position_get_label(const PositionRecord* record, PositionLabel* label);
+void position_set_label(PositionRecord* record, const PositionLabel* label);
+
+#endif /* UNDERCHEX_POSITION_H */
@@ -0,0 +1,67 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Piece-square table implementation
+ */
+
+#include "psqt.h"
+#include <pthread.h>
+
+int16_t psqt_values[PIECE_KING + 1][3][BOARD_SQUARES];
+
+/* Threads may clear their first boards at the same time */
+static pthread_once_t psqt_once = PTHREAD_ONCE_INIT;
+
+int psqt_piece_value(PieceType type) {
+    switch (type) {
+        case PIECE_PAWN:    return VALUE_PAWN;
+        case PIECE_KNIGHT:  return VALUE_KNIGHT;
+        case PIECE_LANCE:   return VALUE_LANCE;
+        case PIECE_CHARIOT: return VALUE_CHARIOT;
+        case PIECE_QUEEN:   return VALUE_QUEEN;
+        case PIECE_KING:    return VALUE_KING;
+        default:            return 0;
+    }
+}
+
+/* Pawn advancement bonus */
+static int pawn_advancement(Cell c, Color color) {
+    /* White pawns advance toward negative r, black toward positive r */
+    if (color == COLOR_WHITE) {
+        return (BOARD_RADIUS - c.r) * 10;
+    } else {
+        return (BOARD_RADIUS + c.r) * 10;
+    }
+}
+
+static void fill_values(void) {
+    for (int square = 0; square < BOARD_SQUARES; square++) {
+        if (bb_square_index[square] < 0) continue;
+        Cell c = square_cell(square);
+        
+        for (int type = PIECE_PAWN; type <= PIECE_KING; type++) {
+            for (int color = COLOR_WHITE; color <= COLOR_BLACK; color++) {
+                int value = psqt_piece_value((PieceType)type);
+                if (type == PIECE_PAWN) {
+                    value += pawn_advancement(c, (Color)color);
+                } else if (type != PIECE_KING) {
+                    value += psqt_center_bonus(c);
+                }
+                psqt_values[type][color][square] = (int16_t)value;
+            }
+        }
+    }
+}
+
+void psqt_init(void) {
+    pthread_once(&psqt_once, fill_values);
+}
+
+void psqt_compute(const Board* board, int32_t psqt[2]) {
+    psqt[0] = psqt[1] = 0;
+    for (int square = 0; square < BOARD_SQUARES; square++) {
+        Piece p = board->squares[square];
+        if (p.color == COLOR_WHITE || p.color == COLOR_BLACK) {
+            psqt[p.color - 1] += psqt_value(p, square);
+        }
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Material and piece-square values for the incremental evaluation
+ *
+ * Each (piece, square) pair has a fixed value: the piece's material plus
+ * an advancement bonus for pawns or a centralisation bonus for the other
+ * non-king pieces. Board keeps the sum per colour in board->psqt, updated
+ * by board_set and the board_*_piece primitives alongside the hash, so the
+ * evaluator reads it instead of rescanning the board.
+ */
+
+#ifndef UNDERCHEX_PSQT_H
+#define UNDERCHEX_PSQT_H
+
+#include "board.h"
+#include "geometry.h"
+#include <stdint.h>
+
+/* Piece values */
+#define VALUE_PAWN 100
+#define VALUE_KNIGHT 300
+#define VALUE_LANCE 400
+#define VALUE_CHARIOT 400
+#define VALUE_QUEEN 900
+#define VALUE_KING 10000
+
+/* [type][color][square]; zero for empty and off-board squares */
+extern int16_t psqt_values[PIECE_KING + 1][3][BOARD_SQUARES];
+
+/* Fill the table. Called by board_clear; safe to call repeatedly, and
+ * from several threads at once. */
+void psqt_init(void);
+
+/* Material value of a piece type */
+int psqt_piece_value(PieceType type);
+
+/* Bonus for standing near the center, for a cell on the hex */
+static inline int psqt_center_bonus(Cell c) {
+    return (BOARD_RADIUS - geo_center_distance[bb_square_index[cell_square(c)]]) * 5;
+}
+
+/* Value of a piece (not the off-board sentinel) on a mailbox square */
+static inline int psqt_value(Piece piece, int square) {
+    return psqt_values[piece.type][piece.color][square];
+}
+
+/* Per-colour sums recomputed from scratch, for checking board->psqt */
+void psqt_compute(const Board* board, int32_t psqt[2]);
+
+#endif /* UNDERCHEX_PSQT_H */
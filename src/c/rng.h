@@ -0,0 +1,24 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Pseudo-random numbers for keys, openings and book picks
+ *
+ * SplitMix64: the state is a counter advanced by a constant, and each
+ * value a mix of it, so any state (zero included) is a valid seed and the
+ * same seed always gives the same sequence. The caller owns the state;
+ * nothing here is shared between threads.
+ */
+
+#ifndef UNDERCHEX_RNG_H
+#define UNDERCHEX_RNG_H
+
+#include <stdint.h>
+
+/* The next value from *state, which is advanced */
+static inline uint64_t rng_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#endif /* UNDERCHEX_RNG_H */
@@ -0,0 +1,229 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Self-play matches between two engine configurations
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "selfplay.h"
+#include "rng.h"
+#include "tablebase.h"
+#include "zobrist.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Config keys that set a piece value adjustment */
+static const struct {
+    const char* key;
+    PieceType type;
+} PIECE_KEYS[] = {
+    {"pawn", PIECE_PAWN},
+    {"knight", PIECE_KNIGHT},
+    {"lance", PIECE_LANCE},
+    {"chariot", PIECE_CHARIOT},
+    {"queen", PIECE_QUEEN},
+};
+
+static bool set_config_field(PlayerConfig* config, const char* key, int value) {
+    if (strcmp(key, "depth") == 0) {
+        if (value < 1 || value > AI_MAX_DEPTH) return false;
+        config->depth = value;
+    } else if (strcmp(key, "time") == 0) {
+        if (value < 0) return false;
+        config->time_ms = value;
+    } else if (strcmp(key, "mobility") == 0) {
+        config->weights.mobility = value;
+    } else if (strcmp(key, "check") == 0) {
+        config->weights.check_penalty = value;
+    } else {
+        for (size_t i = 0; i < sizeof(PIECE_KEYS) / sizeof(PIECE_KEYS[0]); i++) {
+            if (strcmp(key, PIECE_KEYS[i].key) == 0) {
+                config->weights.piece_adjust[PIECE_KEYS[i].type] = value;
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+bool selfplay_parse_config(const char* spec, PlayerConfig* config) {
+    config->depth = 3;
+    config->time_ms = 0;
+    config->weights = EVAL_DEFAULT_WEIGHTS;
+    
+    const char* p = spec;
+    while (*p) {
+        char key[16];
+        int length = 0;
+        while (*p && *p != '=' && *p != ',') {
+            if (length + 1 >= (int)sizeof(key)) return false;
+            key[length++] = *p++;
+        }
+        key[length] = '\0';
+        if (*p != '=') return false;
+        p++;
+        
+        char* end;
+        long value = strtol(p, &end, 10);
+        if (end == p || (*end && *end != ',')) return false;
+        if (!set_config_field(config, key, (int)value)) return false;
+        p = end;
+        if (*p == ',') p++;
+    }
+    return true;
+}
+
+int selfplay_random_opening(Move* opening, int plies, uint64_t* random_state) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    int count = 0;
+    while (count < plies) {
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        if (moves.count == 0) break;
+        Move move = moves.moves[rng_next(random_state) % (uint64_t)moves.count];
+        opening[count++] = move;
+        make_move(&board, move);
+    }
+    return count;
+}
+
+/* Record a finished game from the side to move's outcome */
+static void finish(SelfplayGame* game, const Board* board, WDLOutcome wdl,
+                   const char* reason) {
+    if (wdl == WDL_WIN) {
+        game->result = board->to_move == COLOR_WHITE ? GAME_WHITE_WINS : GAME_BLACK_WINS;
+    } else if (wdl == WDL_LOSS) {
+        game->result = board->to_move == COLOR_WHITE ? GAME_BLACK_WINS : GAME_WHITE_WINS;
+    } else {
+        game->result = GAME_DRAW;
+    }
+    game->reason = reason;
+}
+
+void selfplay_play_game(const Move* opening, int opening_plies,
+                        const PlayerConfig* white, const PlayerConfig* black,
+                        int max_plies, TranspositionTable tables[2], SelfplayGame* game) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    if (max_plies > SELFPLAY_MAX_PLIES) max_plies = SELFPLAY_MAX_PLIES;
+    game->ply_count = 0;
+    game->nodes[0] = game->nodes[1] = 0;
+    memset(game->stats, 0, sizeof(game->stats));
+    tt_clear(&tables[0]);
+    tt_clear(&tables[1]);
+    long long start = now_ms();
+    
+    /* Position keys of the game so far, for the repetition draw */
+    uint64_t keys[SELFPLAY_MAX_PLIES + 1];
+    keys[0] = zobrist_key(&board);
+    for (int i = 0; i < opening_plies && i < max_plies; i++) {
+        game->moves[game->ply_count++] = opening[i];
+        make_move(&board, opening[i]);
+        keys[game->ply_count] = zobrist_key(&board);
+    }
+    
+    for (;;) {
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        if (moves.count == 0) {
+            if (is_checkmate(&board)) {
+                finish(game, &board, WDL_LOSS, "checkmate");
+            } else {
+                finish(game, &board, WDL_DRAW, "stalemate");
+            }
+            break;
+        }
+        
+        WDLOutcome wdl;
+        int dtm;
+        if (tablebase_probe_wdl(&board, &wdl, &dtm)) {
+            finish(game, &board, wdl, "tablebase");
+            break;
+        }
+        
+        int repeats = 0;
+        for (int i = game->ply_count - 4; i >= 0; i -= 2) {
+            if (keys[i] == keys[game->ply_count]) repeats++;
+        }
+        if (repeats >= 2) {
+            finish(game, &board, WDL_DRAW, "repetition");
+            break;
+        }
+        
+        if (game->ply_count >= max_plies) {
+            finish(game, &board, WDL_DRAW, "move-limit");
+            break;
+        }
+        
+        const PlayerConfig* config = board.to_move == COLOR_WHITE ? white : black;
+        SearchLimits limits = {
+            config->depth,
+            config->time_ms > 0 ? config->time_ms : -1,
+            NULL,
+            true,
+            false,
+            &config->weights,
+            NULL,
+            &tables[board.to_move - 1]
+        };
+        SearchStats stats;
+        Move move = find_best_move_limited(&board, &limits, &stats);
+        game->nodes[board.to_move - 1] += stats.nodes_searched;
+        search_stats_add(&game->stats[board.to_move - 1], &stats);
+        
+        game->moves[game->ply_count++] = move;
+        make_move(&board, move);
+        keys[game->ply_count] = zobrist_key(&board);
+    }
+    
+    game->time_ms = now_ms() - start;
+}
+
+/* Elo difference for an expected score strictly between 0 and 1 */
+static double score_to_elo(double score) {
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+void selfplay_elo(const MatchScore* score, double* elo, double* margin) {
+    int games = score->wins + score->draws + score->losses;
+    if (games == 0) {
+        *elo = 0.0;
+        *margin = 0.0;
+        return;
+    }
+    
+    double mean = (score->wins + 0.5 * score->draws) / games;
+    if (mean <= 0.0 || mean >= 1.0) {
+        *elo = mean <= 0.0 ? -INFINITY : INFINITY;
+        *margin = INFINITY;
+        return;
+    }
+    
+    /* Spread of the per-game score (1, 1/2 or 0), then of its mean */
+    double variance = (score->wins * (1.0 - mean) * (1.0 - mean) +
+                       score->draws * (0.5 - mean) * (0.5 - mean) +
+                       score->losses * mean * mean) / games;
+    double deviation = sqrt(variance / games);
+    double low = mean - 1.96 * deviation;
+    double high = mean + 1.96 * deviation;
+    
+    *elo = score_to_elo(mean);
+    if (low <= 0.0 || high >= 1.0) {
+        *margin = INFINITY;
+    } else {
+        *margin = (score_to_elo(high) - score_to_elo(low)) / 2;
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Self-play matches between two engine configurations
+ *
+ * A match plays games from random openings, each opening once with
+ * either configuration as White, so that neither gains from a lopsided
+ * start. Games end in mate or stalemate, are adjudicated by the tablebase
+ * as soon as a position is in a generated table, and are drawn when a
+ * position occurs for the third time or at the move limit. The result is
+ * an Elo difference with a 95% interval.
+ *
+ * A game between fixed-depth configurations depends only on its opening,
+ * and the openings only on a seed, so a seed and two configurations
+ * reproduce a whole match however many games run at once.
+ */
+
+#ifndef UNDERCHEX_SELFPLAY_H
+#define UNDERCHEX_SELFPLAY_H
+
+#include "ai.h"
+#include "board.h"
+#include "moves.h"
+
+/* Longest game, opening included, before it is adjudicated a draw */
+#define SELFPLAY_MAX_PLIES 400
+
+/* Size of each side's transposition table in a game */
+#define SELFPLAY_TT_MB 1
+
+/* One side of a match */
+typedef struct {
+    int depth;            /* Search depth; the cap of a timed search */
+    int time_ms;          /* Per move, or 0 for a fixed-depth search */
+    EvalWeights weights;
+} PlayerConfig;
+
+/* A PlayerConfig from a spec such as "depth=4,time=50,mobility=3,queen=-20".
+ * Keys: depth, time, mobility, check, and pawn/knight/lance/chariot/queen
+ * for the piece value adjustments. Unset fields keep their defaults
+ * (depth 3, fixed depth, EVAL_DEFAULT_WEIGHTS). */
+bool selfplay_parse_config(const char* spec, PlayerConfig* config);
+
+typedef enum {
+    GAME_DRAW = 0,
+    GAME_WHITE_WINS = 1,
+    GAME_BLACK_WINS = 2
+} GameResult;
+
+/* A finished game, opening included */
+typedef struct {
+    Move moves[SELFPLAY_MAX_PLIES];
+    int ply_count;
+    GameResult result;
+    const char* reason;   /* "checkmate", "stalemate", "tablebase",
+                             "repetition" or "move-limit" */
+    long long nodes[2];   /* Searched by White and Black (index color - 1) */
+    SearchStats stats[2]; /* Their search counters summed over the game */
+    long long time_ms;
+} SelfplayGame;
+
+/* Play the opening, then let the configurations search in turn until the
+ * game ends or reaches max_plies (at most SELFPLAY_MAX_PLIES). The opening
+ * must be legal from the starting position, and the tablebases generated
+ * before games run concurrently. White and Black search tables[0] and
+ * tables[1], which the caller allocates and which are cleared first, so a
+ * game between fixed-depth configurations depends only on its opening.
+ * Safe to call from several threads at once, each with its own tables. */
+void selfplay_play_game(const Move* opening, int opening_plies,
+                        const PlayerConfig* white, const PlayerConfig* black,
+                        int max_plies, TranspositionTable tables[2], SelfplayGame* game);
+
+/* A random opening of up to plies moves, stopping early if the game ends.
+ * The moves are drawn from *random_state, which is advanced, so the same
+ * state always gives the same opening. Returns its length. */
+int selfplay_random_opening(Move* opening, int plies, uint64_t* random_state);
+
+/* Wins, draws and losses of the first configuration */
+typedef struct {
+    int wins;
+    int draws;
+    int losses;
+} MatchScore;
+
+/* Elo difference of the first configuration over the second, and the
+ * half-width of its 95% interval. Both are infinite when every game went
+ * one way; margin is 0 for no games. */
+void selfplay_elo(const MatchScore* score, double* elo, double* margin);
+
+#endif /* UNDERCHEX_SELFPLAY_H */
@@ -0,0 +1,297 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Self-play match runner for tuning (see selfplay.h)
+ *
+ * Usage: ./selfplay [options]
+ * Options:
+ *   -a SPEC   First configuration, e.g. depth=4,mobility=3 (default: depth=3)
+ *   -b SPEC   Second configuration (default: depth=3)
+ *   -n N      Games to play, rounded up to a pair per opening (default: 100)
+ *   -j N      Games played at once (default: one per core)
+ *   -r N      Random plies in each opening (default: 4)
+ *   -m N      Plies before a game is drawn (default: 300)
+ *   -s SEED   Seed of the random openings, to replay a match on the same
+ *             openings (default: from the clock)
+ *   -o FILE   Write the game log to FILE instead of stdout
+ *   -S FILE   Write each game's search statistics to FILE, a JSON line
+ *             per game with the counters of a and of b
+ *   -h        Show help
+ *
+ * Keys of SPEC: depth, time (ms per move, 0 for fixed depth), mobility,
+ * check, pawn, knight, lance, chariot, queen.
+ *
+ * Each game is one log line:
+ *   <game> <a-color> <result> <reason> <plies> <a-nodes> <b-nodes> <ms> <moves...>
+ * with a-color w or b, result 1-0, 1/2 or 0-1, and the moves in engine
+ * notation. The summary lines at the end start with "#", and are also
+ * printed to stdout when the log goes to a file; the first gives the seed.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "engine.h"
+#include "selfplay.h"
+#include "tablebase.h"
+
+#define MAX_WORKERS 256
+
+typedef struct {
+    PlayerConfig configs[2];        /* The two sides, a and b */
+    Move (*openings)[SELFPLAY_MAX_PLIES];
+    int* opening_plies;
+    int game_count;
+    int max_plies;
+    uint64_t seed;                  /* Of the openings */
+    FILE* log;
+    FILE* stats_log;                /* Or NULL */
+    
+    atomic_int next_game;
+    pthread_mutex_t lock;           /* Guards the log and the totals below */
+    MatchScore score;               /* Of configuration a */
+    long long nodes[2];
+    long long moves[2];
+    long long time_ms;
+} Match;
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("Options:\n");
+    printf("  -a SPEC   First configuration, e.g. depth=4,mobility=3 (default: depth=3)\n");
+    printf("  -b SPEC   Second configuration (default: depth=3)\n");
+    printf("  -n N      Games to play, rounded up to a pair per opening (default: 100)\n");
+    printf("  -j N      Games played at once (default: one per core)\n");
+    printf("  -r N      Random plies in each opening (default: 4)\n");
+    printf("  -m N      Plies before a game is drawn (default: 300)\n");
+    printf("  -s SEED   Seed of the random openings (default: from the clock)\n");
+    printf("  -o FILE   Write the game log to FILE instead of stdout\n");
+    printf("  -S FILE   Write each game's search statistics to FILE as JSON\n");
+    printf("  -h        Show this help\n");
+    printf("SPEC keys: depth, time (ms per move, 0 for fixed depth), mobility,\n");
+    printf("  check, pawn, knight, lance, chariot, queen\n");
+}
+
+/* Append a game to the log and the totals */
+static void record(Match* match, int index, int a_side, const SelfplayGame* game) {
+    static const char* RESULTS[] = {"1/2", "1-0", "0-1"};
+    int b_side = 1 - a_side;
+    
+    pthread_mutex_lock(&match->lock);
+    fprintf(match->log, "%d %c %s %s %d %lld %lld %lld", index, a_side == 0 ? 'w' : 'b',
+            RESULTS[game->result], game->reason, game->ply_count,
+            game->nodes[a_side], game->nodes[b_side], game->time_ms);
+    for (int i = 0; i < game->ply_count; i++) {
+        char move[32];
+        engine_format_move(game->moves[i], move, sizeof(move));
+        fprintf(match->log, " %s", move);
+    }
+    fputc('\n', match->log);
+    fflush(match->log);
+    
+    if (match->stats_log) {
+        char a_json[4096], b_json[4096];
+        search_stats_json(&game->stats[a_side], a_json, sizeof(a_json));
+        search_stats_json(&game->stats[b_side], b_json, sizeof(b_json));
+        fprintf(match->stats_log, "{\"game\":%d,\"a_color\":\"%c\",\"a\":%s,\"b\":%s}\n",
+                index, a_side == 0 ? 'w' : 'b', a_json, b_json);
+        fflush(match->stats_log);
+    }
+    
+    if (game->result == GAME_DRAW) {
+        match->score.draws++;
+    } else if ((game->result == GAME_WHITE_WINS) == (a_side == 0)) {
+        match->score.wins++;
+    } else {
+        match->score.losses++;
+    }
+    
+    /* A side's searched moves are the plies after the opening that fell to it */
+    int opening = match->opening_plies[index / 2];
+    if (opening > game->ply_count) opening = game->ply_count;
+    int searched = game->ply_count - opening;
+    int white_moves = (searched + (opening % 2 == 0)) / 2;
+    match->nodes[0] += game->nodes[a_side];
+    match->nodes[1] += game->nodes[b_side];
+    match->moves[0] += a_side == 0 ? white_moves : searched - white_moves;
+    match->moves[1] += a_side == 0 ? searched - white_moves : white_moves;
+    match->time_ms += game->time_ms;
+    pthread_mutex_unlock(&match->lock);
+}
+
+/* Play games until none are left. Game 2k and 2k+1 share opening k, with
+ * configuration a first as White, then as Black. */
+static void* worker_main(void* arg) {
+    Match* match = arg;
+    SelfplayGame* game = malloc(sizeof(SelfplayGame));
+    TranspositionTable tables[2] = {{0}, {0}};
+    if (!game || !tt_init(&tables[0], SELFPLAY_TT_MB) || !tt_init(&tables[1], SELFPLAY_TT_MB)) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    
+    for (;;) {
+        int index = atomic_fetch_add(&match->next_game, 1);
+        if (index >= match->game_count) break;
+        
+        int a_side = index % 2;
+        const PlayerConfig* white = &match->configs[a_side];
+        const PlayerConfig* black = &match->configs[1 - a_side];
+        selfplay_play_game(match->openings[index / 2], match->opening_plies[index / 2],
+                           white, black, match->max_plies, tables, game);
+        record(match, index, a_side, game);
+    }
+    
+    tt_free(&tables[0]);
+    tt_free(&tables[1]);
+    free(game);
+    return NULL;
+}
+
+static void print_side(FILE* out, char name, const char* spec, long long nodes,
+                       long long moves) {
+    fprintf(out, "# %c: %-24s %lld nodes/move\n", name, spec,
+            moves > 0 ? nodes / moves : 0);
+}
+
+static void print_summary(FILE* out, const Match* match, const char* specs[2]) {
+    double elo, margin;
+    selfplay_elo(&match->score, &elo, &margin);
+    fprintf(out, "# seed %" PRIu64 "\n", match->seed);
+    fprintf(out, "# %d games: a %d wins, %d draws, %d losses\n",
+            match->game_count, match->score.wins, match->score.draws, match->score.losses);
+    fprintf(out, "# Elo a - b: %+.1f +/- %.1f (95%%)\n", elo, margin);
+    print_side(out, 'a', specs[0], match->nodes[0], match->moves[0]);
+    print_side(out, 'b', specs[1], match->nodes[1], match->moves[1]);
+    fprintf(out, "# %.1f s of play, %.0f ms per game\n", match->time_ms / 1000.0,
+            (double)match->time_ms / match->game_count);
+}
+
+int main(int argc, char* argv[]) {
+    const char* specs[2] = {"depth=3", "depth=3"};
+    int game_count = 100;
+    int workers = tablebase_default_threads();
+    int random_plies = 4;
+    int max_plies = 300;
+    const char* log_path = NULL;
+    const char* stats_path = NULL;
+    uint64_t seed = (uint64_t)time(NULL);
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "a:b:n:j:r:m:s:o:S:h")) != -1) {
+        switch (opt) {
+            case 'a':
+                specs[0] = optarg;
+                break;
+            case 'b':
+                specs[1] = optarg;
+                break;
+            case 'n':
+                game_count = atoi(optarg);
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            case 'r':
+                random_plies = atoi(optarg);
+                break;
+            case 'm':
+                max_plies = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'o':
+                log_path = optarg;
+                break;
+            case 'S':
+                stats_path = optarg;
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return 1;
+        }
+    }
+    
+    Match match;
+    memset(&match, 0, sizeof(match));
+    for (int side = 0; side < 2; side++) {
+        if (!selfplay_parse_config(specs[side], &match.configs[side])) {
+            fprintf(stderr, "Invalid configuration: %s\n", specs[side]);
+            return 1;
+        }
+    }
+    if (game_count < 1 || random_plies < 0 || max_plies < 1 || max_plies > SELFPLAY_MAX_PLIES) {
+        fprintf(stderr, "Invalid game count or length\n");
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (random_plies > max_plies) random_plies = max_plies;
+    if (workers < 1) workers = 1;
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    
+    match.log = stdout;
+    if (log_path && !(match.log = fopen(log_path, "w"))) {
+        perror(log_path);
+        return 1;
+    }
+    if (stats_path && !(match.stats_log = fopen(stats_path, "w"))) {
+        perror(stats_path);
+        return 1;
+    }
+    
+    int opening_count = (game_count + 1) / 2;
+    match.game_count = opening_count * 2;
+    match.max_plies = max_plies;
+    match.seed = seed;
+    match.openings = malloc(sizeof(*match.openings) * opening_count);
+    match.opening_plies = malloc(sizeof(int) * opening_count);
+    if (!match.openings || !match.opening_plies) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    uint64_t random_state = seed;
+    for (int i = 0; i < opening_count; i++) {
+        match.opening_plies[i] = selfplay_random_opening(match.openings[i], random_plies,
+                                                         &random_state);
+    }
+    
+    /* Every game searches single-threaded; the parallelism is across games,
+     * against tables that are all built before the first one starts */
+    ai_set_threads(1);
+    tablebase_generate_all();
+    atomic_init(&match.next_game, 0);
+    pthread_mutex_init(&match.lock, NULL);
+    
+    pthread_t threads[MAX_WORKERS];
+    int started = 0;
+    for (; started < workers; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, &match) != 0) break;
+    }
+    if (started == 0) worker_main(&match);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    print_summary(match.log, &match, specs);
+    if (match.log != stdout) {
+        fclose(match.log);
+        print_summary(stdout, &match, specs);
+    }
+    if (match.stats_log) fclose(match.stats_log);
+    pthread_mutex_destroy(&match.lock);
+    free(match.openings);
+    free(match.opening_plies);
+    tablebase_cleanup();
+    return 0;
+}
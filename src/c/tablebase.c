@@ -7,11 +7,19 @@
  * Signed-by: agent #36 claude-sonnet-4 via opencode 20260122T09:33:00
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "tablebase.h"
 #include "ai.h"
+#include "geometry.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* ============================================================================
  * Global Tablebase Storage
@@ -20,128 +28,604 @@
 static Tablebase tablebases[TB_CONFIG_COUNT];
 static bool tablebase_system_initialized = false;
 
-/* Configuration names */
+/* Material signature of each configuration, in TablebaseConfigType order.
+ * Every table a capture or promotion can lead to must be listed as well. */
 static const char* CONFIG_NAMES[] = {
     "KvK",
     "KQvK",
     "KLvK",
     "KCvK",
-    "KNvK"
+    "KNvK",
+    "KPvK",
+    "KCCvK",
+    "KQvKL"
 };
 
+_Static_assert(sizeof(CONFIG_NAMES) / sizeof(CONFIG_NAMES[0]) == TB_CONFIG_COUNT,
+               "one signature per tablebase configuration");
+
 /* ============================================================================
- * Hash Function (Simple Zobrist-like)
+ * Packed Entries
  * ============================================================================ */
 
-/* Pseudo-random numbers for Zobrist hashing */
-static uint64_t zobrist_piece[BOARD_SIZE][BOARD_SIZE][7][3];  /* [q][r][piece_type][color] */
-static uint64_t zobrist_side;
-static bool zobrist_initialized = false;
+static TablebaseEntry entry_make(WDLOutcome wdl, int dtm) {
+    if (dtm < 0) dtm = 0;
+    if (dtm > TB_MAX_DTM) dtm = TB_MAX_DTM;
+    return (TablebaseEntry)((dtm << 2) | wdl);
+}
+
+/* ============================================================================
+ * Material Signatures
+ * ============================================================================
+ *
+ * A signature lists the non-king pieces of a configuration in canonical
+ * order: White's pieces before Black's, each side sorted by piece type.
+ * Runs of identical pieces form the groups of the index below.
+ */
 
-static uint64_t simple_random(uint64_t* state) {
-    *state ^= *state << 13;
-    *state ^= *state >> 17;
-    *state ^= *state << 5;
-    return *state;
+static bool signature_slot_before(PieceType type_a, Color color_a,
+                                  PieceType type_b, Color color_b) {
+    if (color_a != color_b) return color_a == COLOR_WHITE;
+    return type_a < type_b;
+}
+
+/* Sort a signature into canonical order, permuting the attached cells and
+ * variants (either may be NULL) along with it */
+static void signature_sort(TablebaseSignature* sig, Cell* cells, uint8_t* variants) {
+    for (int i = 1; i < sig->count; i++) {
+        for (int j = i; j > 0 &&
+             signature_slot_before(sig->types[j], sig->colors[j],
+                                   sig->types[j - 1], sig->colors[j - 1]); j--) {
+            PieceType type = sig->types[j];
+            sig->types[j] = sig->types[j - 1];
+            sig->types[j - 1] = type;
+            
+            Color color = sig->colors[j];
+            sig->colors[j] = sig->colors[j - 1];
+            sig->colors[j - 1] = color;
+            
+            if (cells) {
+                Cell cell = cells[j];
+                cells[j] = cells[j - 1];
+                cells[j - 1] = cell;
+            }
+            if (variants) {
+                uint8_t variant = variants[j];
+                variants[j] = variants[j - 1];
+                variants[j - 1] = variant;
+            }
+        }
+    }
 }
 
-static void init_zobrist(void) {
-    if (zobrist_initialized) return;
+static bool signature_equals(const TablebaseSignature* a, const TablebaseSignature* b) {
+    if (a->count != b->count) return false;
+    for (int i = 0; i < a->count; i++) {
+        if (a->types[i] != b->types[i] || a->colors[i] != b->colors[i]) return false;
+    }
+    return true;
+}
+
+/* The same material with colours exchanged */
+static TablebaseSignature signature_swap(const TablebaseSignature* sig) {
+    TablebaseSignature swapped = *sig;
+    for (int i = 0; i < swapped.count; i++) {
+        swapped.colors[i] = opponent_color(swapped.colors[i]);
+    }
+    signature_sort(&swapped, NULL, NULL);
+    return swapped;
+}
+
+static PieceType piece_from_letter(char c) {
+    switch (c) {
+        case 'P': return PIECE_PAWN;
+        case 'N': return PIECE_KNIGHT;
+        case 'L': return PIECE_LANCE;
+        case 'C': return PIECE_CHARIOT;
+        case 'Q': return PIECE_QUEEN;
+        default:  return PIECE_NONE;
+    }
+}
+
+/* Parse a name such as "KQvKL". Returns false on anything malformed. */
+static bool signature_parse(const char* name, TablebaseSignature* sig) {
+    memset(sig, 0, sizeof(*sig));
+    Color color = COLOR_WHITE;
+    
+    if (*name++ != 'K') return false;
+    for (; *name; name++) {
+        if (*name == 'v' && color == COLOR_WHITE) {
+            if (*++name != 'K') return false;
+            color = COLOR_BLACK;
+            continue;
+        }
+        
+        PieceType type = piece_from_letter(*name);
+        if (type == PIECE_NONE || sig->count == TB_MAX_PIECES) return false;
+        sig->types[sig->count] = type;
+        sig->colors[sig->count] = color;
+        sig->count++;
+    }
+    if (color != COLOR_BLACK) return false;
     
-    uint64_t state = 0x12345678ABCDEF01ULL;
+    signature_sort(sig, NULL, NULL);
+    return true;
+}
+
+/* Find the configuration holding this material, possibly colour-swapped */
+static TablebaseConfigType config_from_signature(const TablebaseSignature* sig, bool* flipped) {
+    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+        if (signature_equals(sig, &tablebases[i].signature)) {
+            *flipped = false;
+            return i;
+        }
+    }
     
-    for (int q = 0; q < BOARD_SIZE; q++) {
-        for (int r = 0; r < BOARD_SIZE; r++) {
-            for (int type = 0; type < 7; type++) {
-                for (int color = 0; color < 3; color++) {
-                    zobrist_piece[q][r][type][color] = simple_random(&state);
+    TablebaseSignature swapped = signature_swap(sig);
+    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+        if (signature_equals(&swapped, &tablebases[i].signature)) {
+            *flipped = true;
+            return i;
+        }
+    }
+    return TB_CONFIG_COUNT;
+}
+
+/* Piece placement of a tablebase position, in signature slot order */
+typedef struct {
+    int wk;
+    int bk;
+    int cells[TB_MAX_PIECES];       /* Cell index per signature slot */
+    uint8_t variants[TB_MAX_PIECES];
+    Color stm;
+} Placement;
+
+/* ============================================================================
+ * Board Symmetry
+ * ============================================================================
+ *
+ * The hexagonal board is invariant under the 12 rotations and reflections
+ * of the hexagon. In cube coordinates (x, y, z) = (q, -q - r, r) each one
+ * permutes the three axes, possibly negating all of them. A configuration
+ * may use the symmetries that map every one of its pieces' move patterns
+ * onto that of a piece of the same kind: all 12 for kings, queens and
+ * knights; the 4 keeping the N-S line for chariots and lances (half of
+ * them turn lance A into lance B); only the identity once a pawn, with its
+ * direction and promotion rank, is involved. Which is which is worked out
+ * once at init by comparing move lists, so new piece kinds need no table.
+ */
+
+#define SYMMETRY_COUNT 12
+
+/* Axis permutations; symmetry s uses PERMUTATIONS[s / 2], negated if odd */
+static const int PERMUTATIONS[6][3] = {
+    {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+};
+
+/* Image of each dense cell index under each symmetry */
+static uint8_t symmetry_cells[SYMMETRY_COUNT][NUM_CELLS];
+
+/* Whether a symmetry preserves each piece kind, and whether it swaps the
+ * two lance variants while doing so */
+static bool symmetry_preserves[SYMMETRY_COUNT][PIECE_KING + 1];
+static bool symmetry_swaps_lances[SYMMETRY_COUNT];
+
+static Cell symmetry_apply(int s, Cell c) {
+    int cube[3] = {c.q, -c.q - c.r, c.r};
+    const int* perm = PERMUTATIONS[s / 2];
+    int sign = (s & 1) ? -1 : 1;
+    return cell_make(sign * cube[perm[0]], sign * cube[perm[2]]);
+}
+
+/* Pseudo-legal moves of a lone piece */
+static void lone_piece_moves(Piece piece, Cell c, MoveList* list) {
+    Board board;
+    board_clear(&board);
+    board_set(&board, c, piece);
+    board.to_move = piece.color;
+    generate_pseudo_legal_moves(&board, list);
+}
+
+static bool move_in_list(const MoveList* list, Move move) {
+    for (int i = 0; i < list->count; i++) {
+        if (cell_equals(list->moves[i].from, move.from) &&
+            cell_equals(list->moves[i].to, move.to) &&
+            list->moves[i].promotion == move.promotion) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Check that symmetry s maps every move of 'from' onto a move of 'to' */
+static bool symmetry_maps_piece(int s, Piece from, Piece to) {
+    for (int i = 0; i < NUM_CELLS; i++) {
+        Cell c = geo_index_cell[i];
+        MoveList moves, images;
+        lone_piece_moves(from, c, &moves);
+        lone_piece_moves(to, symmetry_apply(s, c), &images);
+        if (moves.count != images.count) return false;
+        
+        for (int m = 0; m < moves.count; m++) {
+            Move image = {symmetry_apply(s, moves.moves[m].from),
+                          symmetry_apply(s, moves.moves[m].to),
+                          moves.moves[m].promotion};
+            if (!move_in_list(&images, image)) return false;
+        }
+    }
+    return true;
+}
+
+static void init_symmetries(void) {
+    for (int s = 0; s < SYMMETRY_COUNT; s++) {
+        for (int i = 0; i < NUM_CELLS; i++) {
+            symmetry_cells[s][i] = (uint8_t)cell_to_index(symmetry_apply(s, geo_index_cell[i]));
+        }
+        
+        for (int type = PIECE_PAWN; type <= PIECE_KING; type++) {
+            bool preserved = true;
+            for (int color = COLOR_WHITE; color <= COLOR_BLACK && preserved; color++) {
+                Piece piece = {type, color, 0};
+                if (type == PIECE_LANCE) {
+                    Piece other = {type, color, 1};
+                    symmetry_swaps_lances[s] = !symmetry_maps_piece(s, piece, piece);
+                    if (symmetry_swaps_lances[s]) {
+                        preserved = symmetry_maps_piece(s, piece, other) &&
+                                    symmetry_maps_piece(s, other, piece);
+                    } else {
+                        preserved = symmetry_maps_piece(s, other, other);
+                    }
+                } else {
+                    preserved = symmetry_maps_piece(s, piece, piece);
                 }
             }
+            symmetry_preserves[s][type] = preserved;
+        }
+    }
+}
+
+/* Apply symmetry s to a placement */
+static void placement_transform(const Tablebase* tb, const Placement* p, int s, Placement* out) {
+    out->wk = symmetry_cells[s][p->wk];
+    out->bk = symmetry_cells[s][p->bk];
+    out->stm = p->stm;
+    for (int i = 0; i < tb->signature.count; i++) {
+        out->cells[i] = symmetry_cells[s][p->cells[i]];
+        out->variants[i] = p->variants[i];
+        if (tb->signature.types[i] == PIECE_LANCE && symmetry_swaps_lances[s]) {
+            out->variants[i] ^= 1;
+        }
+    }
+}
+
+/* ============================================================================
+ * Perfect Index Encoding
+ * ============================================================================
+ *
+ * Every position of a configuration maps to a dense index over the
+ * NUM_CELLS valid cells:
+ *
+ *   index = ((wk * N + bk) * R_1 + g_1) * ... * R_n + g_n) * 2 + stm
+ *
+ * The white king only takes one cell per orbit of the configuration's
+ * symmetry group (see Board Symmetry), so wk counts those representative
+ * cells. A position is stored under the smallest index among its images
+ * that put the white king on its representative.
+ *
+ * Each group of identical pieces takes values cell * variants + variant
+ * (variants is 2 for lances, 1 otherwise). A group of k pieces over M
+ * values is ranked as a k-subset in colex order, g = sum C(v_i, i + 1)
+ * over its sorted values, so R = C(M, k) and swapping two identical
+ * pieces gives the same index.
+ *
+ * Overlapping pieces, adjacent kings, pawns on their promotion rank and
+ * positions where the side not to move is in check have slots too; they
+ * simply stay WDL_UNKNOWN. Positions whose material is the colour-swap of
+ * a configuration are looked up flipped: rotating the board by 180
+ * degrees maps every White move pattern (including pawn direction and
+ * lance variants) onto the matching Black one.
+ */
+
+/* Symmetries and groups of identical pieces of a configuration */
+typedef struct {
+    uint16_t symmetries;                /* Bit per usable symmetry */
+    int wk_count;                       /* Representative white king cells */
+    uint8_t wk_cells[NUM_CELLS];        /* Cell of each white king slot */
+    int8_t wk_slots[NUM_CELLS];         /* Slot of each cell, -1 if not a representative */
+    uint16_t wk_canonical[NUM_CELLS];   /* Symmetries taking a cell to its representative */
+    int group_count;
+    int group_start[TB_MAX_PIECES];
+    int group_size[TB_MAX_PIECES];
+    int group_values[TB_MAX_PIECES];
+    uint32_t group_radix[TB_MAX_PIECES];
+} IndexLayout;
+
+static IndexLayout layouts[TB_CONFIG_COUNT];
+
+/* C(n, k) for every n a group value can take */
+#define MAX_GROUP_VALUES (2 * NUM_CELLS)
+static uint32_t binomials[MAX_GROUP_VALUES + 1][TB_MAX_PIECES + 1];
+
+static int piece_variants(PieceType type) {
+    return (type == PIECE_LANCE) ? 2 : 1;
+}
+
+static void init_binomials(void) {
+    for (int n = 0; n <= MAX_GROUP_VALUES; n++) {
+        binomials[n][0] = 1;
+        for (int k = 1; k <= TB_MAX_PIECES; k++) {
+            binomials[n][k] = (n == 0) ? 0 : binomials[n - 1][k - 1] + binomials[n - 1][k];
         }
     }
-    
-    zobrist_side = simple_random(&state);
-    zobrist_initialized = true;
 }
 
-static uint64_t compute_hash(const Board* board) {
-    init_zobrist();
+static void layout_init(const TablebaseSignature* sig, IndexLayout* layout) {
+    memset(layout, 0, sizeof(*layout));
     
-    uint64_t hash = 0;
+    for (int sym = 0; sym < SYMMETRY_COUNT; sym++) {
+        bool usable = symmetry_preserves[sym][PIECE_KING];
+        for (int s = 0; s < sig->count; s++) {
+            usable = usable && symmetry_preserves[sym][sig->types[s]];
+        }
+        if (usable) layout->symmetries |= (uint16_t)(1u << sym);
+    }
     
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell c = cell_make(q, r);
-            if (!cell_is_valid(c)) continue;
-            
-            Piece* p = board_get((Board*)board, c);
-            if (p->type != PIECE_NONE) {
-                int qi = q + BOARD_RADIUS;
-                int ri = r + BOARD_RADIUS;
-                hash ^= zobrist_piece[qi][ri][p->type][p->color];
+    /* The smallest cell of each white king orbit represents it */
+    for (int c = 0; c < NUM_CELLS; c++) {
+        int representative = c;
+        for (int sym = 0; sym < SYMMETRY_COUNT; sym++) {
+            if ((layout->symmetries >> sym & 1) && symmetry_cells[sym][c] < representative) {
+                representative = symmetry_cells[sym][c];
+            }
+        }
+        for (int sym = 0; sym < SYMMETRY_COUNT; sym++) {
+            if ((layout->symmetries >> sym & 1) && symmetry_cells[sym][c] == representative) {
+                layout->wk_canonical[c] |= (uint16_t)(1u << sym);
             }
         }
+        
+        layout->wk_slots[c] = -1;
+        if (representative == c) {
+            layout->wk_slots[c] = (int8_t)layout->wk_count;
+            layout->wk_cells[layout->wk_count++] = (uint8_t)c;
+        }
     }
     
-    if (board->to_move == COLOR_BLACK) {
-        hash ^= zobrist_side;
+    for (int s = 0; s < sig->count; s++) {
+        int g = layout->group_count - 1;
+        if (g >= 0 && sig->types[s] == sig->types[s - 1] && sig->colors[s] == sig->colors[s - 1]) {
+            layout->group_size[g]++;
+        } else {
+            g = layout->group_count++;
+            layout->group_start[g] = s;
+            layout->group_size[g] = 1;
+            layout->group_values[g] = NUM_CELLS * piece_variants(sig->types[s]);
+        }
     }
     
-    return hash;
+    for (int g = 0; g < layout->group_count; g++) {
+        layout->group_radix[g] = binomials[layout->group_values[g]][layout->group_size[g]];
+    }
 }
 
-/* ============================================================================
- * Tablebase Entry Storage (Simple Hash Table)
- * ============================================================================ */
+static uint64_t layout_index_size(const IndexLayout* layout) {
+    uint64_t size = (uint64_t)layout->wk_count * NUM_CELLS * 2;
+    for (int g = 0; g < layout->group_count; g++) {
+        size *= layout->group_radix[g];
+    }
+    return size;
+}
 
-static int find_entry_index(Tablebase* tb, uint64_t hash, Color side) {
-    for (int i = 0; i < tb->size; i++) {
-        if (tb->keys[i].hash == hash && tb->keys[i].side_to_move == side) {
-            return i;
+/* Index of a placement whose white king is on a representative cell */
+static uint32_t placement_raw_index(const Tablebase* tb, const Placement* p) {
+    const IndexLayout* layout = &layouts[tb->config];
+    uint32_t index = (uint32_t)layout->wk_slots[p->wk] * NUM_CELLS + (uint32_t)p->bk;
+    
+    for (int g = 0; g < layout->group_count; g++) {
+        int start = layout->group_start[g];
+        int size = layout->group_size[g];
+        int variants = piece_variants(tb->signature.types[start]);
+        
+        /* Rank the group's values as a sorted subset */
+        int values[TB_MAX_PIECES];
+        for (int i = 0; i < size; i++) {
+            int v = p->cells[start + i] * variants + p->variants[start + i];
+            int j = i;
+            for (; j > 0 && values[j - 1] > v; j--) {
+                values[j] = values[j - 1];
+            }
+            values[j] = v;
         }
+        
+        uint32_t rank = 0;
+        for (int i = 0; i < size; i++) {
+            rank += binomials[values[i]][i + 1];
+        }
+        index = index * layout->group_radix[g] + rank;
     }
-    return -1;
+    return index * 2 + (p->stm == COLOR_BLACK ? 1 : 0);
 }
 
-static bool add_entry(Tablebase* tb, uint64_t hash, Color side, TablebaseEntry* entry) {
-    if (tb->size >= tb->capacity) {
-        return false;
+/* Canonical index of any placement */
+static uint32_t placement_to_index(const Tablebase* tb, const Placement* p) {
+    uint16_t candidates = layouts[tb->config].wk_canonical[p->wk];
+    uint32_t best = UINT32_MAX;
+    
+    for (int sym = 0; candidates; sym++, candidates >>= 1) {
+        if (!(candidates & 1)) continue;
+        
+        Placement image;
+        placement_transform(tb, p, sym, &image);
+        uint32_t index = placement_raw_index(tb, &image);
+        if (index < best) best = index;
     }
+    return best;
+}
+
+static void index_to_placement(const Tablebase* tb, uint32_t index, Placement* p) {
+    const IndexLayout* layout = &layouts[tb->config];
     
-    /* Check if already exists */
-    int idx = find_entry_index(tb, hash, side);
-    if (idx >= 0) {
-        tb->entries[idx] = *entry;
-        return true;
+    p->stm = (index & 1) ? COLOR_BLACK : COLOR_WHITE;
+    index >>= 1;
+    
+    for (int g = layout->group_count - 1; g >= 0; g--) {
+        int start = layout->group_start[g];
+        int variants = piece_variants(tb->signature.types[start]);
+        uint32_t rank = index % layout->group_radix[g];
+        index /= layout->group_radix[g];
+        
+        /* Unrank from the largest value down */
+        int v = layout->group_values[g];
+        for (int i = layout->group_size[g] - 1; i >= 0; i--) {
+            if (i == 0) {
+                v = (int)rank;
+            } else {
+                do { v--; } while (binomials[v][i + 1] > rank);
+                rank -= binomials[v][i + 1];
+            }
+            p->cells[start + i] = v / variants;
+            p->variants[start + i] = (uint8_t)(v % variants);
+        }
     }
     
-    /* Add new entry */
-    tb->keys[tb->size].hash = hash;
-    tb->keys[tb->size].side_to_move = side;
-    tb->entries[tb->size] = *entry;
-    tb->size++;
+    p->bk = (int)(index % NUM_CELLS);
+    p->wk = layout->wk_cells[index / NUM_CELLS];
+}
+
+/* ============================================================================
+ * Material Detection
+ * ============================================================================ */
+
+/* Summary of the pieces on a board, gathered in one pass */
+typedef struct {
+    TablebaseSignature material;     /* Non-king pieces, canonical order */
+    Cell cells[TB_MAX_PIECES];
+    uint8_t variants[TB_MAX_PIECES];
+    bool too_many;                   /* More pieces than any table holds */
+    Cell white_king;
+    Cell black_king;
+    bool has_white_king;
+    bool has_black_king;
+} MaterialScan;
+
+static void scan_material(const Board* board, MaterialScan* scan) {
+    memset(scan, 0, sizeof(*scan));
     
-    return true;
+    for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < board->piece_count[side]; i++) {
+            int square = board->pieces[side][i];
+            Cell c = square_cell(square);
+            Piece p = board->squares[square];
+            
+            if (p.type == PIECE_KING) {
+                if (p.color == COLOR_WHITE) {
+                    scan->white_king = c;
+                    scan->has_white_king = true;
+                } else {
+                    scan->black_king = c;
+                    scan->has_black_king = true;
+                }
+            } else if (scan->material.count == TB_MAX_PIECES) {
+                scan->too_many = true;
+            } else {
+                int slot = scan->material.count++;
+                scan->material.types[slot] = p.type;
+                scan->material.colors[slot] = p.color;
+                scan->cells[slot] = c;
+                scan->variants[slot] = p.variant;
+            }
+        }
+    }
+    
+    signature_sort(&scan->material, scan->cells, scan->variants);
+}
+
+static TablebaseConfigType config_from_scan(const MaterialScan* scan, bool* flipped) {
+    *flipped = false;
+    if (scan->too_many) return TB_CONFIG_COUNT;
+    return config_from_signature(&scan->material, flipped);
+}
+
+/* Rotate a cell by 180 degrees */
+static Cell cell_rotate(Cell c) {
+    return cell_make(-c.q, -c.r);
 }
 
-static TablebaseEntry* get_entry(Tablebase* tb, uint64_t hash, Color side) {
-    int idx = find_entry_index(tb, hash, side);
-    if (idx >= 0) {
-        return &tb->entries[idx];
+static bool placement_from_scan(const Tablebase* tb, const MaterialScan* scan, bool flipped,
+                                Color to_move, Placement* out) {
+    if (!scan->has_white_king || !scan->has_black_king) return false;
+    
+    Color colors[TB_MAX_PIECES];
+    Cell cells[TB_MAX_PIECES];
+    bool used[TB_MAX_PIECES] = {false};
+    int count = scan->material.count;
+    
+    if (flipped) {
+        /* Colour-flip into the orientation the table is stored in */
+        out->wk = cell_to_index(cell_rotate(scan->black_king));
+        out->bk = cell_to_index(cell_rotate(scan->white_king));
+        out->stm = opponent_color(to_move);
+        for (int i = 0; i < count; i++) {
+            colors[i] = opponent_color(scan->material.colors[i]);
+            cells[i] = cell_rotate(scan->cells[i]);
+        }
+    } else {
+        out->wk = cell_to_index(scan->white_king);
+        out->bk = cell_to_index(scan->black_king);
+        out->stm = to_move;
+        for (int i = 0; i < count; i++) {
+            colors[i] = scan->material.colors[i];
+            cells[i] = scan->cells[i];
+        }
     }
-    return NULL;
+    
+    /* Fill each signature slot with a matching piece */
+    for (int s = 0; s < tb->signature.count; s++) {
+        int i = 0;
+        while (used[i] || scan->material.types[i] != tb->signature.types[s] ||
+               colors[i] != tb->signature.colors[s]) {
+            i++;
+        }
+        used[i] = true;
+        out->cells[s] = cell_to_index(cells[i]);
+        out->variants[s] = scan->variants[i];
+    }
+    return true;
 }
 
 /* ============================================================================
  * Position Generation
  * ============================================================================ */
 
-/* Check if kings are too close (adjacent) */
-static bool kings_adjacent(Cell wk, Cell bk) {
-    int dq = abs_int(wk.q - bk.q);
-    int dr = abs_int(wk.r - bk.r);
-    int ds = abs_int((-wk.q - wk.r) - (-bk.q - bk.r));
-    return max3_int(dq, dr, ds) <= 1;
+/* Check that pieces are on distinct cells, kings are not adjacent and no
+ * pawn stands on its promotion rank */
+static bool placement_possible(const Tablebase* tb, const Placement* p) {
+    if (p->wk == p->bk) return false;
+    
+    for (int s = 0; s < tb->signature.count; s++) {
+        int cell = p->cells[s];
+        if (cell == p->wk || cell == p->bk) return false;
+        for (int t = 0; t < s; t++) {
+            if (p->cells[t] == cell) return false;
+        }
+        
+        if (tb->signature.types[s] == PIECE_PAWN &&
+            (geo_promotion_mask[tb->signature.colors[s] - 1] & BB_CELL(cell))) {
+            return false;
+        }
+    }
+    return !(bb_king_attacks[p->wk] & BB_CELL(p->bk));
+}
+
+static void placement_to_board(const Tablebase* tb, const Placement* p, Board* board) {
+    board_clear(board);
+    board_set(board, geo_index_cell[p->wk], (Piece){PIECE_KING, COLOR_WHITE, 0});
+    board_set(board, geo_index_cell[p->bk], (Piece){PIECE_KING, COLOR_BLACK, 0});
+    for (int s = 0; s < tb->signature.count; s++) {
+        board_set(board, geo_index_cell[p->cells[s]],
+                  (Piece){tb->signature.types[s], tb->signature.colors[s], p->variants[s]});
+    }
+    board->to_move = p->stm;
 }
 
 /* Check if position is illegal (opponent in check with it being our turn) */
@@ -150,265 +634,548 @@ static bool is_illegal_position(const Board* board) {
     return is_in_check(board, opponent);
 }
 
-/* Get terminal outcome (checkmate/stalemate) */
-static bool get_terminal_outcome(const Board* board, WDLOutcome* wdl, int* dtm) {
+/* Make sure a table is available, generating it if it is small enough
+ * to build on demand */
+static bool ensure_table(Tablebase* tb) {
+    if (tb->generated) return true;
+    if (tb->index_size > TB_ON_DEMAND_SIZE) return false;
+    return tablebase_generate(tb->config);
+}
+
+/* Look up the entry for any supported position. Tables other than the
+ * one being generated are built on demand, as in tablebase_probe. */
+static bool lookup_entry(const Board* board, TablebaseEntry* out) {
+    MaterialScan scan;
+    scan_material(board, &scan);
+    
+    bool flipped;
+    TablebaseConfigType config = config_from_scan(&scan, &flipped);
+    if (config == TB_CONFIG_COUNT) return false;
+    
+    Tablebase* tb = &tablebases[config];
+    if (!tb->entries && !ensure_table(tb)) return false;
+    
+    Placement p;
+    if (!placement_from_scan(tb, &scan, flipped, board->to_move, &p)) return false;
+    
+    *out = tb->entries[placement_to_index(tb, &p)];
+    return TB_ENTRY_WDL(*out) != WDL_UNKNOWN;
+}
+
+/* ============================================================================
+ * Retrograde Analysis
+ * ============================================================================
+ *
+ * Positions are resolved backwards from the checkmates:
+ *
+ * 1. Every legal position is visited once. Terminals are scored, and each
+ *    other position gets a counter of its moves that stay in the table.
+ *    Moves that leave it (captures, promotions) are resolved immediately
+ *    by probing the smaller table they lead to.
+ * 2. Resolved positions are processed in increasing DTM order. For each
+ *    predecessor (from generate_unmoves): a lost position makes it a win
+ *    in DTM + 1; a won position decrements its counter, and when the
+ *    counter reaches zero every move loses, in DTM + 1 of the slowest.
+ * 3. Whatever is left unresolved is a draw.
+ *
+ * While a position is unresolved its entry's DTM field holds the longest
+ * DTM among opponent wins reached by leaving the table.
+ *
+ * Both phases are split across worker threads: phase 1 by index range,
+ * phase 2 by slices of the current DTM level. Each worker queues what it
+ * resolves into its own DtmQueue. Predecessor updates may race between
+ * workers, so entries change by compare-and-swap and counters by atomic
+ * decrement; whichever worker makes the change queues the position.
+ */
+
+/* Per-position retrograde state: count of unresolved in-table moves */
+#define RETRO_DONE 0xFF         /* Not pending: impossible, illegal or terminal */
+#define RETRO_NO_LOSS 0x80      /* A move leaves the table without losing */
+#define RETRO_COUNT_MASK 0x7F
+
+/* Positions handed to a phase 1 worker at a time */
+#define RETRO_CHUNK 4096
+
+static inline TablebaseEntry entry_load(const TablebaseEntry* entry) {
+    return __atomic_load_n(entry, __ATOMIC_RELAXED);
+}
+
+static inline bool entry_replace(TablebaseEntry* entry, TablebaseEntry* expected,
+                                 TablebaseEntry desired) {
+    return __atomic_compare_exchange_n(entry, expected, desired, false,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/* FIFO of indices resolved at one DTM */
+typedef struct {
+    uint32_t* items;
+    uint32_t count;
+    uint32_t capacity;
+} IndexQueue;
+
+/* Queues for every DTM seen so far */
+typedef struct {
+    IndexQueue* levels;
+    int level_count;
+} DtmQueue;
+
+static bool dtm_queue_push(DtmQueue* queue, int dtm, uint32_t idx) {
+    if (dtm >= queue->level_count) {
+        int new_count = queue->level_count ? queue->level_count : 16;
+        while (new_count <= dtm) new_count *= 2;
+        
+        IndexQueue* levels = realloc(queue->levels, sizeof(IndexQueue) * new_count);
+        if (!levels) return false;
+        memset(levels + queue->level_count, 0,
+               sizeof(IndexQueue) * (new_count - queue->level_count));
+        queue->levels = levels;
+        queue->level_count = new_count;
+    }
+    
+    IndexQueue* level = &queue->levels[dtm];
+    if (level->count == level->capacity) {
+        uint32_t new_capacity = level->capacity ? level->capacity * 2 : 1024;
+        uint32_t* items = realloc(level->items, sizeof(uint32_t) * new_capacity);
+        if (!items) return false;
+        level->items = items;
+        level->capacity = new_capacity;
+    }
+    level->items[level->count++] = idx;
+    return true;
+}
+
+static void dtm_queue_free(DtmQueue* queue) {
+    for (int i = 0; i < queue->level_count; i++) {
+        free(queue->levels[i].items);
+    }
+    free(queue->levels);
+    queue->levels = NULL;
+    queue->level_count = 0;
+}
+
+/* Move whatever stands on 'from' to 'to' and pass the turn */
+static void placement_move(Placement* p, Cell from_cell, Cell to_cell) {
+    int from = cell_to_index(from_cell);
+    int to = cell_to_index(to_cell);
+    
+    if (p->wk == from) {
+        p->wk = to;
+    } else if (p->bk == from) {
+        p->bk = to;
+    } else {
+        for (int s = 0; s < TB_MAX_PIECES; s++) {
+            if (p->cells[s] == from) {
+                p->cells[s] = to;
+                break;
+            }
+        }
+    }
+    p->stm = opponent_color(p->stm);
+}
+
+/* Add an index to a small set; returns false if it was already there */
+static bool index_set_add(uint32_t* set, int* count, uint32_t idx) {
+    for (int i = 0; i < *count; i++) {
+        if (set[i] == idx) return false;
+    }
+    set[(*count)++] = idx;
+    return true;
+}
+
+/* Phase 1 for one position: score terminals, count in-table moves and
+ * resolve the moves that leave the table */
+static bool retro_classify(Tablebase* tb, uint32_t idx, uint8_t* remaining, DtmQueue* queue) {
+    remaining[idx] = RETRO_DONE;
+    
+    Placement p;
+    index_to_placement(tb, idx, &p);
+    if (!placement_possible(tb, &p)) return true;
+    
+    /* Symmetric images of a position are stored once */
+    if (placement_to_index(tb, &p) != idx) return true;
+    
+    Board board;
+    placement_to_board(tb, &p, &board);
+    if (is_illegal_position(&board)) return true;
+    
     MoveList moves;
-    generate_legal_moves(board, &moves);
+    generate_legal_moves(&board, &moves);
     
     if (moves.count == 0) {
-        if (is_in_check(board, board->to_move)) {
-            /* Checkmate - side to move loses */
-            *wdl = WDL_LOSS;
-            *dtm = 0;
-        } else {
-            /* Stalemate - draw */
-            *wdl = WDL_DRAW;
-            *dtm = -1;
+        if (is_in_check(&board, board.to_move)) {
+            tb->entries[idx] = entry_make(WDL_LOSS, 0);
+            return dtm_queue_push(queue, 0, idx);
         }
+        tb->entries[idx] = entry_make(WDL_DRAW, -1);
         return true;
     }
     
-    return false;
+    /* In-table moves are counted by distinct canonical successor: two
+     * moves into symmetric positions are resolved by one propagation */
+    uint32_t children[MAX_MOVES];
+    int count = 0;
+    uint8_t flags = 0;
+    int exit_win_dtm = -1;
+    int exit_loss_dtm = 0;
+    
+    for (int m = 0; m < moves.count; m++) {
+        Move move = moves.moves[m];
+        bool capture = board_get(&board, move.to)->type != PIECE_NONE;
+        
+        if (!capture && move.promotion == PIECE_NONE) {
+            Placement child = p;
+            placement_move(&child, move.from, move.to);
+            index_set_add(children, &count, placement_to_index(tb, &child));
+            continue;
+        }
+        
+        UndoInfo undo;
+        make_move_with_undo(&board, move, &undo);
+        TablebaseEntry child;
+        bool found = lookup_entry(&board, &child);
+        unmake_move(&board, move, &undo);
+        
+        if (!found || TB_ENTRY_WDL(child) == WDL_DRAW) {
+            flags |= RETRO_NO_LOSS;
+        } else if (TB_ENTRY_WDL(child) == WDL_LOSS) {
+            int dtm = TB_ENTRY_DTM(child) + 1;
+            if (exit_win_dtm < 0 || dtm < exit_win_dtm) exit_win_dtm = dtm;
+        } else if (TB_ENTRY_DTM(child) > exit_loss_dtm) {
+            exit_loss_dtm = TB_ENTRY_DTM(child);
+        }
+    }
+    
+    if (count > RETRO_COUNT_MASK) return false;
+    remaining[idx] = (uint8_t)(count | flags);
+    
+    if (exit_win_dtm >= 0) {
+        /* Winning already; a faster in-table win may still lower the DTM */
+        tb->entries[idx] = entry_make(WDL_WIN, exit_win_dtm);
+        return dtm_queue_push(queue, exit_win_dtm, idx);
+    }
+    if (count == 0 && !(flags & RETRO_NO_LOSS)) {
+        tb->entries[idx] = entry_make(WDL_LOSS, exit_loss_dtm + 1);
+        return dtm_queue_push(queue, exit_loss_dtm + 1, idx);
+    }
+    tb->entries[idx] = entry_make(WDL_UNKNOWN, exit_loss_dtm);
+    return true;
 }
 
-/* Generate all valid cells */
-static int get_all_cells(Cell* cells) {
-    int count = 0;
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell c = cell_make(q, r);
-            if (cell_is_valid(c)) {
-                cells[count++] = c;
+/* Phase 2 for one resolved position: update all of its predecessors */
+static bool retro_propagate(Tablebase* tb, uint32_t idx, int dtm,
+                            uint8_t* remaining, DtmQueue* queue) {
+    WDLOutcome wdl = TB_ENTRY_WDL(entry_load(&tb->entries[idx]));
+    
+    Placement p;
+    index_to_placement(tb, idx, &p);
+    
+    Board board;
+    placement_to_board(tb, &p, &board);
+    
+    MoveList unmoves;
+    generate_unmoves(&board, &unmoves);
+    
+    uint32_t seen[MAX_MOVES];
+    int seen_count = 0;
+    
+    for (int m = 0; m < unmoves.count; m++) {
+        Placement prev = p;
+        placement_move(&prev, unmoves.moves[m].to, unmoves.moves[m].from);
+        uint32_t prev_idx = placement_to_index(tb, &prev);
+        
+        /* Set in phase 1 and never changed afterwards */
+        if (remaining[prev_idx] == RETRO_DONE) continue;
+        
+        /* Symmetric predecessors are the same stored position */
+        if (!index_set_add(seen, &seen_count, prev_idx)) continue;
+        
+        TablebaseEntry* prev_entry = &tb->entries[prev_idx];
+        TablebaseEntry current = entry_load(prev_entry);
+        
+        if (wdl == WDL_LOSS) {
+            /* The predecessor can move into this lost position */
+            TablebaseEntry win = entry_make(WDL_WIN, dtm + 1);
+            while (TB_ENTRY_WDL(current) == WDL_UNKNOWN ||
+                   (TB_ENTRY_WDL(current) == WDL_WIN && TB_ENTRY_DTM(current) > dtm + 1)) {
+                if (entry_replace(prev_entry, &current, win)) {
+                    if (!dtm_queue_push(queue, dtm + 1, prev_idx)) return false;
+                    break;
+                }
+            }
+        } else if (TB_ENTRY_WDL(current) == WDL_UNKNOWN) {
+            /* One more of the predecessor's moves is known to lose. A
+             * predecessor with a losing move never reaches zero, so a
+             * concurrent win cannot race with the loss below. */
+            uint8_t state = __atomic_sub_fetch(&remaining[prev_idx], 1, __ATOMIC_RELAXED);
+            
+            if (state == 0) {
+                int loss_dtm = max_int(TB_ENTRY_DTM(current), dtm) + 1;
+                __atomic_store_n(prev_entry, entry_make(WDL_LOSS, loss_dtm), __ATOMIC_RELAXED);
+                if (!dtm_queue_push(queue, loss_dtm, prev_idx)) return false;
             }
         }
     }
-    return count;
+    return true;
 }
 
-/* ============================================================================
- * Retrograde Analysis
- * ============================================================================ */
+/* Shared state of one table's generation */
+typedef struct {
+    Tablebase* tb;
+    uint8_t* remaining;
+    int num_threads;
+    DtmQueue* queues;          /* One per worker */
+    uint32_t next_index;       /* Phase 1: next chunk to hand out */
+    uint32_t* level;           /* Phase 2: positions resolved at 'dtm' */
+    uint32_t level_count;
+    int dtm;
+    bool failed;
+} RetroJob;
+
+typedef struct {
+    RetroJob* job;
+    int id;
+} RetroWorker;
 
-/* Generate KvK tablebase */
-static void generate_KvK(Tablebase* tb) {
-    Cell all_cells[BOARD_SIZE * BOARD_SIZE];
-    int cell_count = get_all_cells(all_cells);
+static void* classify_worker(void* arg) {
+    RetroWorker* worker = arg;
+    RetroJob* job = worker->job;
+    DtmQueue* queue = &job->queues[worker->id];
     
-    /* Enumerate all king positions */
-    for (int wi = 0; wi < cell_count; wi++) {
-        Cell wk = all_cells[wi];
+    for (;;) {
+        uint32_t start = __atomic_fetch_add(&job->next_index, RETRO_CHUNK, __ATOMIC_RELAXED);
+        if (start >= job->tb->index_size) break;
         
-        for (int bi = 0; bi < cell_count; bi++) {
-            Cell bk = all_cells[bi];
-            
-            /* Kings can't be on same cell or adjacent */
-            if (cell_equals(wk, bk)) continue;
-            if (kings_adjacent(wk, bk)) continue;
-            
-            /* Create position */
-            Board board;
-            board_clear(&board);
-            board_set(&board, wk, (Piece){PIECE_KING, COLOR_WHITE, 0});
-            board_set(&board, bk, (Piece){PIECE_KING, COLOR_BLACK, 0});
-            board.white_king = wk;
-            board.black_king = bk;
-            
-            /* Both sides to move */
-            for (int stm = COLOR_WHITE; stm <= COLOR_BLACK; stm++) {
-                board.to_move = stm;
-                
-                if (is_illegal_position(&board)) continue;
-                
-                uint64_t hash = compute_hash(&board);
-                
-                WDLOutcome wdl;
-                int dtm;
-                
-                /* KvK is always draw (no mating material) */
-                if (get_terminal_outcome(&board, &wdl, &dtm)) {
-                    /* Terminal - stalemate = draw */
-                } else {
-                    /* Non-terminal KvK = draw */
-                    wdl = WDL_DRAW;
-                    dtm = -1;
-                }
-                
-                TablebaseEntry entry = {wdl, dtm, {0, 0}, {0, 0}, PIECE_NONE};
-                add_entry(tb, hash, stm, &entry);
-                
-                if (wdl == WDL_WIN) tb->win_count++;
-                else if (wdl == WDL_DRAW) tb->draw_count++;
-                else if (wdl == WDL_LOSS) tb->loss_count++;
+        uint32_t end = start + RETRO_CHUNK;
+        if (end > job->tb->index_size) end = job->tb->index_size;
+        
+        for (uint32_t idx = start; idx < end; idx++) {
+            if (!retro_classify(job->tb, idx, job->remaining, queue)) {
+                job->failed = true;
+                return NULL;
             }
         }
     }
+    return NULL;
+}
+
+static void* propagate_worker(void* arg) {
+    RetroWorker* worker = arg;
+    RetroJob* job = worker->job;
+    DtmQueue* queue = &job->queues[worker->id];
+    
+    for (uint32_t i = worker->id; i < job->level_count; i += job->num_threads) {
+        uint32_t idx = job->level[i];
+        
+        /* Skip wins whose DTM was lowered after being queued */
+        if (TB_ENTRY_DTM(entry_load(&job->tb->entries[idx])) != job->dtm) continue;
+        
+        if (!retro_propagate(job->tb, idx, job->dtm, job->remaining, queue)) {
+            job->failed = true;
+            return NULL;
+        }
+    }
+    return NULL;
 }
 
-/* Generate tablebase for K+Piece vs K */
-static void generate_KPvK(Tablebase* tb, PieceType piece_type) {
-    Cell all_cells[BOARD_SIZE * BOARD_SIZE];
-    int cell_count = get_all_cells(all_cells);
+/* Run fn on every worker; worker 0 runs on the calling thread */
+static void run_workers(RetroJob* job, void* (*fn)(void*)) {
+    pthread_t threads[TB_MAX_THREADS];
+    RetroWorker workers[TB_MAX_THREADS];
+    int started = 1;
     
-    /* Track unknown positions for retrograde analysis */
-    typedef struct {
-        Board board;
-        uint64_t hash;
-        Color stm;
-    } Position;
+    for (int i = 0; i < job->num_threads; i++) {
+        workers[i].job = job;
+        workers[i].id = i;
+    }
+    for (int i = 1; i < job->num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, fn, &workers[i]) != 0) break;
+        started++;
+    }
     
-    Position* unknown = malloc(sizeof(Position) * MAX_TABLEBASE_SIZE);
-    int unknown_count = 0;
+    fn(&workers[0]);
     
-    /* Phase 1: Enumerate all positions, find terminals */
-    for (int wi = 0; wi < cell_count; wi++) {
-        Cell wk = all_cells[wi];
-        
-        for (int bi = 0; bi < cell_count; bi++) {
-            Cell bk = all_cells[bi];
-            
-            if (cell_equals(wk, bk)) continue;
-            if (kings_adjacent(wk, bk)) continue;
-            
-            for (int pi = 0; pi < cell_count; pi++) {
-                Cell pc = all_cells[pi];
-                
-                /* Piece can't be on king squares */
-                if (cell_equals(pc, wk) || cell_equals(pc, bk)) continue;
-                
-                /* Handle lance variants */
-                int num_variants = (piece_type == PIECE_LANCE) ? 2 : 1;
-                
-                for (int var = 0; var < num_variants; var++) {
-                    /* Create position */
-                    Board board;
-                    board_clear(&board);
-                    board_set(&board, wk, (Piece){PIECE_KING, COLOR_WHITE, 0});
-                    board_set(&board, bk, (Piece){PIECE_KING, COLOR_BLACK, 0});
-                    board_set(&board, pc, (Piece){piece_type, COLOR_WHITE, (uint8_t)var});
-                    board.white_king = wk;
-                    board.black_king = bk;
-                    
-                    for (int stm = COLOR_WHITE; stm <= COLOR_BLACK; stm++) {
-                        board.to_move = stm;
-                        
-                        if (is_illegal_position(&board)) continue;
-                        
-                        uint64_t hash = compute_hash(&board);
-                        
-                        WDLOutcome wdl;
-                        int dtm;
-                        
-                        if (get_terminal_outcome(&board, &wdl, &dtm)) {
-                            TablebaseEntry entry = {wdl, dtm, {0, 0}, {0, 0}, PIECE_NONE};
-                            add_entry(tb, hash, stm, &entry);
-                            
-                            if (wdl == WDL_WIN) tb->win_count++;
-                            else if (wdl == WDL_DRAW) tb->draw_count++;
-                            else if (wdl == WDL_LOSS) tb->loss_count++;
-                        } else {
-                            /* Non-terminal - add to unknown list */
-                            if (unknown_count < MAX_TABLEBASE_SIZE) {
-                                unknown[unknown_count].board = board;
-                                unknown[unknown_count].hash = hash;
-                                unknown[unknown_count].stm = stm;
-                                unknown_count++;
-                            }
-                        }
-                    }
-                }
-            }
+    /* Slices of workers that failed to start are picked up here */
+    for (int i = started; i < job->num_threads; i++) {
+        fn(&workers[i]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+/* Gather every worker's queue for one DTM into job->level */
+static bool collect_level(RetroJob* job, int dtm, bool* more) {
+    uint32_t total = 0;
+    *more = false;
+    
+    for (int t = 0; t < job->num_threads; t++) {
+        DtmQueue* queue = &job->queues[t];
+        if (dtm < queue->level_count) {
+            total += queue->levels[dtm].count;
+            *more = true;
         }
     }
     
-    /* Phase 2: Retrograde analysis */
-    bool changed = true;
-    int max_iterations = 200;
-    int iteration = 0;
+    free(job->level);
+    job->level = malloc(sizeof(uint32_t) * (total ? total : 1));
+    if (!job->level) return false;
+    job->level_count = 0;
     
-    while (changed && iteration < max_iterations) {
-        changed = false;
-        iteration++;
+    for (int t = 0; t < job->num_threads; t++) {
+        DtmQueue* queue = &job->queues[t];
+        if (dtm >= queue->level_count) continue;
         
-        for (int i = 0; i < unknown_count; i++) {
-            Board* board = &unknown[i].board;
-            uint64_t hash = unknown[i].hash;
-            Color stm = unknown[i].stm;
-            
-            /* Skip if already resolved */
-            TablebaseEntry* existing = get_entry(tb, hash, stm);
-            if (existing && existing->wdl != WDL_UNKNOWN) continue;
-            
-            MoveList moves;
-            board->to_move = stm;
-            generate_legal_moves(board, &moves);
-            
-            bool has_winning_move = false;
-            bool all_moves_lose = true;
-            int best_dtm = 1000;
-            Move best_move = {{0, 0}, {0, 0}, PIECE_NONE};
-            int max_loss_dtm = 0;
-            
-            for (int m = 0; m < moves.count; m++) {
-                Board copy = board_copy(board);
-                make_move(&copy, moves.moves[m]);
-                
-                uint64_t new_hash = compute_hash(&copy);
-                Color opponent = opponent_color(stm);
-                
-                TablebaseEntry* opp_entry = get_entry(tb, new_hash, opponent);
-                
-                if (!opp_entry || opp_entry->wdl == WDL_UNKNOWN) {
-                    /* Unknown position - can't conclude */
-                    all_moves_lose = false;
-                    continue;
-                }
-                
-                if (opp_entry->wdl == WDL_LOSS) {
-                    /* Opponent loses = we win */
-                    has_winning_move = true;
-                    if (opp_entry->dtm + 1 < best_dtm) {
-                        best_dtm = opp_entry->dtm + 1;
-                        best_move = moves.moves[m];
-                    }
-                } else if (opp_entry->wdl == WDL_WIN) {
-                    /* Opponent wins = we lose with this move */
-                    if (opp_entry->dtm > max_loss_dtm) {
-                        max_loss_dtm = opp_entry->dtm;
-                    }
-                } else {
-                    /* Draw - better than losing */
-                    all_moves_lose = false;
-                }
-            }
-            
-            if (has_winning_move) {
-                TablebaseEntry entry = {WDL_WIN, best_dtm, best_move.from, best_move.to, best_move.promotion};
-                add_entry(tb, hash, stm, &entry);
-                tb->win_count++;
-                changed = true;
-            } else if (all_moves_lose && moves.count > 0) {
-                TablebaseEntry entry = {WDL_LOSS, max_loss_dtm + 1, {0, 0}, {0, 0}, PIECE_NONE};
-                add_entry(tb, hash, stm, &entry);
-                tb->loss_count++;
-                changed = true;
-            }
+        IndexQueue* level = &queue->levels[dtm];
+        memcpy(job->level + job->level_count, level->items, sizeof(uint32_t) * level->count);
+        job->level_count += level->count;
+        
+        /* Level is done; its memory can go */
+        free(level->items);
+        level->items = NULL;
+        level->count = level->capacity = 0;
+    }
+    return true;
+}
+
+/* Fill tb->entries for every legal position of the configuration */
+static bool generate_table(Tablebase* tb, int num_threads) {
+    RetroJob job;
+    memset(&job, 0, sizeof(job));
+    job.tb = tb;
+    job.num_threads = num_threads;
+    job.remaining = malloc(tb->index_size);
+    job.queues = calloc(num_threads, sizeof(DtmQueue));
+    
+    bool ok = job.remaining && job.queues;
+    
+    /* Phase 1: Enumerate all positions */
+    if (ok) {
+        run_workers(&job, classify_worker);
+        ok = !job.failed;
+    }
+    
+    /* Phase 2: Resolve backwards in DTM order */
+    for (int dtm = 0; ok; dtm++) {
+        bool more;
+        if (!collect_level(&job, dtm, &more)) {
+            ok = false;
+            break;
         }
+        if (!more) break;
+        
+        job.dtm = dtm;
+        run_workers(&job, propagate_worker);
+        ok = !job.failed;
     }
     
     /* Phase 3: Remaining unknowns are draws */
-    for (int i = 0; i < unknown_count; i++) {
-        uint64_t hash = unknown[i].hash;
-        Color stm = unknown[i].stm;
-        
-        TablebaseEntry* existing = get_entry(tb, hash, stm);
-        if (!existing || existing->wdl == WDL_UNKNOWN) {
-            TablebaseEntry entry = {WDL_DRAW, -1, {0, 0}, {0, 0}, PIECE_NONE};
-            add_entry(tb, hash, stm, &entry);
-            tb->draw_count++;
+    for (uint32_t idx = 0; idx < tb->index_size && ok; idx++) {
+        if (job.remaining[idx] != RETRO_DONE && TB_ENTRY_WDL(tb->entries[idx]) == WDL_UNKNOWN) {
+            tb->entries[idx] = entry_make(WDL_DRAW, -1);
+        }
+    }
+    
+    if (job.queues) {
+        for (int t = 0; t < num_threads; t++) {
+            dtm_queue_free(&job.queues[t]);
         }
     }
+    free(job.queues);
+    free(job.level);
+    free(job.remaining);
+    return ok;
+}
+
+/* Count outcomes for statistics */
+static void count_outcomes(Tablebase* tb) {
+    tb->win_count = 0;
+    tb->draw_count = 0;
+    tb->loss_count = 0;
+    
+    for (uint32_t idx = 0; idx < tb->index_size; idx++) {
+        switch (TB_ENTRY_WDL(tb->entries[idx])) {
+            case WDL_WIN:  tb->win_count++; break;
+            case WDL_DRAW: tb->draw_count++; break;
+            case WDL_LOSS: tb->loss_count++; break;
+            default: break;
+        }
+    }
+    tb->size = tb->win_count + tb->draw_count + tb->loss_count;
+}
+
+/* Tables that moves out of a config (captures, promotions) lead into */
+typedef struct {
+    int count;
+    TablebaseConfigType configs[TB_CONFIG_COUNT];
+    bool missing;     /* Some exit has no table; generation is refused */
+} ConfigDependencies;
+
+static ConfigDependencies dependencies[TB_CONFIG_COUNT];
+
+static void dependency_add(ConfigDependencies* deps, TablebaseSignature* sig) {
+    signature_sort(sig, NULL, NULL);
+    
+    bool flipped;
+    TablebaseConfigType config = config_from_signature(sig, &flipped);
+    if (config == TB_CONFIG_COUNT) {
+        deps->missing = true;
+        return;
+    }
+    for (int i = 0; i < deps->count; i++) {
+        if (deps->configs[i] == config) return;
+    }
+    deps->configs[deps->count++] = config;
+}
+
+static void dependencies_init(TablebaseConfigType config) {
+    const TablebaseSignature* sig = &tablebases[config].signature;
+    ConfigDependencies* deps = &dependencies[config];
+    memset(deps, 0, sizeof(*deps));
     
-    free(unknown);
+    static const PieceType PROMOTIONS[] = {PIECE_QUEEN, PIECE_LANCE, PIECE_CHARIOT, PIECE_KNIGHT};
+    
+    for (int s = 0; s < sig->count; s++) {
+        /* Capture of the piece in slot s */
+        TablebaseSignature captured = *sig;
+        captured.count--;
+        for (int t = s; t < captured.count; t++) {
+            captured.types[t] = sig->types[t + 1];
+            captured.colors[t] = sig->colors[t + 1];
+        }
+        dependency_add(deps, &captured);
+        
+        if (sig->types[s] != PIECE_PAWN) continue;
+        
+        /* Promotion of the pawn, with or without a capture */
+        for (int i = 0; i < 4; i++) {
+            TablebaseSignature promoted = *sig;
+            promoted.types[s] = PROMOTIONS[i];
+            dependency_add(deps, &promoted);
+            
+            for (int t = 0; t < sig->count; t++) {
+                if (t == s || sig->colors[t] == sig->colors[s]) continue;
+                TablebaseSignature both = promoted;
+                both.count--;
+                for (int u = t; u < both.count; u++) {
+                    both.types[u] = promoted.types[u + 1];
+                    both.colors[u] = promoted.colors[u + 1];
+                }
+                dependency_add(deps, &both);
+            }
+        }
+    }
+}
+
+/* Free or unmap the entries of a table */
+static void release_entries(Tablebase* tb) {
+    if (tb->mapping) {
+        munmap(tb->mapping, tb->mapping_size);
+        tb->mapping = NULL;
+        tb->mapping_size = 0;
+    } else {
+        free(tb->entries);
+    }
+    tb->entries = NULL;
 }
 
 /* ============================================================================
@@ -418,21 +1185,32 @@ static void generate_KPvK(Tablebase* tb, PieceType piece_type) {
 void tablebase_init(void) {
     if (tablebase_system_initialized) return;
     
-    init_zobrist();
+    init_binomials();
+    init_symmetries();
     
     for (int i = 0; i < TB_CONFIG_COUNT; i++) {
         tablebases[i].config = i;
         tablebases[i].name = CONFIG_NAMES[i];
-        tablebases[i].entries = malloc(sizeof(TablebaseEntry) * MAX_TABLEBASE_SIZE);
-        tablebases[i].keys = malloc(sizeof(TablebaseKey) * MAX_TABLEBASE_SIZE);
+        signature_parse(CONFIG_NAMES[i], &tablebases[i].signature);
+        layout_init(&tablebases[i].signature, &layouts[i]);
+        
+        uint64_t index_size = layout_index_size(&layouts[i]);
+        tablebases[i].index_size = index_size > UINT32_MAX ? UINT32_MAX : (uint32_t)index_size;
+        tablebases[i].entries = NULL;
+        tablebases[i].mapping = NULL;
+        tablebases[i].mapping_size = 0;
         tablebases[i].size = 0;
-        tablebases[i].capacity = MAX_TABLEBASE_SIZE;
         tablebases[i].win_count = 0;
         tablebases[i].draw_count = 0;
         tablebases[i].loss_count = 0;
         tablebases[i].generated = false;
     }
     
+    /* Dependencies refer to other tables' signatures, so all must be set */
+    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+        dependencies_init(i);
+    }
+    
     tablebase_system_initialized = true;
 }
 
@@ -440,10 +1218,7 @@ void tablebase_cleanup(void) {
     if (!tablebase_system_initialized) return;
     
     for (int i = 0; i < TB_CONFIG_COUNT; i++) {
-        free(tablebases[i].entries);
-        free(tablebases[i].keys);
-        tablebases[i].entries = NULL;
-        tablebases[i].keys = NULL;
+        release_entries(&tablebases[i]);
         tablebases[i].size = 0;
         tablebases[i].generated = false;
     }
@@ -451,7 +1226,17 @@ void tablebase_cleanup(void) {
     tablebase_system_initialized = false;
 }
 
+int tablebase_default_threads(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) return 1;
+    return cores > TB_MAX_THREADS ? TB_MAX_THREADS : (int)cores;
+}
+
 bool tablebase_generate(TablebaseConfigType config) {
+    return tablebase_generate_threads(config, tablebase_default_threads());
+}
+
+bool tablebase_generate_threads(TablebaseConfigType config, int num_threads) {
     if (!tablebase_system_initialized) {
         tablebase_init();
     }
@@ -460,88 +1245,307 @@ bool tablebase_generate(TablebaseConfigType config) {
     
     Tablebase* tb = &tablebases[config];
     if (tb->generated) return true;
+    if (tb->index_size > MAX_TABLEBASE_SIZE) return false;
     
-    /* Reset counts */
-    tb->size = 0;
-    tb->win_count = 0;
-    tb->draw_count = 0;
-    tb->loss_count = 0;
+    if (num_threads < 1) num_threads = 1;
+    if (num_threads > TB_MAX_THREADS) num_threads = TB_MAX_THREADS;
     
-    switch (config) {
-        case TB_CONFIG_KvK:
-            generate_KvK(tb);
-            break;
-        case TB_CONFIG_KQvK:
-            generate_KPvK(tb, PIECE_QUEEN);
-            break;
-        case TB_CONFIG_KLvK:
-            generate_KPvK(tb, PIECE_LANCE);
-            break;
-        case TB_CONFIG_KCvK:
-            generate_KPvK(tb, PIECE_CHARIOT);
-            break;
-        case TB_CONFIG_KNvK:
-            generate_KPvK(tb, PIECE_KNIGHT);
-            break;
-        default:
-            return false;
+    /* Workers must never trigger generation of another table themselves */
+    const ConfigDependencies* deps = &dependencies[config];
+    if (deps->missing) return false;
+    for (int i = 0; i < deps->count; i++) {
+        if (!tablebase_generate_threads(deps->configs[i], num_threads)) return false;
     }
     
+    /* Zeroed entries are WDL_UNKNOWN */
+    release_entries(tb);
+    tb->entries = calloc(tb->index_size, sizeof(TablebaseEntry));
+    if (!tb->entries) return false;
+    
+    if (!generate_table(tb, num_threads)) {
+        free(tb->entries);
+        tb->entries = NULL;
+        return false;
+    }
+    
+    count_outcomes(tb);
     tb->generated = true;
     return true;
 }
 
 void tablebase_generate_all(void) {
-    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
-        tablebase_generate(i);
-    }
+    tablebase_generate_all_threads(tablebase_default_threads());
 }
 
-TablebaseConfigType tablebase_detect_config(const Board* board) {
-    int white_pieces = 0;
-    int black_pieces = 0;
-    PieceType white_type = PIECE_NONE;
-    PieceType black_type = PIECE_NONE;
-    
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell c = cell_make(q, r);
-            if (!cell_is_valid(c)) continue;
-            
-            Piece* p = board_get((Board*)board, c);
-            if (p->type == PIECE_NONE || p->type == PIECE_KING) continue;
+typedef struct {
+    TablebaseConfigType config;
+    int num_threads;
+} ConfigJob;
+
+static void* generate_config_worker(void* arg) {
+    ConfigJob* job = arg;
+    tablebase_generate_threads(job->config, job->num_threads);
+    return NULL;
+}
+
+void tablebase_generate_all_threads(int num_threads) {
+    if (!tablebase_system_initialized) {
+        tablebase_init();
+    }
+    if (num_threads < 1) num_threads = 1;
+    
+    bool attempted[TB_CONFIG_COUNT] = {false};
+    
+    /* Build in dependency tiers; the configs of one tier run side by side */
+    for (;;) {
+        ConfigJob jobs[TB_CONFIG_COUNT];
+        pthread_t threads[TB_CONFIG_COUNT];
+        bool started[TB_CONFIG_COUNT];
+        int job_count = 0;
+        
+        for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+            if (attempted[i] || tablebases[i].generated) continue;
+            if (tablebases[i].index_size > TB_ON_DEMAND_SIZE) continue;
             
-            if (p->color == COLOR_WHITE) {
-                white_pieces++;
-                white_type = p->type;
+            bool ready = !dependencies[i].missing;
+            for (int d = 0; d < dependencies[i].count && ready; d++) {
+                ready = tablebases[dependencies[i].configs[d]].generated;
+            }
+            if (ready) {
+                attempted[i] = true;
+                jobs[job_count++].config = i;
+            }
+        }
+        if (job_count == 0) break;
+        
+        for (int i = 0; i < job_count; i++) {
+            /* Split the threads, giving the remainder to the first configs */
+            jobs[i].num_threads = num_threads / job_count + (i < num_threads % job_count ? 1 : 0);
+            if (jobs[i].num_threads < 1) jobs[i].num_threads = 1;
+            started[i] = pthread_create(&threads[i], NULL, generate_config_worker, &jobs[i]) == 0;
+        }
+        for (int i = 0; i < job_count; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
             } else {
-                black_pieces++;
-                black_type = p->type;
+                generate_config_worker(&jobs[i]);
             }
         }
     }
+}
+
+/* ============================================================================
+ * Tablebase Files
+ * ============================================================================ */
+
+#define TB_FILE_BYTE_ORDER 0x01020304u
+
+/* On-disk header; exactly 64 bytes so the entries that follow are aligned */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t config;
+    /* Index layout */
+    uint32_t board_radius;
+    uint32_t num_cells;
+    uint32_t piece_count;
+    uint32_t signature;     /* Per slot: type in bits 0-2, colour in bit 3 */
+    uint32_t index_size;
+    uint32_t entry_bytes;
+    /* Contents */
+    uint32_t win_count;
+    uint32_t draw_count;
+    uint32_t loss_count;
+    uint32_t checksum;
+    uint32_t symmetries;    /* Bit per board symmetry folded into the index */
+} TablebaseFileHeader;
+
+_Static_assert(sizeof(TablebaseFileHeader) == 64, "tablebase file header must be 64 bytes");
+
+/* FNV-1a over the packed entries */
+static uint32_t entries_checksum(const TablebaseEntry* entries, uint32_t count) {
+    const uint8_t* bytes = (const uint8_t*)entries;
+    size_t length = (size_t)count * sizeof(TablebaseEntry);
+    uint32_t hash = 2166136261u;
+    
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void file_header_make(const Tablebase* tb, TablebaseFileHeader* header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, TB_FILE_MAGIC, sizeof(header->magic));
+    header->version = TB_FILE_VERSION;
+    header->byte_order = TB_FILE_BYTE_ORDER;
+    header->config = tb->config;
+    header->board_radius = BOARD_RADIUS;
+    header->num_cells = NUM_CELLS;
+    header->piece_count = tb->signature.count;
+    for (int s = 0; s < tb->signature.count; s++) {
+        uint32_t slot = (uint32_t)tb->signature.types[s] |
+                        (tb->signature.colors[s] == COLOR_BLACK ? 0x8u : 0);
+        header->signature |= slot << (4 * s);
+    }
+    header->symmetries = layouts[tb->config].symmetries;
+    header->index_size = tb->index_size;
+    header->entry_bytes = sizeof(TablebaseEntry);
+    header->win_count = tb->win_count;
+    header->draw_count = tb->draw_count;
+    header->loss_count = tb->loss_count;
+}
+
+/* Check that a file header describes exactly this table's layout */
+static bool file_header_matches(const Tablebase* tb, const TablebaseFileHeader* header) {
+    TablebaseFileHeader expected;
+    file_header_make(tb, &expected);
     
-    int total = white_pieces + black_pieces;
+    return memcmp(header->magic, expected.magic, sizeof(header->magic)) == 0 &&
+           header->version == expected.version &&
+           header->byte_order == expected.byte_order &&
+           header->config == expected.config &&
+           header->board_radius == expected.board_radius &&
+           header->num_cells == expected.num_cells &&
+           header->piece_count == expected.piece_count &&
+           header->signature == expected.signature &&
+           header->symmetries == expected.symmetries &&
+           header->index_size == expected.index_size &&
+           header->entry_bytes == expected.entry_bytes;
+}
+
+static void file_path(char* buffer, size_t size, const char* dir, TablebaseConfigType config) {
+    snprintf(buffer, size, "%s/%s%s", dir, CONFIG_NAMES[config], TB_FILE_EXTENSION);
+}
+
+bool tablebase_save(TablebaseConfigType config, const char* path) {
+    if (!tablebase_system_initialized || config >= TB_CONFIG_COUNT) return false;
+    
+    Tablebase* tb = &tablebases[config];
+    if (!tb->generated) return false;
+    
+    TablebaseFileHeader header;
+    file_header_make(tb, &header);
+    header.checksum = entries_checksum(tb->entries, tb->index_size);
     
-    /* KvK */
-    if (total == 0) {
-        return TB_CONFIG_KvK;
+    char tmp_path[4096];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path)) {
+        return false;
     }
     
-    /* K+Piece vs K */
-    if (total == 1) {
-        PieceType piece = (white_pieces == 1) ? white_type : black_type;
-        switch (piece) {
-            case PIECE_QUEEN:   return TB_CONFIG_KQvK;
-            case PIECE_LANCE:   return TB_CONFIG_KLvK;
-            case PIECE_CHARIOT: return TB_CONFIG_KCvK;
-            case PIECE_KNIGHT:  return TB_CONFIG_KNvK;
-            default: break;
-        }
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) return false;
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(tb->entries, sizeof(TablebaseEntry), tb->index_size, file) == tb->index_size;
+    ok = (fclose(file) == 0) && ok;
+    
+    if (ok) ok = rename(tmp_path, path) == 0;
+    if (!ok) remove(tmp_path);
+    return ok;
+}
+
+bool tablebase_load(TablebaseConfigType config, const char* path) {
+    if (!tablebase_system_initialized) {
+        tablebase_init();
     }
+    if (config >= TB_CONFIG_COUNT) return false;
     
-    /* Not a supported configuration */
-    return TB_CONFIG_COUNT;
+    Tablebase* tb = &tablebases[config];
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    
+    struct stat st;
+    size_t expected_size = sizeof(TablebaseFileHeader) +
+                           (size_t)tb->index_size * sizeof(TablebaseEntry);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != expected_size) {
+        close(fd);
+        return false;
+    }
+    
+    void* mapping = mmap(NULL, expected_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    
+    const TablebaseFileHeader* header = mapping;
+    if (!file_header_matches(tb, header)) {
+        munmap(mapping, expected_size);
+        return false;
+    }
+    
+    release_entries(tb);
+    tb->mapping = mapping;
+    tb->mapping_size = expected_size;
+    /* Never written through: a loaded table counts as generated */
+    tb->entries = (TablebaseEntry*)((char*)mapping + sizeof(TablebaseFileHeader));
+    tb->win_count = header->win_count;
+    tb->draw_count = header->draw_count;
+    tb->loss_count = header->loss_count;
+    tb->size = tb->win_count + tb->draw_count + tb->loss_count;
+    tb->generated = true;
+    return true;
+}
+
+bool tablebase_verify(TablebaseConfigType config) {
+    if (!tablebase_system_initialized || config >= TB_CONFIG_COUNT) return false;
+    
+    Tablebase* tb = &tablebases[config];
+    if (!tb->generated) return false;
+    if (!tb->mapping) return true;
+    
+    const TablebaseFileHeader* header = tb->mapping;
+    return entries_checksum(tb->entries, tb->index_size) == header->checksum;
+}
+
+int tablebase_save_all(const char* dir) {
+    char path[4096];
+    int saved = 0;
+    
+    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+        if (!tablebase_system_initialized || !tablebases[i].generated) continue;
+        file_path(path, sizeof(path), dir, i);
+        if (tablebase_save(i, path)) saved++;
+    }
+    return saved;
+}
+
+int tablebase_load_all(const char* dir) {
+    char path[4096];
+    int loaded = 0;
+    
+    for (int i = 0; i < TB_CONFIG_COUNT; i++) {
+        file_path(path, sizeof(path), dir, i);
+        if (tablebase_load(i, path)) loaded++;
+    }
+    return loaded;
+}
+
+/* ============================================================================
+ * Position Detection
+ * ============================================================================ */
+
+/* Whether the board could hold a table's material, from the piece
+ * counts alone: far cheaper than scanning it */
+static inline bool pieces_within_tables(const Board* board) {
+    return board->piece_count[0] + board->piece_count[1] <= TB_MAX_PIECES + 2;
+}
+
+TablebaseConfigType tablebase_detect_config(const Board* board) {
+    if (!pieces_within_tables(board)) return TB_CONFIG_COUNT;
+    
+    /* Signatures are parsed by init, which allocates nothing */
+    if (!tablebase_system_initialized) {
+        tablebase_init();
+    }
+    
+    MaterialScan scan;
+    scan_material(board, &scan);
+    
+    bool flipped;
+    return config_from_scan(&scan, &flipped);
 }
 
 bool tablebase_is_endgame(const Board* board) {
@@ -556,29 +1560,65 @@ TablebaseProbeResult tablebase_probe(const Board* board) {
         return result;
     }
     
-    if (!tablebases[config].generated) {
-        tablebase_generate(config);
+    ensure_table(&tablebases[config]);
+    
+    TablebaseEntry entry;
+    if (!tablebases[config].generated || !lookup_entry(board, &entry)) {
+        return result;
     }
     
-    uint64_t hash = compute_hash(board);
-    TablebaseEntry* entry = get_entry(&tablebases[config], hash, board->to_move);
+    result.found = true;
+    result.wdl = TB_ENTRY_WDL(entry);
+    result.dtm = (result.wdl == WDL_DRAW) ? -1 : TB_ENTRY_DTM(entry);
+    result.config = config;
     
-    if (entry && entry->wdl != WDL_UNKNOWN) {
-        result.found = true;
-        result.wdl = entry->wdl;
-        result.dtm = entry->dtm;
-        result.config = config;
+    if (result.wdl == WDL_WIN) {
+        /* Recompute the best move: the successor that loses fastest */
+        MoveList moves;
+        generate_legal_moves(board, &moves);
         
-        if (entry->wdl == WDL_WIN) {
-            result.best_move.from = entry->best_from;
-            result.best_move.to = entry->best_to;
-            result.best_move.promotion = entry->promotion;
+        int best_dtm = TB_MAX_DTM + 1;
+        Board scratch = board_copy(board);
+        for (int i = 0; i < moves.count; i++) {
+            UndoInfo undo;
+            make_move_with_undo(&scratch, moves.moves[i], &undo);
+            TablebaseEntry child;
+            bool found = lookup_entry(&scratch, &child);
+            unmake_move(&scratch, moves.moves[i], &undo);
+            
+            if (found && TB_ENTRY_WDL(child) == WDL_LOSS &&
+                TB_ENTRY_DTM(child) < best_dtm) {
+                best_dtm = TB_ENTRY_DTM(child);
+                result.best_move = moves.moves[i];
+            }
         }
     }
     
     return result;
 }
 
+bool tablebase_probe_wdl(const Board* board, WDLOutcome* wdl, int* dtm) {
+    if (!pieces_within_tables(board) || !tablebase_system_initialized) return false;
+    
+    MaterialScan scan;
+    scan_material(board, &scan);
+    
+    bool flipped;
+    TablebaseConfigType config = config_from_scan(&scan, &flipped);
+    if (config == TB_CONFIG_COUNT) return false;
+    
+    const Tablebase* tb = &tablebases[config];
+    if (!tb->generated) return false;
+    
+    Placement p;
+    if (!placement_from_scan(tb, &scan, flipped, board->to_move, &p)) return false;
+    
+    TablebaseEntry entry = tb->entries[placement_to_index(tb, &p)];
+    *wdl = TB_ENTRY_WDL(entry);
+    *dtm = (*wdl == WDL_DRAW) ? -1 : TB_ENTRY_DTM(entry);
+    return *wdl != WDL_UNKNOWN;
+}
+
 int tablebase_get_score(const Board* board, bool* found) {
     TablebaseProbeResult result = tablebase_probe(board);
     
@@ -657,17 +1697,13 @@ const char* tablebase_config_name(TablebaseConfigType config) {
 }
 
 int tablebase_count_pieces(const Board* board, Color color) {
+    if (color != COLOR_WHITE && color != COLOR_BLACK) return 0;
+    int side = color - 1;
     int count = 0;
     
-    for (int q = MIN_Q; q <= MAX_Q; q++) {
-        for (int r = MIN_R; r <= MAX_R; r++) {
-            Cell c = cell_make(q, r);
-            if (!cell_is_valid(c)) continue;
-            
-            Piece* p = board_get((Board*)board, c);
-            if (p->type != PIECE_NONE && p->type != PIECE_KING && p->color == color) {
-                count++;
-            }
+    for (int i = 0; i < board->piece_count[side]; i++) {
+        if (board->squares[board->pieces[side][i]].type != PIECE_KING) {
+            count++;
         }
     }
     
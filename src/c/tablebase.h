@@ -4,15 +4,20 @@
  *
  * Provides perfect endgame play for positions with few pieces:
  * - Precomputed Win/Draw/Loss (WDL) tables
- * - Distance to Mate (DTM) information
+ * - Distance to Mate (DTM) information, packed with WDL into 2 bytes
  * - Retrograde analysis for tablebase generation
  *
+ * Tables are generated from a material signature such as "KQvKL"; any
+ * signature of up to TB_MAX_PIECES non-king pieces can be indexed.
  * Supported endgames:
  * - KvK (King vs King) - Always draw
  * - KQvK (King+Queen vs King) - Win for the side with queen
  * - KLvK (King+Lance vs King) - Usually win, some draws
  * - KCvK (King+Chariot vs King) - Usually win, some draws
  * - KNvK (King+Knight vs King) - Mostly draws
+ * - KPvK (King+Pawn vs King) - Promotes into the tables above
+ * - KCCvK (King+2 Chariots vs King)
+ * - KQvKL (King+Queen vs King+Lance)
  *
  * Signed-by: agent #36 claude-sonnet-4 via opencode 20260122T09:33:00
  */
@@ -23,12 +28,23 @@
 #include "board.h"
 #include "moves.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 /* Maximum tablebase configurations to load */
 #define MAX_TABLEBASES 16
 
-/* Maximum positions per tablebase */
-#define MAX_TABLEBASE_SIZE 150000
+/* Maximum worker threads for tablebase generation */
+#define TB_MAX_THREADS 64
+
+/* Maximum non-king pieces in a tablebase signature (5-man endings) */
+#define TB_MAX_PIECES 3
+
+/* Maximum index size per tablebase (KQvKL, the largest config, needs ~55M) */
+#define MAX_TABLEBASE_SIZE (1 << 26)
+
+/* Tables up to this index size are generated on first probe. Larger ones
+ * are only built by an explicit tablebase_generate or tablebase_load. */
+#define TB_ON_DEMAND_SIZE (1 << 20)
 
 /* Win/Draw/Loss outcomes */
 typedef enum {
@@ -38,20 +54,14 @@ typedef enum {
     WDL_LOSS = 3
 } WDLOutcome;
 
-/* Tablebase entry for a single position */
-typedef struct {
-    WDLOutcome wdl;
-    int dtm;          /* Distance to mate (plies). 0 for checkmate, -1 for draws */
-    Cell best_from;   /* Best move source (if winning) */
-    Cell best_to;     /* Best move destination */
-    PieceType promotion; /* Promotion piece if applicable */
-} TablebaseEntry;
+/* Packed tablebase entry for a single position: WDL in the low 2 bits,
+ * distance to mate (plies) in the upper 14. The best move is not stored;
+ * it is recomputed at probe time from the successors' entries. */
+typedef uint16_t TablebaseEntry;
 
-/* Position key for tablebase lookup */
-typedef struct {
-    uint64_t hash;
-    Color side_to_move;
-} TablebaseKey;
+#define TB_ENTRY_WDL(e) ((WDLOutcome)((e) & 0x3))
+#define TB_ENTRY_DTM(e) ((int)((e) >> 2))
+#define TB_MAX_DTM 0x3FFF
 
 /* Tablebase configuration */
 typedef enum {
@@ -60,17 +70,35 @@ typedef enum {
     TB_CONFIG_KLvK = 2,   /* King+Lance vs King */
     TB_CONFIG_KCvK = 3,   /* King+Chariot vs King */
     TB_CONFIG_KNvK = 4,   /* King+Knight vs King */
-    TB_CONFIG_COUNT = 5
+    TB_CONFIG_KPvK = 5,   /* King+Pawn vs King */
+    TB_CONFIG_KCCvK = 6,  /* King+2 Chariots vs King */
+    TB_CONFIG_KQvKL = 7,  /* King+Queen vs King+Lance */
+    TB_CONFIG_COUNT = 8
 } TablebaseConfigType;
 
-/* Tablebase for a specific piece configuration */
+/* Material signature: the non-king pieces, White's before Black's and
+ * each side sorted by type. Positions with the colour-swapped material
+ * are stored flipped in the same table. */
+typedef struct {
+    int count;
+    PieceType types[TB_MAX_PIECES];
+    Color colors[TB_MAX_PIECES];
+} TablebaseSignature;
+
+/* Tablebase for a specific piece configuration.
+ *
+ * Positions are stored densely by a perfect index computed from the
+ * piece placement (see tablebase.c), one slot per position up to board
+ * symmetry; slots for impossible placements stay WDL_UNKNOWN. */
 typedef struct {
     TablebaseConfigType config;
     const char* name;
-    TablebaseEntry* entries;
-    TablebaseKey* keys;
-    int size;
-    int capacity;
+    TablebaseSignature signature;
+    TablebaseEntry* entries;  /* One packed entry per index */
+    uint32_t index_size;
+    void* mapping;            /* Read-only file mapping holding entries, if loaded */
+    size_t mapping_size;
+    int size;                 /* Positions with a resolved outcome */
     int win_count;
     int draw_count;
     int loss_count;
@@ -105,12 +133,58 @@ void tablebase_init(void);
 /* Free all tablebase memory */
 void tablebase_cleanup(void);
 
-/* Generate a specific tablebase */
+/* Generate a specific tablebase, using tablebase_default_threads() workers */
 bool tablebase_generate(TablebaseConfigType config);
 
-/* Generate all common tablebases */
+/* Generate a specific tablebase with the given number of worker threads.
+ * Tables it depends on are generated first. */
+bool tablebase_generate_threads(TablebaseConfigType config, int num_threads);
+
+/* Generate all tablebases up to TB_ON_DEMAND_SIZE */
 void tablebase_generate_all(void);
 
+/* Generate all tablebases up to TB_ON_DEMAND_SIZE, building independent
+ * configs concurrently and sharing num_threads workers between them */
+void tablebase_generate_all_threads(int num_threads);
+
+/* Number of online cores, capped at TB_MAX_THREADS */
+int tablebase_default_threads(void);
+
+/* ============================================================================
+ * Tablebase Files
+ * ============================================================================
+ *
+ * A tablebase file is a fixed 64-byte header followed by the packed
+ * entries in index order. The header records the format version, the
+ * config and the index layout it was built for, the outcome counts and a
+ * checksum of the entries. Files use host byte order; the header carries
+ * a byte-order mark so foreign files are rejected rather than misread.
+ */
+
+#define TB_FILE_MAGIC "UCHXTB\0\0"
+#define TB_FILE_VERSION 3
+#define TB_FILE_EXTENSION ".utb"
+
+/* Write a generated tablebase to path. The file is written under a
+ * temporary name and renamed into place, so readers never see it partial. */
+bool tablebase_save(TablebaseConfigType config, const char* path);
+
+/* Map a tablebase file read-only in place of generating the table.
+ * Only the header is validated, so entry pages are read lazily by probes
+ * and shared between processes; use tablebase_verify for the checksum. */
+bool tablebase_load(TablebaseConfigType config, const char* path);
+
+/* Recompute the checksum of a loaded tablebase against its file header.
+ * Generated tables have no file and always verify. */
+bool tablebase_verify(TablebaseConfigType config);
+
+/* Save every generated tablebase into dir as <name>.utb.
+ * Returns the number of files written. */
+int tablebase_save_all(const char* dir);
+
+/* Load every tablebase file found in dir. Returns the number loaded. */
+int tablebase_load_all(const char* dir);
+
 /* ============================================================================
  * Position Detection
  * ============================================================================ */
@@ -129,6 +203,13 @@ bool tablebase_is_endgame(const Board* board);
 /* Probe the tablebase for a position */
 TablebaseProbeResult tablebase_probe(const Board* board);
 
+/* Look up only the outcome, for use inside a search: no best move is
+ * computed and no table is generated, so it is cheap, rejects most
+ * positions on their piece count alone and is safe to call from any
+ * number of threads while no table is being built. Returns false if the
+ * position is not in an already generated table. */
+bool tablebase_probe_wdl(const Board* board, WDLOutcome* wdl, int* dtm);
+
 /* Get the tablebase score for evaluation integration.
  * Returns a large positive value for wins, 0 for draws, large negative for losses.
  * Returns 0 and sets *found=false if position not in tablebase. */
@@ -9,11 +9,26 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <threads.h>
 
 #include "../board.h"
 #include "../moves.h"
 #include "../ai.h"
 #include "../tablebase.h"
+#include "../bitboard.h"
+#include "../tt.h"
+#include "../zobrist.h"
+#include "../perft.h"
+#include "../psqt.h"
+#include "../engine.h"
+#include "../selfplay.h"
+#include "../ponder.h"
+#include "../book.h"
+#include "../geometry.h"
+#include "../position.h"
+#include "../analyze.h"
+#include "../history.h"
 
 /* Test counters */
 static int tests_run = 0;
@@ -114,6 +129,40 @@ TEST(board_copy) {
 
 /* ============ Move Tests ============ */
 
+TEST(board_piece_lists) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    /* The lists hold exactly the occupied cells of each colour, through
+     * captures and promotions */
+    for (int ply = 0; ply < 40; ply++) {
+        int counts[3] = {0, 0, 0};
+        for (int i = 0; i < NUM_CELLS; i++) {
+            Piece* p = board_get(&board, cell_from_index(i));
+            if (p->type != PIECE_NONE) counts[p->color]++;
+        }
+        
+        for (int side = 0; side < 2; side++) {
+            ASSERT_EQ(board.piece_count[side], counts[side + 1]);
+            for (int i = 0; i < board.piece_count[side]; i++) {
+                int square = board.pieces[side][i];
+                ASSERT_EQ(board.piece_slot[square], i);
+                ASSERT_EQ(board.squares[square].color, side + 1);
+            }
+        }
+        
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        if (moves.count == 0) break;
+        make_move(&board, moves.moves[(ply * 13) % moves.count]);
+    }
+    
+    /* Cells off the hex read as sentinels */
+    ASSERT_EQ(sizeof(Piece), 1);
+    ASSERT_EQ(board.squares[cell_square(cell_make(4, 4))].type, PIECE_OFFBOARD);
+    ASSERT_EQ(board.squares[cell_square(cell_make(-5, 0))].type, PIECE_OFFBOARD);
+}
+
 TEST(pawn_moves_initial) {
     Board board;
     board_init_starting_position(&board);
@@ -251,6 +300,423 @@ TEST(make_move) {
     ASSERT(board.to_move == COLOR_BLACK);
 }
 
+/* Legal moves by brute force: play every pseudo-legal move and look */
+static int reference_legal_moves(const Board* board, MoveList* legal) {
+    MoveList pseudo;
+    generate_pseudo_legal_moves(board, &pseudo);
+    movelist_init(legal);
+    for (int i = 0; i < pseudo.count; i++) {
+        Board copy = board_copy(board);
+        make_move(&copy, pseudo.moves[i]);
+        if (!is_in_check(&copy, board->to_move)) movelist_add(legal, pseudo.moves[i]);
+    }
+    return legal->count;
+}
+
+static bool same_moves(const MoveList* a, const MoveList* b) {
+    if (a->count != b->count) return false;
+    for (int i = 0; i < a->count; i++) {
+        if (!cell_equals(a->moves[i].from, b->moves[i].from) ||
+            !cell_equals(a->moves[i].to, b->moves[i].to) ||
+            a->moves[i].promotion != b->moves[i].promotion) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(legal_moves_match_reference) {
+    /* Random sparse positions are full of checks and pins */
+    PieceType types[] = {PIECE_PAWN, PIECE_KNIGHT, PIECE_LANCE, PIECE_CHARIOT, PIECE_QUEEN};
+    srand(11);
+    int tested = 0;
+    
+    for (int iter = 0; iter < 3000; iter++) {
+        Board board;
+        board_clear(&board);
+        board_set(&board, cell_from_index(rand() % NUM_CELLS), (Piece){PIECE_KING, COLOR_WHITE, 0});
+        Cell bk = cell_from_index(rand() % NUM_CELLS);
+        if (cell_equals(bk, board.white_king)) continue;
+        board_set(&board, bk, (Piece){PIECE_KING, COLOR_BLACK, 0});
+        
+        for (int i = 0; i < 6; i++) {
+            Cell c = cell_from_index(rand() % NUM_CELLS);
+            if (board_get(&board, c)->type != PIECE_NONE) continue;
+            Piece p = {types[rand() % 5], (rand() & 1) ? COLOR_WHITE : COLOR_BLACK, (uint8_t)(rand() & 1)};
+            board_set(&board, c, p);
+        }
+        board.to_move = (rand() & 1) ? COLOR_WHITE : COLOR_BLACK;
+        if (is_in_check(&board, opponent_color(board.to_move))) continue;
+        
+        MoveList legal, expected;
+        generate_legal_moves(&board, &legal);
+        reference_legal_moves(&board, &expected);
+        ASSERT(same_moves(&legal, &expected));
+        
+        /* The single-move check agrees, including on moves that are not
+         * pseudo-legal at all */
+        MoveList pseudo;
+        generate_pseudo_legal_moves(&board, &pseudo);
+        for (int i = 0; i < pseudo.count; i++) {
+            bool listed = false;
+            for (int j = 0; j < expected.count; j++) {
+                listed |= cell_equals(expected.moves[j].from, pseudo.moves[i].from) &&
+                          cell_equals(expected.moves[j].to, pseudo.moves[i].to);
+            }
+            ASSERT_EQ(is_move_legal(&board, pseudo.moves[i]), listed);
+        }
+        for (int i = 0; i < 20; i++) {
+            Move m = {cell_from_index(rand() % NUM_CELLS), cell_from_index(rand() % NUM_CELLS), PIECE_NONE};
+            bool listed = false;
+            for (int j = 0; j < expected.count; j++) {
+                listed |= cell_equals(expected.moves[j].from, m.from) &&
+                          cell_equals(expected.moves[j].to, m.to);
+            }
+            ASSERT_EQ(is_move_legal(&board, m), listed);
+        }
+        tested++;
+    }
+    ASSERT(tested > 1000);
+}
+
+/* Whether the piece on from attacks target, by walking the board */
+static bool reference_attacks(Board* board, Cell from, Cell target) {
+    static const int DIRS[4][6] = {
+        {DIR_N, DIR_S, DIR_NW, DIR_SE, -1, -1},     /* Lance A */
+        {DIR_N, DIR_S, DIR_NE, DIR_SW, -1, -1},     /* Lance B */
+        {DIR_NE, DIR_SW, DIR_NW, DIR_SE, -1, -1},   /* Chariot */
+        {0, 1, 2, 3, 4, 5}                          /* Queen */
+    };
+    static const Direction JUMPS[6] = {{1, -2}, {-1, -1}, {2, -1}, {1, 1}, {-1, 2}, {-2, 1}};
+    
+    Piece p = *board_get(board, from);
+    int dq = target.q - from.q, dr = target.r - from.r;
+    int rider = -1;
+    
+    switch (p.type) {
+        case PIECE_PAWN: {
+            int forward[3] = {DIR_N, DIR_NE, DIR_NW};
+            if (p.color == COLOR_BLACK) forward[0] = DIR_S, forward[1] = DIR_SE, forward[2] = DIR_SW;
+            for (int i = 0; i < 3; i++) {
+                if (cell_equals(cell_add(from, DIRECTIONS[forward[i]]), target)) return true;
+            }
+            return false;
+        }
+        case PIECE_KNIGHT:
+            for (int i = 0; i < 6; i++) {
+                if (dq == JUMPS[i].dq && dr == JUMPS[i].dr) return true;
+            }
+            return false;
+        case PIECE_KING:
+            for (int i = 0; i < 6; i++) {
+                if (cell_equals(cell_add(from, DIRECTIONS[i]), target)) return true;
+            }
+            return false;
+        case PIECE_LANCE:   rider = p.variant; break;
+        case PIECE_CHARIOT: rider = 2; break;
+        case PIECE_QUEEN:   rider = 3; break;
+        default:            return false;
+    }
+    
+    for (int i = 0; i < 6 && DIRS[rider][i] >= 0; i++) {
+        for (Cell c = cell_add(from, DIRECTIONS[DIRS[rider][i]]); cell_is_valid(c);
+             c = cell_add(c, DIRECTIONS[DIRS[rider][i]])) {
+            if (cell_equals(c, target)) return true;
+            if (board_get(board, c)->type != PIECE_NONE) break;
+        }
+    }
+    return false;
+}
+
+TEST(geometry_tables_match_hex) {
+    /* Cells are numbered in (q, r) order, and the tables agree with the
+     * coordinate arithmetic they replace */
+    int next = 0;
+    for (int q = MIN_Q - 2; q <= MAX_Q + 2; q++) {
+        for (int r = MIN_R - 2; r <= MAX_R + 2; r++) {
+            Cell c = cell_make(q, r);
+            int s = -q - r;
+            int distance = max3_int(abs_int(q), abs_int(r), abs_int(s));
+            ASSERT_EQ(cell_is_valid(c), distance <= BOARD_RADIUS);
+            if (distance > BOARD_RADIUS) {
+                ASSERT_EQ(cell_to_index(c), -1);
+                continue;
+            }
+            
+            int index = next++;
+            ASSERT_EQ(cell_to_index(c), index);
+            ASSERT(cell_equals(cell_from_index(index), c));
+            ASSERT_EQ(geo_center_distance[index], distance);
+            ASSERT_EQ((geo_promotion_mask[0] >> index) & 1, r == -BOARD_RADIUS);
+            ASSERT_EQ((geo_promotion_mask[1] >> index) & 1, r == BOARD_RADIUS);
+            
+            for (int dir = 0; dir < 6; dir++) {
+                Cell step = cell_add(c, DIRECTIONS[dir]);
+                ASSERT_EQ(geo_neighbors[dir][index], cell_to_index(step));
+                
+                int length = 0;
+                for (; cell_is_valid(step); step = cell_add(step, DIRECTIONS[dir])) length++;
+                ASSERT_EQ(bb_popcount(bb_rays[dir][index]), length);
+            }
+        }
+    }
+    ASSERT_EQ(next, NUM_CELLS);
+}
+
+TEST(bitboard_attacks_match_reference) {
+    PieceType types[] = {PIECE_PAWN, PIECE_KNIGHT, PIECE_LANCE, PIECE_CHARIOT, PIECE_QUEEN, PIECE_KING};
+    srand(23);
+    
+    for (int iter = 0; iter < 300; iter++) {
+        Board board;
+        board_clear(&board);
+        for (int i = 0; i < 14; i++) {
+            Piece p = {types[rand() % 6], (rand() & 1) ? COLOR_WHITE : COLOR_BLACK, (uint8_t)(rand() & 1)};
+            board_set(&board, cell_from_index(rand() % NUM_CELLS), p);
+        }
+        
+        /* The masks mirror the mailbox */
+        for (int i = 0; i < NUM_CELLS; i++) {
+            Piece* p = board_get(&board, cell_from_index(i));
+            bool white = (board.occupied[0] >> i) & 1;
+            bool black = (board.occupied[1] >> i) & 1;
+            ASSERT_EQ(white, p->type != PIECE_NONE && p->color == COLOR_WHITE);
+            ASSERT_EQ(black, p->type != PIECE_NONE && p->color == COLOR_BLACK);
+            if (p->type != PIECE_NONE) ASSERT((board.kinds[bb_kind(*p)] >> i) & 1);
+        }
+        
+        for (int t = 0; t < NUM_CELLS; t++) {
+            Cell target = cell_from_index(t);
+            for (Color by = COLOR_WHITE; by <= COLOR_BLACK; by++) {
+                bool expected = false;
+                for (int f = 0; f < NUM_CELLS && !expected; f++) {
+                    Cell from = cell_from_index(f);
+                    Piece* p = board_get(&board, from);
+                    expected = p->type != PIECE_NONE && p->color == by &&
+                               reference_attacks(&board, from, target);
+                }
+                ASSERT_EQ(is_cell_attacked(&board, target, by), expected);
+            }
+        }
+        
+        /* Capture-only generation is exactly the capturing pseudo-legal moves */
+        board.to_move = (rand() & 1) ? COLOR_WHITE : COLOR_BLACK;
+        MoveList all, captures;
+        generate_pseudo_legal_moves(&board, &all);
+        generate_pseudo_legal_captures(&board, &captures);
+        int expected = 0;
+        for (int i = 0; i < all.count; i++) {
+            if (board_get(&board, all.moves[i].to)->type != PIECE_NONE) expected++;
+        }
+        ASSERT_EQ(captures.count, expected);
+        for (int i = 0; i < captures.count; i++) {
+            ASSERT(board_get(&board, captures.moves[i].to)->type != PIECE_NONE);
+        }
+    }
+}
+
+TEST(generate_captures_noisy_only) {
+    /* From each perft position and a few random plies on, the capture
+     * generator yields exactly the legal captures and promotions */
+    srand(5);
+    for (int i = 0; i < PERFT_POSITION_COUNT; i++) {
+        Board board;
+        perft_setup(i, &board);
+        
+        for (int ply = 0; ply < 20; ply++) {
+            MoveList legal, noisy, captures;
+            generate_legal_moves(&board, &legal);
+            if (legal.count == 0) break;
+            
+            movelist_init(&noisy);
+            for (int m = 0; m < legal.count; m++) {
+                Move move = legal.moves[m];
+                if (board_get(&board, move.to)->type != PIECE_NONE ||
+                    move.promotion != PIECE_NONE) {
+                    movelist_add(&noisy, move);
+                }
+            }
+            generate_captures(&board, &captures);
+            ASSERT(same_moves(&captures, &noisy));
+            
+            make_move(&board, legal.moves[rand() % legal.count]);
+        }
+    }
+}
+
+TEST(move_code_round_trip) {
+    Board board;
+    board_init_starting_position(&board);
+    ASSERT_EQ(sizeof(MoveCode), 2);
+    
+    MoveList moves;
+    generate_legal_moves(&board, &moves);
+    MoveCode codes[MAX_MOVES];
+    movelist_encode(&moves, codes);
+    for (int i = 0; i < moves.count; i++) {
+        ASSERT_EQ(codes[i], move_encode(moves.moves[i]));
+        ASSERT(codes[i] != MOVE_CODE_NONE);
+        Move back = move_decode(codes[i]);
+        ASSERT(cell_equals(back.from, moves.moves[i].from));
+        ASSERT(cell_equals(back.to, moves.moves[i].to));
+        ASSERT_EQ(back.promotion, PIECE_NONE);
+    }
+    
+    /* Corner to corner, promoting; and the empty move */
+    Move promo = {cell_make(4, -4), cell_make(-4, 4), PIECE_KNIGHT};
+    Move back = move_decode(move_encode(promo));
+    ASSERT(cell_equals(back.from, promo.from) && cell_equals(back.to, promo.to));
+    ASSERT_EQ(back.promotion, PIECE_KNIGHT);
+    
+    Move empty = {{0, 0}, {0, 0}, PIECE_NONE};
+    ASSERT_EQ(move_encode(empty), MOVE_CODE_NONE);
+    back = move_decode(MOVE_CODE_NONE);
+    ASSERT(cell_equals(back.from, empty.from) && cell_equals(back.to, empty.to));
+}
+
+TEST(make_unmake_move) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    /* Every move from a sequence of positions, including captures and
+     * king moves, is taken back exactly */
+    for (int ply = 0; ply < 12; ply++) {
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        ASSERT(moves.count > 0);
+        
+        for (int i = 0; i < moves.count; i++) {
+            Board before = board_copy(&board);
+            UndoInfo undo;
+            make_move_with_undo(&board, moves.moves[i], &undo);
+            ASSERT(zobrist_key(&board) == zobrist_compute(&board));
+            unmake_move(&board, moves.moves[i], &undo);
+            ASSERT(memcmp(&before, &board, sizeof(Board)) == 0);
+        }
+        
+        make_move(&board, moves.moves[(ply * 5) % moves.count]);
+    }
+}
+
+TEST(perft_counts) {
+    /* Shallow depths of spec/tests/perft_validation.json; make bench runs the rest */
+    for (int i = 0; i < PERFT_POSITION_COUNT; i++) {
+        Board board;
+        perft_setup(i, &board);
+        Board before = board_copy(&board);
+        
+        for (int d = 1; d <= 4 && d <= PERFT_POSITIONS[i].depth_count; d++) {
+            ASSERT(perft(&board, d) == PERFT_POSITIONS[i].nodes[d - 1]);
+        }
+        ASSERT(memcmp(&board, &before, sizeof(Board)) == 0);
+        
+        MoveList moves;
+        uint64_t counts[MAX_MOVES];
+        ASSERT(perft_divide(&board, 3, &moves, counts) == PERFT_POSITIONS[i].nodes[2]);
+        ASSERT_EQ(moves.count, (int)PERFT_POSITIONS[i].nodes[0]);
+    }
+}
+
+TEST(zobrist_incremental) {
+    Board board;
+    board_init_starting_position(&board);
+    ASSERT(zobrist_key(&board) == zobrist_compute(&board));
+    
+    /* The incremental hash follows a sequence of moves */
+    for (int i = 0; i < 8; i++) {
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        ASSERT(moves.count > 0);
+        make_move(&board, moves.moves[(i * 7) % moves.count]);
+        ASSERT(zobrist_key(&board) == zobrist_compute(&board));
+    }
+    
+    /* The side to move is part of the key */
+    Board flipped = board_copy(&board);
+    flipped.to_move = opponent_color(board.to_move);
+    ASSERT(zobrist_key(&flipped) != zobrist_key(&board));
+}
+
+TEST(psqt_incremental) {
+    Board board;
+    board_init_starting_position(&board);
+    int32_t expected[2];
+    
+    /* The piece-square sums follow moves and their unmaking */
+    for (int ply = 0; ply < 12; ply++) {
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        ASSERT(moves.count > 0);
+        
+        for (int i = 0; i < moves.count; i++) {
+            UndoInfo undo;
+            make_move_with_undo(&board, moves.moves[i], &undo);
+            psqt_compute(&board, expected);
+            ASSERT_EQ(board.psqt[0], expected[0]);
+            ASSERT_EQ(board.psqt[1], expected[1]);
+            unmake_move(&board, moves.moves[i], &undo);
+        }
+        
+        make_move(&board, moves.moves[(ply * 3) % moves.count]);
+        psqt_compute(&board, expected);
+        ASSERT_EQ(board.psqt[0], expected[0]);
+        ASSERT_EQ(board.psqt[1], expected[1]);
+    }
+}
+
+TEST(zobrist_transposition) {
+    /* Two move orders reaching the same position hash the same */
+    Board a, b;
+    board_init_starting_position(&a);
+    board_init_starting_position(&b);
+    
+    Move w1 = {cell_make(0, 2), cell_make(0, 1), PIECE_NONE};
+    Move w2 = {cell_make(1, 1), cell_make(1, 0), PIECE_NONE};
+    Move b1 = {cell_make(0, -2), cell_make(0, -1), PIECE_NONE};
+    Move b2 = {cell_make(-1, -1), cell_make(-1, 0), PIECE_NONE};
+    
+    make_move(&a, w1); make_move(&a, b1); make_move(&a, w2); make_move(&a, b2);
+    make_move(&b, w2); make_move(&b, b2); make_move(&b, w1); make_move(&b, b1);
+    
+    ASSERT(zobrist_key(&a) == zobrist_key(&b));
+}
+
+TEST(tt_store_probe) {
+    TranspositionTable tt = {0};
+    ASSERT(tt_init(&tt, 1));
+    
+    Move move = {cell_make(0, 2), cell_make(0, 1), PIECE_NONE};
+    tt_store(&tt, 0x1234, 5, 42, TT_BOUND_LOWER, move);
+    
+    TTEntry entry;
+    ASSERT(tt_probe(&tt, 0x1234, &entry));
+    ASSERT_EQ(entry.depth, 5);
+    ASSERT_EQ(entry.score, 42);
+    ASSERT_EQ(entry.bound, TT_BOUND_LOWER);
+    ASSERT(cell_equals(entry.best_move.from, move.from));
+    ASSERT(cell_equals(entry.best_move.to, move.to));
+    ASSERT(!tt_probe(&tt, 0x4321, &entry));
+    
+    /* A shallower result from the same search does not replace it */
+    tt_store(&tt, 0x1234, 2, 7, TT_BOUND_UPPER, move);
+    ASSERT(tt_probe(&tt, 0x1234, &entry));
+    ASSERT_EQ(entry.depth, 5);
+    
+    /* Mate scores and promotions survive packing */
+    Move promo = {cell_make(-4, 4), cell_make(4, -4), PIECE_QUEEN};
+    tt_store(&tt, 0xbeef, 31, -EVAL_MATE + 3, TT_BOUND_EXACT, promo);
+    ASSERT(tt_probe(&tt, 0xbeef, &entry));
+    ASSERT_EQ(entry.score, -EVAL_MATE + 3);
+    ASSERT_EQ(entry.depth, 31);
+    ASSERT_EQ(entry.best_move.promotion, PIECE_QUEEN);
+    ASSERT(cell_equals(entry.best_move.from, promo.from));
+    ASSERT(cell_equals(entry.best_move.to, promo.to));
+    
+    tt_clear(&tt);
+    ASSERT(!tt_probe(&tt, 0x1234, &entry));
+    tt_free(&tt);
+}
+
 TEST(checkmate_detection) {
     Board board;
     board_clear(&board);
@@ -353,6 +819,47 @@ TEST(evaluation_material) {
     ASSERT(eval > VALUE_QUEEN / 2);
 }
 
+TEST(search_finds_mate_at_leaf) {
+    Board board;
+    board_clear(&board);
+    
+    /* The checkmate_detection position, one queen move earlier */
+    board_set(&board, cell_make(4, -4), (Piece){PIECE_KING, COLOR_BLACK, 0});
+    board_set(&board, cell_make(3, -1), (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+    board_set(&board, cell_make(1, -1), (Piece){PIECE_LANCE, COLOR_WHITE, 0});
+    board_set(&board, cell_make(2, -3), (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+    board_set(&board, cell_make(0, 4), (Piece){PIECE_KING, COLOR_WHITE, 0});
+    board.to_move = COLOR_WHITE;
+    ASSERT(!is_in_check(&board, COLOR_BLACK));
+    
+    /* evaluate() no longer looks for mate; the depth-0 node does */
+    SearchStats stats;
+    Move best = find_best_move(&board, 1, &stats);
+    ASSERT_EQ(stats.eval, EVAL_MATE - 1);
+    
+    make_move(&board, best);
+    ASSERT(is_checkmate(&board));
+}
+
+TEST(quiescence_sees_recapture) {
+    Board board;
+    board_clear(&board);
+    
+    /* The pawn on (0,-1) is defended by the one behind it */
+    board_set(&board, cell_make(0, 4), (Piece){PIECE_KING, COLOR_WHITE, 0});
+    board_set(&board, cell_make(0, 0), (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+    board_set(&board, cell_make(2, -4), (Piece){PIECE_KING, COLOR_BLACK, 0});
+    board_set(&board, cell_make(0, -1), (Piece){PIECE_PAWN, COLOR_BLACK, 0});
+    board_set(&board, cell_make(0, -2), (Piece){PIECE_PAWN, COLOR_BLACK, 0});
+    board.to_move = COLOR_WHITE;
+    
+    /* A one-ply search that stopped at the capture would take the pawn */
+    SearchStats stats;
+    Move best = find_best_move(&board, 1, &stats);
+    ASSERT(!cell_equals(best.to, cell_make(0, -1)));
+    ASSERT(stats.eval > VALUE_QUEEN / 2);
+}
+
 TEST(find_best_move_initial) {
     Board board;
     board_init_starting_position(&board);
@@ -365,6 +872,194 @@ TEST(find_best_move_initial) {
     ASSERT(stats.nodes_searched > 0);
 }
 
+TEST(find_best_move_timed_budget) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    /* The deadline stops the search well before the depth limit */
+    SearchStats stats;
+    clock_t start = clock();
+    Move best = find_best_move_timed(&board, 100, AI_MAX_DEPTH, &stats);
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+    
+    ASSERT(is_move_legal(&board, best));
+    ASSERT(stats.depth_reached >= 1 && stats.depth_reached < AI_MAX_DEPTH);
+    ASSERT(elapsed < 1.0);
+    
+    /* With time to spare it stops at max_depth with the fixed-depth score.
+     * Both start from an empty table, so neither grafts in deeper results
+     * left by the search above. */
+    SearchStats fixed;
+    ai_clear_hash();
+    find_best_move(&board, 3, &fixed);
+    ai_clear_hash();
+    best = find_best_move_timed(&board, 60000, 3, &stats);
+    ASSERT(is_move_legal(&board, best));
+    ASSERT_EQ(stats.depth_reached, 3);
+    ASSERT_EQ(stats.eval, fixed.eval);
+}
+
+TEST(find_best_move_threads) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    ai_set_threads(0);
+    ASSERT_EQ(ai_get_threads(), 1);
+    ai_set_threads(AI_MAX_THREADS + 1);
+    ASSERT_EQ(ai_get_threads(), AI_MAX_THREADS);
+    
+    /* Helpers share the table; the main thread still reports its own depth */
+    ai_set_threads(4);
+    SearchStats stats;
+    Move best = find_best_move(&board, 3, &stats);
+    ASSERT(is_move_legal(&board, best));
+    ASSERT_EQ(stats.depth_reached, 3);
+    
+    best = find_best_move_timed(&board, 100, AI_MAX_DEPTH, &stats);
+    ASSERT(is_move_legal(&board, best));
+    ASSERT(stats.depth_reached >= 1);
+    ai_set_threads(1);
+}
+
+TEST(search_reuses_root_moves) {
+    Board board;
+    board_init_starting_position(&board);
+    MoveList moves;
+    generate_legal_moves(&board, &moves);
+    
+    /* The same list gives the same search as generating it */
+    SearchLimits limits = {3, -1, NULL, false, false, NULL, NULL, NULL};
+    SearchStats generated, given;
+    ai_clear_hash();
+    Move a = find_best_move_limited(&board, &limits, &generated);
+    limits.root_moves = &moves;
+    ai_clear_hash();
+    Move b = find_best_move_limited(&board, &limits, &given);
+    ASSERT_EQ(move_encode(b), move_encode(a));
+    ASSERT_EQ(given.eval, generated.eval);
+    ASSERT_EQ(given.nodes_searched, generated.nodes_searched);
+    
+    /* The root only plays from the list it is given */
+    MoveList one;
+    movelist_init(&one);
+    movelist_add(&one, moves.moves[moves.count - 1]);
+    limits.root_moves = &one;
+    b = find_best_move_limited(&board, &limits, &given);
+    ASSERT_EQ(move_encode(b), move_encode(one.moves[0]));
+}
+
+TEST(selective_search_prunes) {
+    Board board;
+    board_init_starting_position(&board);
+    
+    /* Null moves and reductions cut the tree at the same nominal depth */
+    SearchStats full, selective;
+    ai_set_selective(false, false);
+    ai_clear_hash();
+    Move best = find_best_move(&board, 5, &full);
+    ASSERT(is_move_legal(&board, best));
+    
+    ai_set_selective(true, true);
+    ai_clear_hash();
+    best = find_best_move(&board, 5, &selective);
+    ASSERT(is_move_legal(&board, best));
+    ASSERT(selective.nodes_searched < full.nodes_searched);
+}
+
+TEST(search_stats_report) {
+    Board board;
+    board_init_starting_position(&board);
+    SearchStats stats, total;
+    memset(&total, 0, sizeof(total));
+    ai_clear_hash();
+    find_best_move_timed(&board, 1000, 4, &stats);
+    ASSERT_EQ(stats.depth_reached, 4);
+    search_stats_add(&total, &stats);
+    search_stats_add(&total, &stats);
+    ASSERT_EQ(total.nodes_searched, 2 * stats.nodes_searched);
+    
+    char json[4096];
+    int len = search_stats_json(&stats, json, sizeof(json));
+    ASSERT(len > 0 && len < (int)sizeof(json));
+    ASSERT(json[0] == '{' && json[len - 1] == '}');
+    char nodes[64];
+    snprintf(nodes, sizeof(nodes), "\"nodes\":%d,", stats.nodes_searched);
+    ASSERT(strstr(json, nodes) != NULL);
+    
+    /* A short buffer is cut off but still terminated */
+    char small[16];
+    ASSERT_EQ(search_stats_json(&stats, small, sizeof(small)), len);
+    ASSERT_EQ(strlen(small), sizeof(small) - 1);
+
+#ifdef UNDERCHEX_PROFILE
+    /* Every full-width node probes the table once; each iteration's count
+     * is part of the total */
+    const SearchProfile* profile = &stats.profile;
+    uint64_t full_width = 0, iterations = 0;
+    for (int ply = 0; ply < SEARCH_PROFILE_PLIES; ply++) full_width += profile->nodes_by_ply[ply];
+    for (int depth = 1; depth <= 4; depth++) {
+        ASSERT(profile->iteration_nodes[depth] > 0);
+        iterations += profile->iteration_nodes[depth];
+    }
+    ASSERT(profile->nodes_by_ply[0] > 0);
+    ASSERT(full_width == profile->tt_probes);
+    ASSERT(full_width + profile->quiescence_nodes == (uint64_t)stats.nodes_searched);
+    ASSERT(iterations == (uint64_t)stats.nodes_searched);
+    ASSERT(profile->first_move_cutoffs <= profile->beta_cutoffs);
+    ASSERT(profile->beta_cutoffs <= profile->expanded_nodes);
+    ASSERT(profile->tt_cutoffs <= profile->tt_hits && profile->tt_hits <= profile->tt_probes);
+    ASSERT(profile->movegen_calls > 0 && profile->movegen_cycles > 0);
+    ASSERT(profile->eval_calls > 0 && profile->eval_cycles > 0);
+    ASSERT(total.profile.movegen_calls == 2 * profile->movegen_calls);
+    ASSERT(strstr(json, "\"branching_factor\":") != NULL);
+#endif
+}
+
+TEST(ponder_expected_reply) {
+    Board board;
+    board_init_starting_position(&board);
+    SearchStats stats;
+    ai_clear_hash();
+    make_move(&board, find_best_move(&board, 4, &stats));
+    
+    /* The search left the reply it expects, and pondering searches past it */
+    Ponder ponder;
+    ponder_init(&ponder);
+    ponder_start(&ponder, &board, 4);
+    ASSERT(ponder.predicted);
+    ASSERT(is_move_legal(&board, ponder.expected));
+    
+    Board after = board_copy(&board);
+    make_move(&after, ponder.expected);
+    Move move;
+    ASSERT(ponder_hit(&ponder, &after, 0, &move, &stats));
+    ASSERT(is_move_legal(&after, move));
+    ASSERT_EQ(stats.depth_reached, 4);
+    
+    /* Any other reply is searched afresh */
+    ponder_start(&ponder, &board, 4);
+    MoveList replies;
+    generate_legal_moves(&board, &replies);
+    Move other = replies.moves[0];
+    if (move_encode(other) == move_encode(ponder.expected)) other = replies.moves[1];
+    after = board_copy(&board);
+    make_move(&after, other);
+    ASSERT(!ponder_hit(&ponder, &after, 0, &move, &stats));
+    ASSERT(!ponder.active);
+    
+    /* A timed hit answers once the budget since pondering began is spent */
+    ponder_start(&ponder, &board, AI_MAX_DEPTH);
+    after = board_copy(&board);
+    make_move(&after, ponder.expected);
+    ASSERT(ponder_hit(&ponder, &after, 50, &move, &stats));
+    ASSERT(is_move_legal(&after, move));
+    
+    ponder_start(&ponder, &board, 4);
+    ponder_discard_stale(&ponder, &after);
+    ASSERT(!ponder.active);
+    ponder_destroy(&ponder);
+}
+
 TEST(move_parsing) {
     Move move;
     
@@ -416,6 +1111,38 @@ TEST(tablebase_detect_kqvk) {
     ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_KQvK);
 }
 
+TEST(tablebase_detect_signatures) {
+    Board board;
+    board_clear(&board);
+    
+    Piece wk = {PIECE_KING, COLOR_WHITE, 0};
+    Piece bk = {PIECE_KING, COLOR_BLACK, 0};
+    board_set(&board, cell_make(0, 4), wk);
+    board_set(&board, cell_make(0, -4), bk);
+    
+    /* King + Pawn vs King */
+    board_set(&board, cell_make(1, 0), (Piece){PIECE_PAWN, COLOR_WHITE, 0});
+    ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_KPvK);
+    
+    /* A second chariot of the same side */
+    board_set(&board, cell_make(1, 0), (Piece){PIECE_CHARIOT, COLOR_WHITE, 0});
+    board_set(&board, cell_make(-1, 0), (Piece){PIECE_CHARIOT, COLOR_WHITE, 0});
+    ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_KCCvK);
+    
+    /* Queen vs lance, with either colour holding the queen */
+    board_set(&board, cell_make(1, 0), (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+    board_set(&board, cell_make(-1, 0), (Piece){PIECE_LANCE, COLOR_BLACK, 1});
+    ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_KQvKL);
+    
+    board_set(&board, cell_make(1, 0), (Piece){PIECE_QUEEN, COLOR_BLACK, 0});
+    board_set(&board, cell_make(-1, 0), (Piece){PIECE_LANCE, COLOR_WHITE, 1});
+    ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_KQvKL);
+    
+    /* Lance vs lance has no table */
+    board_set(&board, cell_make(1, 0), (Piece){PIECE_LANCE, COLOR_BLACK, 0});
+    ASSERT_EQ(tablebase_detect_config(&board), TB_CONFIG_COUNT);
+}
+
 TEST(tablebase_kvk_always_draw) {
     tablebase_init();
     tablebase_generate(TB_CONFIG_KvK);
@@ -475,6 +1202,89 @@ TEST(tablebase_stats) {
     ASSERT(stats.total_entries > 0);
 }
 
+TEST(tablebase_threaded_generation) {
+    /* Threaded generation must produce the same table as a single worker */
+    tablebase_cleanup();
+    tablebase_init();
+    ASSERT(tablebase_generate_threads(TB_CONFIG_KvK, 1));
+    TablebaseStats serial = tablebase_get_stats();
+    
+    tablebase_cleanup();
+    tablebase_init();
+    ASSERT(tablebase_generate_threads(TB_CONFIG_KvK, 4));
+    TablebaseStats threaded = tablebase_get_stats();
+    
+    ASSERT_EQ(threaded.total_entries, serial.total_entries);
+    ASSERT_EQ(threaded.total_draws, serial.total_draws);
+    ASSERT_EQ(threaded.total_wins, 0);
+    ASSERT_EQ(threaded.total_losses, 0);
+}
+
+TEST(tablebase_save_load) {
+    const char* path = "test_tablebase_kvk.utb";
+    
+    tablebase_cleanup();
+    tablebase_init();
+    ASSERT(tablebase_generate(TB_CONFIG_KvK));
+    ASSERT(tablebase_save(TB_CONFIG_KvK, path));
+    TablebaseStats generated = tablebase_get_stats();
+    
+    /* A fresh process state loads instead of regenerating */
+    tablebase_cleanup();
+    tablebase_init();
+    ASSERT(tablebase_load(TB_CONFIG_KvK, path));
+    ASSERT(tablebase_verify(TB_CONFIG_KvK));
+    
+    TablebaseStats loaded = tablebase_get_stats();
+    ASSERT_EQ(loaded.total_entries, generated.total_entries);
+    ASSERT_EQ(loaded.total_draws, generated.total_draws);
+    
+    Board board;
+    board_clear(&board);
+    board_set(&board, cell_make(0, 0), (Piece){PIECE_KING, COLOR_WHITE, 0});
+    board_set(&board, cell_make(0, -4), (Piece){PIECE_KING, COLOR_BLACK, 0});
+    board.white_king = cell_make(0, 0);
+    board.black_king = cell_make(0, -4);
+    board.to_move = COLOR_WHITE;
+    
+    TablebaseProbeResult probe = tablebase_probe(&board);
+    ASSERT(probe.found);
+    ASSERT_EQ(probe.wdl, WDL_DRAW);
+    
+    /* The file's layout belongs to KvK only */
+    ASSERT(!tablebase_load(TB_CONFIG_KQvK, path));
+    
+    tablebase_cleanup();
+    remove(path);
+}
+
+TEST(tablebase_symmetric_positions) {
+    tablebase_init();
+    ASSERT(tablebase_generate(TB_CONFIG_KQvK));
+    
+    /* Rotating by 60 degrees, (q, r) -> (-r, q + r), is a symmetry of KQvK */
+    Cell cells[3] = {cell_make(1, 1), cell_make(-2, -1), cell_make(3, -2)};
+    TablebaseProbeResult results[6];
+    
+    for (int turn = 0; turn < 6; turn++) {
+        Board board;
+        board_clear(&board);
+        board_set(&board, cells[0], (Piece){PIECE_KING, COLOR_WHITE, 0});
+        board_set(&board, cells[1], (Piece){PIECE_KING, COLOR_BLACK, 0});
+        board_set(&board, cells[2], (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+        board.to_move = COLOR_WHITE;
+        
+        results[turn] = tablebase_probe(&board);
+        ASSERT(results[turn].found);
+        ASSERT_EQ(results[turn].wdl, results[0].wdl);
+        ASSERT_EQ(results[turn].dtm, results[0].dtm);
+        
+        for (int i = 0; i < 3; i++) {
+            cells[i] = cell_make(-cells[i].r, cells[i].q + cells[i].r);
+        }
+    }
+}
+
 TEST(ai_tablebase_integration) {
     /*
      * Test AI with tablebase integration for KvK endgame.
@@ -504,6 +1314,590 @@ TEST(ai_tablebase_integration) {
     ASSERT_EQ(stats.eval, EVAL_DRAW);
 }
 
+TEST(search_probes_tablebase) {
+    Board board;
+    board_clear(&board);
+    
+    /* Taking the undefended lance leaves a won KQvK */
+    board_set(&board, cell_make(0, 4), (Piece){PIECE_KING, COLOR_WHITE, 0});
+    board_set(&board, cell_make(0, 0), (Piece){PIECE_QUEEN, COLOR_WHITE, 0});
+    board_set(&board, cell_make(2, -4), (Piece){PIECE_KING, COLOR_BLACK, 0});
+    board_set(&board, cell_make(0, -2), (Piece){PIECE_LANCE, COLOR_BLACK, 0});
+    board.to_move = COLOR_WHITE;
+    
+    /* The search sees the mate through the table, not by searching it */
+    SearchStats stats;
+    ai_clear_hash();
+    Move best = find_best_move_with_tablebase(&board, 4, &stats);
+    ASSERT(cell_equals(best.to, cell_make(0, -2)));
+    ASSERT(stats.tb_hits > 0);
+    ASSERT(stats.eval > EVAL_MATE - 100);
+    
+    WDLOutcome wdl;
+    int dtm;
+    Board after = board_copy(&board);
+    make_move(&after, best);
+    ASSERT(tablebase_probe_wdl(&after, &wdl, &dtm));
+    ASSERT_EQ(wdl, WDL_LOSS);
+    ASSERT(!tablebase_probe_wdl(&board, &wdl, &dtm));
+}
+
+/* Lines an engine session has written */
+typedef struct {
+    char lines[32][256];
+    int count;
+} EngineTranscript;
+
+static void transcript_add(void* context, const char* line) {
+    EngineTranscript* t = context;
+    if (t->count < 32) {
+        snprintf(t->lines[t->count++], sizeof(t->lines[0]), "%s", line);
+    }
+}
+
+/* The last line starting with prefix, or NULL */
+static const char* transcript_find(const EngineTranscript* t, const char* prefix) {
+    for (int i = t->count - 1; i >= 0; i--) {
+        if (strncmp(t->lines[i], prefix, strlen(prefix)) == 0) return t->lines[i];
+    }
+    return NULL;
+}
+
+TEST(engine_move_notation) {
+    Move move;
+    ASSERT(engine_parse_move("0,2,0,1", &move));
+    ASSERT(cell_equals(move.from, cell_make(0, 2)) && cell_equals(move.to, cell_make(0, 1)));
+    ASSERT_EQ(move.promotion, PIECE_NONE);
+    
+    ASSERT(engine_parse_move("1,-3,1,-4q", &move));
+    ASSERT_EQ(move.promotion, PIECE_QUEEN);
+    char buf[32];
+    engine_format_move(move, buf, sizeof(buf));
+    ASSERT(strcmp(buf, "1,-3,1,-4q") == 0);
+    
+    ASSERT(!engine_parse_move("1,-3,1,-4k", &move));
+    ASSERT(!engine_parse_move("1,-3,1,-4qq", &move));
+    ASSERT(!engine_parse_move("0,2 0,1", &move));
+}
+
+TEST(engine_sessions_share_workers) {
+    ASSERT(engine_start(2, NULL));
+    
+    EngineTranscript a = {0}, b = {0};
+    EngineSession* first = engine_session_create(transcript_add, &a);
+    EngineSession* second = engine_session_create(transcript_add, &b);
+    ASSERT(first && second);
+    
+    engine_session_command(first, "uci");
+    ASSERT(transcript_find(&a, "uciok"));
+    
+    /* Two games searched at once, each from its own position */
+    Board board;
+    board_init_starting_position(&board);
+    MoveList moves;
+    generate_legal_moves(&board, &moves);
+    char command[64], token[32];
+    engine_format_move(moves.moves[0], token, sizeof(token));
+    snprintf(command, sizeof(command), "position startpos moves %s", token);
+    engine_session_command(second, command);
+    make_move(&board, moves.moves[0]);
+    
+    engine_session_command(first, "go depth 3");
+    engine_session_command(second, "go depth 3");
+    engine_session_wait(first);
+    engine_session_wait(second);
+    
+    Board start;
+    board_init_starting_position(&start);
+    Move best;
+    const char* line = transcript_find(&a, "bestmove ");
+    ASSERT(line && engine_parse_move(line + 9, &best) && is_move_legal(&start, best));
+    line = transcript_find(&b, "bestmove ");
+    ASSERT(line && engine_parse_move(line + 9, &best) && is_move_legal(&board, best));
+    ASSERT(transcript_find(&b, "info depth 3 "));
+    
+    /* An unbounded search ends on stop, still with a move */
+    int before = a.count;
+    engine_session_command(first, "go infinite");
+    engine_session_command(first, "stop");
+    engine_session_wait(first);
+    ASSERT(a.count > before);
+    line = transcript_find(&a, "bestmove ");
+    ASSERT(line && engine_parse_move(line + 9, &best) && is_move_legal(&start, best));
+    
+    /* An infinite search holds its answer until stop, even when the
+     * tablebase answers at once, without holding a worker: with both
+     * waiting, another session's search still runs */
+    EngineTranscript c = {0}, d = {0};
+    EngineSession* third = engine_session_create(transcript_add, &c);
+    EngineSession* fourth = engine_session_create(transcript_add, &d);
+    ASSERT(third && fourth);
+    engine_session_command(third, "position fen 5/6/7/8/k5K2/8/4Q2/6/5 w");
+    engine_session_command(fourth, "position fen 5/6/7/8/k5K2/8/4Q2/6/5 w");
+    engine_session_command(third, "go infinite");
+    engine_session_command(fourth, "go");
+    thrd_sleep(&(struct timespec){.tv_nsec = 100 * 1000 * 1000}, NULL);
+    before = b.count;
+    engine_session_command(second, "go depth 1");
+    engine_session_wait(second);
+    ASSERT(b.count > before);
+    ASSERT(!transcript_find(&c, "bestmove "));
+    ASSERT(!transcript_find(&d, "bestmove "));
+    engine_session_command(third, "stop");
+    engine_session_wait(third);
+    ASSERT(transcript_find(&c, "info depth "));
+    ASSERT(transcript_find(&c, "bestmove "));
+    engine_session_destroy(third);
+    engine_session_destroy(fourth);
+    ASSERT(transcript_find(&d, "bestmove "));
+    
+    /* A bad move leaves the position alone */
+    engine_session_command(second, "position startpos moves 9,9,9,9");
+    ASSERT(transcript_find(&b, "info string illegal move 9,9,9,9"));
+    
+    /* A text position is searched from, and a bad one is refused */
+    char text[POSITION_TEXT_MAX], fen[POSITION_TEXT_MAX + 16];
+    position_to_text(&board, text, sizeof(text));
+    snprintf(fen, sizeof(fen), "position fen %s", text);
+    before = b.count;
+    engine_session_command(second, fen);
+    ASSERT_EQ(b.count, before);
+    engine_session_command(second, "go depth 2");
+    engine_session_wait(second);
+    line = transcript_find(&b, "bestmove ");
+    ASSERT(line && engine_parse_move(line + 9, &best) && is_move_legal(&board, best));
+    engine_session_command(second, "position fen 5/6 w");
+    ASSERT(transcript_find(&b, "info string invalid position"));
+    
+    ASSERT(!engine_session_command(first, "quit"));
+    engine_session_destroy(first);
+    engine_session_destroy(second);
+    engine_stop();
+}
+
+/* ============ Opening Book Tests ============ */
+
+TEST(book_build_and_probe) {
+    const char* path = "test_book.ubk";
+    Board board;
+    board_init_starting_position(&board);
+    MoveList first;
+    generate_legal_moves(&board, &first);
+    
+    /* Two games open with one move, which wins one and draws one; a
+     * third opens with another move and loses */
+    Board after = board_copy(&board);
+    make_move(&after, first.moves[0]);
+    MoveList second;
+    generate_legal_moves(&after, &second);
+    
+    Move won[2] = {first.moves[0], second.moves[0]};
+    Move drawn[2] = {first.moves[0], second.moves[1]};
+    Move lost[1] = {first.moves[1]};
+    Move illegal[1] = {second.moves[0]};
+    
+    BookBuilder builder;
+    book_builder_init(&builder, BOOK_DEFAULT_PLIES);
+    ASSERT(book_builder_add_game(&builder, won, 2, 1));
+    ASSERT(book_builder_add_game(&builder, drawn, 2, 0));
+    ASSERT(book_builder_add_game(&builder, lost, 1, -1));
+    ASSERT(!book_builder_add_game(&builder, illegal, 1, 1));
+    ASSERT_EQ(book_builder_write(&builder, path, 1), 4);
+    book_builder_free(&builder);
+    
+    OpeningBook book;
+    ASSERT(book_open(&book, path));
+    const BookEntry* entries;
+    ASSERT_EQ(book_lookup(&book, &board, &entries), 2);
+    ASSERT_EQ(entries[0].move, move_encode(first.moves[0]));
+    ASSERT_EQ(entries[0].games, 2);
+    ASSERT_EQ(entries[0].wins, 1);
+    ASSERT_EQ(entries[0].weight, 3);
+    ASSERT_EQ(entries[1].losses, 1);
+    ASSERT_EQ(entries[1].weight, 0);
+    
+    /* The losing move has no weight, so the probe always picks the other */
+    Move move;
+    for (int i = 0; i < 20; i++) {
+        ASSERT(book_probe(&book, &board, &move));
+        ASSERT_EQ(move_encode(move), move_encode(first.moves[0]));
+    }
+    
+    /* Black's first reply lost, so only the drawing one is played */
+    ASSERT_EQ(book_lookup(&book, &after, &entries), 2);
+    ASSERT(book_probe(&book, &after, &move));
+    ASSERT_EQ(move_encode(move), move_encode(second.moves[1]));
+    
+    /* The search plays from the book once it is set, and searches when
+     * the book runs out */
+    ASSERT(ai_set_book(path));
+    SearchStats stats;
+    move = find_best_move_with_tablebase(&board, 3, &stats);
+    ASSERT(stats.from_book);
+    ASSERT_EQ(move_encode(move), move_encode(first.moves[0]));
+    move = find_best_move_with_tablebase(&after, 3, &stats);
+    ASSERT(stats.from_book);
+    make_move(&after, move);
+    find_best_move_with_tablebase(&after, 2, &stats);
+    ASSERT(!stats.from_book);
+    ASSERT(ai_set_book(NULL));
+    
+    book_close(&book);
+    remove(path);
+    ASSERT(!book_open(&book, path));
+    ASSERT(!ai_set_book(path));
+}
+
+/* ============ Game History Tests ============ */
+
+/* A knight move of the side to move */
+static Move knight_move(const Board* board) {
+    MoveList moves;
+    generate_legal_moves(board, &moves);
+    for (int i = 0; i < moves.count; i++) {
+        if (board_get((Board*)board, moves.moves[i].from)->type == PIECE_KNIGHT) {
+            return moves.moves[i];
+        }
+    }
+    return (Move){{0, 0}, {0, 0}, PIECE_NONE};
+}
+
+TEST(history_undo_redo_repetition) {
+    Board start;
+    board_init_starting_position(&start);
+    GameHistory history;
+    history_init(&history, &start);
+    ASSERT(!history_undo(&history));
+    ASSERT(!history_redo(&history));
+    
+    /* Both knights out and back repeats the start */
+    Move white = knight_move(&start);
+    Board after = start;
+    make_move(&after, white);
+    Move black = knight_move(&after);
+    ASSERT(!cell_equals(white.from, white.to) && !cell_equals(black.from, black.to));
+    Move shuffle[4] = {white, black, {white.to, white.from, PIECE_NONE},
+                       {black.to, black.from, PIECE_NONE}};
+    
+    for (int i = 0; i < 4; i++) ASSERT(history_push(&history, shuffle[i]));
+    ASSERT(zobrist_key(&history.board) == zobrist_key(&start));
+    ASSERT_EQ(history_repetitions(&history), 1);
+    for (int i = 0; i < 4; i++) ASSERT(history_push(&history, shuffle[i]));
+    ASSERT_EQ(history_repetitions(&history), 2);
+    
+    /* Undo takes the board back exactly; redo replays */
+    ASSERT(history_undo(&history));
+    ASSERT(history_undo(&history));
+    ASSERT_EQ(history.count, 6);
+    make_move(&after, black);
+    ASSERT(zobrist_key(&history.board) == zobrist_key(&after));
+    ASSERT(history.board.hash == zobrist_compute(&history.board));
+    ASSERT_EQ(history.board.half_move_count, 6);
+    ASSERT(history_redo(&history));
+    ASSERT_EQ(history_repetitions(&history), 1);
+    
+    /* A fork plays on alone; a new move drops the redo */
+    GameHistory fork;
+    ASSERT(history_fork(&history, &fork));
+    ASSERT(history_push(&fork, shuffle[3]));
+    ASSERT_EQ(fork.count, 8);
+    ASSERT_EQ(history_repetitions(&fork), 2);
+    ASSERT_EQ(history.count, 7);
+    ASSERT(history_undo(&history));
+    ASSERT(history_push(&history, knight_move(&history.board)));
+    ASSERT(!history_redo(&history));
+    
+    /* A pawn move ends the repetition window */
+    MoveList moves;
+    generate_legal_moves(&fork.board, &moves);
+    for (int i = 0; i < moves.count; i++) {
+        if (board_get(&fork.board, moves.moves[i].from)->type == PIECE_PAWN) {
+            ASSERT(history_push(&fork, moves.moves[i]));
+            break;
+        }
+    }
+    ASSERT_EQ(history_repetitions(&fork), 0);
+    
+    /* No length limit: thousands of plies, undone back to the start */
+    while (history_undo(&history)) {}
+    for (int i = 0; i < 3000; i++) ASSERT(history_push(&history, shuffle[i % 4]));
+    ASSERT_EQ(history_move(&history, 2999).from.q, shuffle[3].from.q);
+    while (history_undo(&history)) {}
+    ASSERT_EQ(history.count, 0);
+    ASSERT(zobrist_key(&history.board) == zobrist_key(&start));
+    ASSERT_EQ(history.length, 3000);
+    
+    history_free(&fork);
+    history_free(&history);
+}
+
+/* ============ Position Analysis Tests ============ */
+
+TEST(position_text_and_records) {
+    Board board;
+    board_init_starting_position(&board);
+    char text[POSITION_TEXT_MAX];
+    ASSERT_EQ(position_to_text(&board, text, sizeof(text)), (int)strlen(text));
+    ASSERT(strcmp(text, "5/6/p3P1A/cp3PCQ/knp3PNK/qcp3PC/a1p3P/6/5 w 0 1") == 0);
+    
+    /* Both forms give back the same position, counters included */
+    MoveList moves;
+    generate_legal_moves(&board, &moves);
+    make_move(&board, moves.moves[0]);
+    position_to_text(&board, text, sizeof(text));
+    Board parsed;
+    ASSERT(position_from_text(text, &parsed));
+    ASSERT(parsed.hash == board.hash);
+    ASSERT_EQ(parsed.to_move, COLOR_BLACK);
+    ASSERT_EQ(parsed.full_move_count, board.full_move_count);
+    
+    PositionRecord record;
+    position_pack(&board, &record);
+    Board unpacked;
+    ASSERT(position_unpack(&record, &unpacked));
+    ASSERT(unpacked.hash == board.hash);
+    ASSERT_EQ(unpacked.half_move_count, board.half_move_count);
+    for (int i = 0; i < NUM_CELLS; i++) {
+        Cell cell = cell_from_index(i);
+        const Piece* a = board_get(&unpacked, cell);
+        const Piece* b = board_get(&board, cell);
+        ASSERT(a->type == b->type && a->color == b->color && a->variant == b->variant);
+    }
+    
+    /* The counters are optional; anything else malformed is refused */
+    ASSERT(position_from_text("5/6/7/8/4K4/8/7/6/4k w", &parsed));
+    ASSERT_EQ(parsed.half_move_count, 0);
+    ASSERT_EQ(parsed.full_move_count, 1);
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6/4k x", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/4K5/8/7/6/4k w", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6 w", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6/4x w", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6/4k w 3", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6/3kk w", &parsed));
+    
+    /* So is a position no game reaches: a missing king, touching kings,
+     * or the side that has just moved left in check */
+    ASSERT(!position_from_text("5/6/7/8/4K4/8/7/6/5 w", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/3kK4/8/7/6/5 w", &parsed));
+    ASSERT(!position_from_text("5/6/7/8/2k2QK2/8/7/6/5 w", &parsed));
+    ASSERT(position_from_text("5/6/7/8/2k2QK2/8/7/6/5 b", &parsed));
+    ASSERT(is_in_check(&parsed, COLOR_BLACK));
+    PositionRecord checked;
+    position_pack(&parsed, &checked);
+    checked.bytes[31] = COLOR_WHITE;
+    ASSERT(!position_unpack(&checked, &parsed));
+    
+    /* Labels keep their sign and a mate score, and leave the position be */
+    PositionLabel label = {ANALYSIS_SEARCH, -EVAL_MATE + 7, move_encode(moves.moves[1]), 9};
+    position_set_label(&record, &label);
+    PositionLabel got;
+    position_get_label(&record, &got);
+    ASSERT_EQ(got.kind, ANALYSIS_SEARCH);
+    ASSERT_EQ(got.score, -EVAL_MATE + 7);
+    ASSERT_EQ(got.move, label.move);
+    ASSERT_EQ(got.depth, 9);
+    ASSERT(position_unpack(&record, &unpacked));
+    ASSERT(unpacked.hash == board.hash);
+    
+    /* A nibble that is no piece, or no side to move, is not a position */
+    PositionRecord bad = record;
+    bad.bytes[0] = 0x08;
+    ASSERT(!position_unpack(&bad, &unpacked));
+    bad = record;
+    bad.bytes[31] &= ~3;
+    ASSERT(!position_unpack(&bad, &unpacked));
+}
+
+TEST(analyze_records_labels) {
+    enum { COUNT = 600 };
+    PositionRecord* records = malloc(sizeof(PositionRecord) * COUNT);
+    ASSERT(records);
+    
+    /* Positions along a game, with one that is not a position */
+    Board board;
+    board_init_starting_position(&board);
+    Board boards[8];
+    for (int i = 0; i < 8; i++) {
+        boards[i] = board;
+        MoveList moves;
+        generate_legal_moves(&board, &moves);
+        make_move(&board, moves.moves[i % moves.count]);
+    }
+    for (int i = 0; i < COUNT; i++) {
+        position_pack(&boards[i % 8], &records[i]);
+    }
+    memset(&records[5], 0xFF, sizeof(PositionRecord));
+    
+    AnalysisConfig config = {ANALYSIS_EVAL, 0};
+    AnalysisTotals totals = {0, 0, 0};
+    analyze_records(records, COUNT, &config, 4, &totals);
+    ASSERT_EQ(totals.records, COUNT);
+    ASSERT_EQ(totals.labelled, COUNT - 1);
+    ASSERT_EQ(totals.invalid, 1);
+    
+    PositionLabel label;
+    for (int i = 0; i < COUNT; i++) {
+        position_get_label(&records[i], &label);
+        if (i == 5) {
+            ASSERT_EQ(label.kind, ANALYSIS_NONE);
+            continue;
+        }
+        ASSERT_EQ(label.kind, ANALYSIS_EVAL);
+        ASSERT_EQ(label.score, evaluate(&boards[i % 8]));
+    }
+    
+    /* A search label is a legal move and the score from White's side */
+    config.kind = ANALYSIS_SEARCH;
+    config.depth = 2;
+    analyze_records(records + 8, 8, &config, 2, &totals);
+    for (int i = 8; i < 16; i++) {
+        position_get_label(&records[i], &label);
+        ASSERT_EQ(label.kind, ANALYSIS_SEARCH);
+        ASSERT_EQ(label.depth, 2);
+        ASSERT(is_move_legal(&boards[i % 8], move_decode(label.move)));
+    }
+    
+    /* Labels do not depend on the table's earlier contents or the threads */
+    PositionRecord again[8];
+    memcpy(again, records + 8, sizeof(again));
+    SearchStats stats;
+    find_best_move(&boards[3], 4, &stats);
+    analyze_records(again, 8, &config, 1, &totals);
+    ASSERT(memcmp(again, records + 8, sizeof(again)) == 0);
+    
+    Board ahead;
+    ASSERT(position_from_text("5/6/7/8/3QK4/8/7/6/4k b", &ahead));
+    ASSERT(analyze_position(&ahead, &config, &label));
+    ASSERT(label.score > 500);
+    
+    /* A pool labels batch after batch with the same threads */
+    PositionRecord batch[8];
+    AnalysisPool pool;
+    AnalysisTotals pooled = {0, 0, 0};
+    analyze_pool_start(&pool, &config, 2);
+    for (int round = 0; round < 2; round++) {
+        memcpy(batch, records + 8, sizeof(batch));
+        analyze_pool_submit(&pool, batch, 8);
+        analyze_pool_wait(&pool, &pooled);
+        ASSERT(memcmp(batch, records + 8, sizeof(batch)) == 0);
+    }
+    analyze_pool_stop(&pool);
+    ASSERT_EQ(pooled.records, 16);
+    ASSERT_EQ(pooled.labelled, 16);
+    
+    /* Converting only keeps the labels */
+    config.kind = ANALYSIS_NONE;
+    analyze_records(records, 16, &config, 1, &totals);
+    position_get_label(&records[8], &label);
+    ASSERT_EQ(label.kind, ANALYSIS_SEARCH);
+    free(records);
+}
+
+/* ============ Self-play Tests ============ */
+
+TEST(selfplay_config_and_elo) {
+    PlayerConfig config;
+    ASSERT(selfplay_parse_config("", &config));
+    ASSERT_EQ(config.depth, 3);
+    ASSERT_EQ(config.time_ms, 0);
+    ASSERT_EQ(config.weights.mobility, EVAL_DEFAULT_WEIGHTS.mobility);
+    
+    ASSERT(selfplay_parse_config("depth=5,time=40,mobility=4,pawn=100", &config));
+    ASSERT_EQ(config.depth, 5);
+    ASSERT_EQ(config.time_ms, 40);
+    ASSERT_EQ(config.weights.mobility, 4);
+    ASSERT_EQ(config.weights.piece_adjust[PIECE_PAWN], 100);
+    ASSERT(!selfplay_parse_config("depth=0", &config));
+    ASSERT(!selfplay_parse_config("bishop=3", &config));
+    ASSERT(!selfplay_parse_config("depth=3x", &config));
+    ASSERT(!selfplay_parse_config("depth", &config));
+    
+    /* A pawn adjustment moves the score by the pawn balance */
+    Board board;
+    board_init_starting_position(&board);
+    for (int i = 0; i < NUM_CELLS; i++) {
+        Cell cell = cell_from_index(i);
+        Piece* p = board_get(&board, cell);
+        if (p->type == PIECE_PAWN && p->color == COLOR_BLACK) {
+            board_set(&board, cell, (Piece){PIECE_NONE, COLOR_NONE, 0});
+            break;
+        }
+    }
+    EvalWeights weights = EVAL_DEFAULT_WEIGHTS;
+    weights.piece_adjust[PIECE_PAWN] = 100;
+    ASSERT_EQ(evaluate_weighted(&board, &weights) - evaluate(&board), 100);
+    
+    double elo, margin;
+    MatchScore even = {10, 20, 10};
+    selfplay_elo(&even, &elo, &margin);
+    ASSERT(elo > -0.001 && elo < 0.001);
+    ASSERT(margin > 0);
+    
+    /* A 60% score is about +70, surer over more games */
+    MatchScore ahead = {50, 20, 30};
+    selfplay_elo(&ahead, &elo, &margin);
+    ASSERT(elo > 70 && elo < 71);
+    double wide = margin;
+    MatchScore more = {500, 200, 300};
+    selfplay_elo(&more, &elo, &margin);
+    ASSERT(margin < wide / 3);
+}
+
+TEST(selfplay_game_replays) {
+    Move opening[4];
+    uint64_t random_state = 42;
+    int plies = selfplay_random_opening(opening, 4, &random_state);
+    ASSERT_EQ(plies, 4);
+    
+    /* The seed alone decides the opening */
+    Move again[4];
+    random_state = 42;
+    ASSERT_EQ(selfplay_random_opening(again, 4, &random_state), 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT(cell_equals(again[i].from, opening[i].from) && cell_equals(again[i].to, opening[i].to));
+    }
+    
+    PlayerConfig white, black;
+    ASSERT(selfplay_parse_config("depth=2", &white));
+    ASSERT(selfplay_parse_config("depth=1", &black));
+    SelfplayGame* game = malloc(sizeof(SelfplayGame));
+    SelfplayGame* replay = malloc(sizeof(SelfplayGame));
+    TranspositionTable tables[2] = {{0}, {0}};
+    ASSERT(game && replay);
+    ASSERT(tt_init(&tables[0], SELFPLAY_TT_MB) && tt_init(&tables[1], SELFPLAY_TT_MB));
+    selfplay_play_game(opening, plies, &white, &black, 60, tables, game);
+    ASSERT(game->ply_count >= plies && game->ply_count <= 60);
+    ASSERT(game->nodes[0] > 0);
+    
+    /* The same opening plays the same game again, whatever the tables held */
+    selfplay_play_game(opening, plies, &white, &black, 60, tables, replay);
+    ASSERT_EQ(replay->ply_count, game->ply_count);
+    ASSERT_EQ(replay->result, game->result);
+    ASSERT(memcmp(replay->moves, game->moves, sizeof(Move) * game->ply_count) == 0);
+    tt_free(&tables[0]);
+    tt_free(&tables[1]);
+    free(replay);
+    
+    /* Every move is legal, and the game ends the way it says */
+    Board board;
+    board_init_starting_position(&board);
+    for (int i = 0; i < game->ply_count; i++) {
+        if (i < plies) {
+            ASSERT(cell_equals(game->moves[i].from, opening[i].from));
+        }
+        ASSERT(is_move_legal(&board, game->moves[i]));
+        make_move(&board, game->moves[i]);
+    }
+    if (strcmp(game->reason, "checkmate") == 0) {
+        ASSERT(is_checkmate(&board));
+        ASSERT_EQ(game->result, board.to_move == COLOR_WHITE ? GAME_BLACK_WINS : GAME_WHITE_WINS);
+    } else if (strcmp(game->reason, "move-limit") == 0) {
+        ASSERT_EQ(game->ply_count, 60);
+        ASSERT_EQ(game->result, GAME_DRAW);
+    }
+    free(game);
+}
+
 /* ============ Main ============ */
 
 int main(void) {
@@ -515,6 +1909,7 @@ int main(void) {
     RUN_TEST(board_copy);
     
     printf("\nMove tests:\n");
+    RUN_TEST(board_piece_lists);
     RUN_TEST(pawn_moves_initial);
     RUN_TEST(king_moves);
     RUN_TEST(queen_moves_empty_board);
@@ -522,22 +1917,64 @@ int main(void) {
     RUN_TEST(check_detection);
     RUN_TEST(move_legality);
     RUN_TEST(make_move);
+    RUN_TEST(legal_moves_match_reference);
+    RUN_TEST(geometry_tables_match_hex);
+    RUN_TEST(bitboard_attacks_match_reference);
+    RUN_TEST(generate_captures_noisy_only);
+    RUN_TEST(move_code_round_trip);
+    RUN_TEST(make_unmake_move);
+    RUN_TEST(perft_counts);
+    RUN_TEST(zobrist_incremental);
+    RUN_TEST(psqt_incremental);
+    RUN_TEST(zobrist_transposition);
+    RUN_TEST(tt_store_probe);
     RUN_TEST(checkmate_detection);
     RUN_TEST(stalemate_detection);
     
     printf("\nAI tests:\n");
     RUN_TEST(evaluation_starting);
     RUN_TEST(evaluation_material);
+    RUN_TEST(search_finds_mate_at_leaf);
+    RUN_TEST(quiescence_sees_recapture);
     RUN_TEST(find_best_move_initial);
+    RUN_TEST(find_best_move_timed_budget);
+    RUN_TEST(find_best_move_threads);
+    RUN_TEST(search_reuses_root_moves);
+    RUN_TEST(selective_search_prunes);
+    RUN_TEST(search_stats_report);
+    RUN_TEST(ponder_expected_reply);
     RUN_TEST(move_parsing);
     
     printf("\nTablebase tests:\n");
     RUN_TEST(tablebase_detect_kvk);
     RUN_TEST(tablebase_detect_kqvk);
+    RUN_TEST(tablebase_detect_signatures);
     RUN_TEST(tablebase_kvk_always_draw);
     RUN_TEST(tablebase_kqvk_detect);
     RUN_TEST(tablebase_stats);
+    RUN_TEST(tablebase_threaded_generation);
+    RUN_TEST(tablebase_save_load);
+    RUN_TEST(tablebase_symmetric_positions);
     RUN_TEST(ai_tablebase_integration);
+    RUN_TEST(search_probes_tablebase);
+    
+    printf("\nEngine tests:\n");
+    RUN_TEST(engine_move_notation);
+    RUN_TEST(engine_sessions_share_workers);
+    
+    printf("\nOpening book tests:\n");
+    RUN_TEST(book_build_and_probe);
+    
+    printf("\nGame history tests:\n");
+    RUN_TEST(history_undo_redo_repetition);
+    
+    printf("\nPosition analysis tests:\n");
+    RUN_TEST(position_text_and_records);
+    RUN_TEST(analyze_records_labels);
+    
+    printf("\nSelf-play tests:\n");
+    RUN_TEST(selfplay_config_and_elo);
+    RUN_TEST(selfplay_game_replays);
     
     /* Cleanup tablebase memory */
     tablebase_cleanup();
@@ -0,0 +1,168 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Transposition table implementation
+ */
+
+#include "tt.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Packed layout of TTSlot.data, low bits first:
+ *   16  move cells, 4 bits per coordinate offset by BOARD_RADIUS
+ *    3  promotion
+ *    2  bound
+ *    8  depth
+ *    8  generation
+ *   27  score (signed) */
+#define TT_SCORE_SHIFT 37
+
+_Static_assert(2 * BOARD_RADIUS < 16, "coordinates must fit in 4 bits");
+_Static_assert(sizeof(TTSlot) == 16, "slots must stay two words");
+
+static uint64_t pack_cell(Cell c) {
+    return (uint64_t)(c.q + BOARD_RADIUS) | (uint64_t)(c.r + BOARD_RADIUS) << 4;
+}
+
+static Cell unpack_cell(uint64_t bits) {
+    return cell_make((int)(bits & 15) - BOARD_RADIUS, (int)(bits >> 4 & 15) - BOARD_RADIUS);
+}
+
+static uint64_t tt_pack(const TTEntry* e) {
+    return pack_cell(e->best_move.from) |
+           pack_cell(e->best_move.to) << 8 |
+           (uint64_t)e->best_move.promotion << 16 |
+           (uint64_t)e->bound << 19 |
+           (uint64_t)(uint8_t)e->depth << 21 |
+           (uint64_t)e->generation << 29 |
+           (uint64_t)(int64_t)e->score << TT_SCORE_SHIFT;
+}
+
+static TTEntry tt_unpack(uint64_t data) {
+    TTEntry e;
+    e.best_move.from = unpack_cell(data);
+    e.best_move.to = unpack_cell(data >> 8);
+    e.best_move.promotion = (PieceType)(data >> 16 & 7);
+    e.bound = (uint8_t)(data >> 19 & 3);
+    e.depth = (int8_t)(data >> 21 & 0xff);
+    e.generation = (uint8_t)(data >> 29 & 0xff);
+    e.score = (int32_t)((int64_t)data >> TT_SCORE_SHIFT);
+    return e;
+}
+
+/* Read a slot; returns false unless it holds 'key' */
+static bool tt_read(const TTSlot* slot, uint64_t key, TTEntry* entry) {
+    uint64_t check = atomic_load_explicit(&slot->check, memory_order_relaxed);
+    uint64_t data = atomic_load_explicit(&slot->data, memory_order_relaxed);
+    *entry = tt_unpack(data);
+    return entry->bound != TT_BOUND_NONE && (check ^ data) == key;
+}
+
+static void tt_write(TTSlot* slot, uint64_t key, const TTEntry* entry) {
+    uint64_t data = tt_pack(entry);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->check, key ^ data, memory_order_relaxed);
+}
+
+bool tt_init(TranspositionTable* tt, size_t size_mb) {
+    return tt_init_bytes(tt, size_mb * 1024 * 1024);
+}
+
+bool tt_init_bytes(TranspositionTable* tt, size_t bytes) {
+    tt_free(tt);
+    
+    size_t bucket_bytes = sizeof(TTSlot) * TT_BUCKET_SIZE;
+    size_t buckets = 1;
+    while (buckets * 2 * bucket_bytes <= bytes) {
+        buckets *= 2;
+    }
+    
+    tt->slots = calloc(buckets * TT_BUCKET_SIZE, sizeof(TTSlot));
+    if (!tt->slots) return false;
+    tt->bucket_count = buckets;
+    tt->generation = 0;
+    return true;
+}
+
+void tt_free(TranspositionTable* tt) {
+    free(tt->slots);
+    tt->slots = NULL;
+    tt->bucket_count = 0;
+}
+
+void tt_clear(TranspositionTable* tt) {
+    if (tt->slots) {
+        memset(tt->slots, 0, sizeof(TTSlot) * TT_BUCKET_SIZE * tt->bucket_count);
+    }
+    tt->generation = 0;
+}
+
+void tt_new_search(TranspositionTable* tt) {
+    tt->generation++;
+}
+
+static TTSlot* tt_bucket(const TranspositionTable* tt, uint64_t key) {
+    return &tt->slots[(key & (tt->bucket_count - 1)) * TT_BUCKET_SIZE];
+}
+
+bool tt_probe(const TranspositionTable* tt, uint64_t key, TTEntry* entry) {
+    if (!tt->slots) return false;
+    
+    TTSlot* bucket = tt_bucket(tt, key);
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        if (tt_read(&bucket[i], key, entry)) return true;
+    }
+    return false;
+}
+
+/* Replacement priority: lower is replaced first */
+static int tt_worth(const TranspositionTable* tt, const TTEntry* entry) {
+    if (entry->bound == TT_BOUND_NONE) return -1000;
+    uint8_t age = (uint8_t)(tt->generation - entry->generation);
+    return entry->depth - 8 * age;
+}
+
+void tt_store(TranspositionTable* tt, uint64_t key, int depth, int score,
+              TTBound bound, Move best_move) {
+    if (!tt->slots) return;
+    
+    TTSlot* bucket = tt_bucket(tt, key);
+    TTSlot* target = NULL;
+    TTEntry old;
+    
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        if (tt_read(&bucket[i], key, &old)) {
+            target = &bucket[i];
+            break;
+        }
+    }
+    
+    if (target) {
+        /* Same position: keep a deeper result from this search unless the
+         * new one is exact */
+        if (old.generation == tt->generation && old.depth > depth &&
+            bound != TT_BOUND_EXACT) {
+            return;
+        }
+        /* A move-less result (e.g. a cutoff below) keeps the old move */
+        if (best_move.from.q == 0 && best_move.from.r == 0 &&
+            best_move.to.q == 0 && best_move.to.r == 0) {
+            best_move = old.best_move;
+        }
+    } else {
+        int target_worth = 0;
+        for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+            /* A slot torn by another thread's store unpacks as garbage;
+             * it is only a replacement candidate, so that is harmless */
+            TTEntry other = tt_unpack(atomic_load_explicit(&bucket[i].data,
+                                                           memory_order_relaxed));
+            int worth = tt_worth(tt, &other);
+            if (!target || worth < target_worth) {
+                target = &bucket[i];
+                target_worth = worth;
+            }
+        }
+    }
+    
+    TTEntry entry = {best_move, score, (int8_t)depth, (uint8_t)bound, tt->generation};
+    tt_write(target, key, &entry);
+}
@@ -0,0 +1,80 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Transposition table for the alpha-beta search
+ *
+ * A fixed-size hash table of search results keyed by zobrist_key(). The
+ * table is split into buckets of TT_BUCKET_SIZE entries; a store replaces
+ * the entry for the same position if there is one, otherwise the entry
+ * left over from the oldest generation, shallowest first. The owner
+ * advances the generation with tt_new_search.
+ *
+ * Search threads share one table without locks. Each entry is packed into
+ * a 64-bit data word and stored next to key ^ data; a probe that reads the
+ * halves of two different stores fails the key check and misses.
+ */
+
+#ifndef UNDERCHEX_TT_H
+#define UNDERCHEX_TT_H
+
+#include "moves.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TT_BUCKET_SIZE 4
+#define TT_DEFAULT_MB 16
+
+/* What a stored score says about the true value */
+typedef enum {
+    TT_BOUND_NONE = 0,
+    TT_BOUND_EXACT = 1,   /* Score is exact */
+    TT_BOUND_LOWER = 2,   /* Search failed high: value >= score */
+    TT_BOUND_UPPER = 3    /* Search failed low: value <= score */
+} TTBound;
+
+/* A stored result, as unpacked by tt_probe */
+typedef struct {
+    Move best_move;
+    int32_t score;
+    int8_t depth;
+    uint8_t bound;        /* TTBound */
+    uint8_t generation;   /* Table generation when the entry was stored */
+} TTEntry;
+
+/* An entry as stored: check is the key xor data */
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} TTSlot;
+
+typedef struct {
+    TTSlot* slots;
+    size_t bucket_count;  /* Power of two */
+    _Atomic uint8_t generation;   /* Advanced by tt_new_search */
+} TranspositionTable;
+
+/* Allocate a table of at most size_mb megabytes (at least one bucket).
+ * Any previous contents are freed. Returns false if allocation fails. */
+bool tt_init(TranspositionTable* tt, size_t size_mb);
+
+/* tt_init with the size in bytes, for small tables */
+bool tt_init_bytes(TranspositionTable* tt, size_t bytes);
+
+/* Free the table's memory */
+void tt_free(TranspositionTable* tt);
+
+/* Forget every stored entry */
+void tt_clear(TranspositionTable* tt);
+
+/* Start a new generation; older entries become preferred for replacement */
+void tt_new_search(TranspositionTable* tt);
+
+/* Look up a position, copying its entry out. Returns false if it is not
+ * stored. */
+bool tt_probe(const TranspositionTable* tt, uint64_t key, TTEntry* entry);
+
+/* Store a search result. Safe to call from several threads at once. */
+void tt_store(TranspositionTable* tt, uint64_t key, int depth, int score,
+              TTBound bound, Move best_move);
+
+#endif /* UNDERCHEX_TT_H */
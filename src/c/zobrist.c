@@ -0,0 +1,45 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Zobrist hashing implementation
+ */
+
+#include "zobrist.h"
+#include "rng.h"
+#include <pthread.h>
+
+uint64_t zobrist_pieces[BOARD_SIZE][BOARD_SIZE][ZOBRIST_KINDS];
+uint64_t zobrist_black_to_move;
+
+/* Threads may clear their first boards at the same time */
+static pthread_once_t zobrist_once = PTHREAD_ONCE_INIT;
+
+/* A fixed seed, so keys are the same in every process */
+static void fill_keys(void) {
+    uint64_t state = 0x5A0B1C2D3E4F6071ULL;
+    for (int q = 0; q < BOARD_SIZE; q++) {
+        for (int r = 0; r < BOARD_SIZE; r++) {
+            /* Kind 0 (empty) stays zero */
+            for (int kind = 1; kind < ZOBRIST_KINDS; kind++) {
+                zobrist_pieces[q][r][kind] = rng_next(&state);
+            }
+        }
+    }
+    zobrist_black_to_move = rng_next(&state);
+}
+
+void zobrist_init(void) {
+    pthread_once(&zobrist_once, fill_keys);
+}
+
+uint64_t zobrist_compute(const Board* board) {
+    uint64_t hash = 0;
+    for (int q = MIN_Q; q <= MAX_Q; q++) {
+        for (int r = MIN_R; r <= MAX_R; r++) {
+            Cell c = cell_make(q, r);
+            if (!cell_is_valid(c)) continue;
+            hash ^= zobrist_piece(q + BOARD_RADIUS, r + BOARD_RADIUS,
+                                  board->squares[cell_square(c)]);
+        }
+    }
+    return hash ^ (board->to_move == COLOR_BLACK ? zobrist_black_to_move : 0);
+}
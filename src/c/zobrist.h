@@ -0,0 +1,42 @@
+/*
+ * Underchex - Hexagonal Chess Variant
+ * Zobrist hashing of board positions
+ *
+ * Every (cell, piece) pair has a random 64-bit key. Board keeps the XOR of
+ * the keys of its pieces in board->hash, updated by board_set and the
+ * board_*_piece primitives, so make_move and retract_move maintain it for
+ * free. The side to move is folded in by zobrist_key, since callers set
+ * board->to_move directly.
+ */
+
+#ifndef UNDERCHEX_ZOBRIST_H
+#define UNDERCHEX_ZOBRIST_H
+
+#include "board.h"
+#include <stdint.h>
+
+/* Piece kinds: type, colour and lance variant; kind 0 is an empty cell */
+#define ZOBRIST_KINDS ((PIECE_KING + 1) * 3 * 2)
+
+extern uint64_t zobrist_pieces[BOARD_SIZE][BOARD_SIZE][ZOBRIST_KINDS];
+extern uint64_t zobrist_black_to_move;
+
+/* Fill the key tables. Called by board_clear; safe to call repeatedly,
+ * and from several threads at once. */
+void zobrist_init(void);
+
+/* Key of a piece on a cell by storage index; zero for an empty cell */
+static inline uint64_t zobrist_piece(int q_idx, int r_idx, Piece piece) {
+    int kind = ((int)piece.type * 3 + (int)piece.color) * 2 + (piece.variant & 1);
+    return zobrist_pieces[q_idx][r_idx][kind];
+}
+
+/* Full position key: piece hash plus side to move */
+static inline uint64_t zobrist_key(const Board* board) {
+    return board->hash ^ (board->to_move == COLOR_BLACK ? zobrist_black_to_move : 0);
+}
+
+/* Position key recomputed from scratch, for checking the incremental one */
+uint64_t zobrist_compute(const Board* board);
+
+#endif /* UNDERCHEX_ZOBRIST_H */